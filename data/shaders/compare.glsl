@@ -0,0 +1,40 @@
+#version 120
+precision highp float;
+
+uniform sampler2D TextureA;     // tile of the first frame
+uniform sampler2D TextureB;     // same tile of the second frame
+uniform mat4 Proj;
+uniform mat4 View;
+uniform float Mode;     // 0.0 wipe, 1.0 difference, 2.0 first frame, 3.0 second frame
+uniform float Split;    // wipe line in scene units
+uniform float Vertical; // 1.0 wipe line is vertical, split goes along x
+uniform float Gain;     // difference amplification
+uniform float Scale;    // scene units per screen pixel
+varying vec2 TexCoord;
+varying vec2 Position;
+
+//#vertex
+attribute vec2 in_Position;
+attribute vec2 in_Texture;
+void main() {
+    TexCoord = in_Texture;
+    Position = in_Position;
+    gl_Position = Proj * View * vec4(in_Position, 0.0, 1.0);
+}
+
+//#fragment
+void main() {
+    vec4 a = texture2D(TextureA, TexCoord);
+    vec4 b = texture2D(TextureB, TexCoord);
+    if (Mode < 0.5) {
+        float coord = Vertical > 0.5 ? Position.x : Position.y;
+        float side = Vertical > 0.5 ? step(Split, coord) : 1.0 - step(Split, coord); // first frame on the left or top
+        gl_FragColor = abs(coord - Split) < Scale ? vec4(1.0) : mix(a, b, side);
+    }
+    else if (Mode < 1.5) {
+        gl_FragColor = vec4(min(abs(a.rgb - b.rgb) * Gain, vec3(1.0)), 1.0);
+    }
+    else {
+        gl_FragColor = Mode < 2.5 ? a : b;
+    }
+}
@@ -3,27 +3,46 @@ precision highp float;
 
 uniform mat4 Proj;
 uniform mat4 View;
-uniform vec3 Color;
-uniform float Offset;
 uniform float Scale;
+uniform float Smooth;   // 1.0 draws Catmull-Rom curve through the points instead of straight segment
 
 varying vec2 Position;
 varying vec2 LineStart;
 varying vec2 LineEnd;
+varying vec2 LinePrev;
+varying vec2 LineNext;
 varying float Radius;
+varying vec3 Color;
 
 //#vertex
-attribute vec2 in_Position;
-attribute vec2 in_LineStart;
+attribute vec2 in_Corner;       // per vertex: corner of unit quad
+attribute vec2 in_LineStart;    // per instance: segment and its style
 attribute vec2 in_LineEnd;
+attribute vec2 in_LinePrev;
+attribute vec2 in_LineNext;
 attribute float in_Radius;
+attribute vec3 in_Color;
 
 void main() {
-    gl_Position = Proj * View * vec4(in_Position, 0.0, 1.0);
-    Position = in_Position; 
-	LineStart = in_LineStart;
+    vec2 dir = in_LineEnd - in_LineStart;
+    dir = (abs(dir.x) + abs(dir.y) < 0.01) ? vec2(0.0, 1.0) : normalize(dir);
+    vec2 normal = vec2(-dir.y, dir.x);
+
+    // Curve deviates from the chord by at most 4/27 of its tangents length
+    float bulge = Smooth * (length(in_LineEnd - in_LinePrev) + length(in_LineNext - in_LineStart)) / 12.0;
+    float extent = in_Radius + bulge;
+
+    vec2 origin = (in_Corner.x < 0.0) ? in_LineStart : in_LineEnd;
+    vec2 position = origin + extent * (in_Corner.x * dir + in_Corner.y * normal);
+
+    gl_Position = Proj * View * vec4(position, 0.0, 1.0);
+    Position = position;
+    LineStart = in_LineStart;
     LineEnd = in_LineEnd;
+    LinePrev = in_LinePrev;
+    LineNext = in_LineNext;
     Radius = in_Radius;
+    Color = in_Color;
 }
 
 //#fragment
@@ -36,14 +55,36 @@ float getDistance(vec2 start, vec2 end, vec2 point) {
 
     // distance from segment
     float length = dir.x * dir.x + dir.y * dir.y;
-    float t = max(0.0, min(1.0, dot(point - start, dir) / length)); 
+    float t = max(0.0, min(1.0, dot(point - start, dir) / length));
     vec2 proj = start + t * dir;
     return distance(point, proj);
 }
+vec2 getCurvePoint(float t) {
+    // Catmull-Rom spline between LineStart and LineEnd
+    vec2 a = 2.0 * LineStart;
+    vec2 b = LineEnd - LinePrev;
+    vec2 c = 2.0 * LinePrev - 5.0 * LineStart + 4.0 * LineEnd - LineNext;
+    vec2 d = 3.0 * LineStart - LinePrev - 3.0 * LineEnd + LineNext;
+    return 0.5 * (a + t * (b + t * (c + t * d)));
+}
+float getCurveDistance(vec2 point) {
+    // Curve is approximated by a polyline, enough for the points simplified up to 1px
+    const int steps = 8;
+    float result = 1e20;
+    vec2 start = LineStart;
+    for (int i = 1; i <= steps; i++) {
+        vec2 end = getCurvePoint(float(i) / float(steps));
+        result = min(result, getDistance(start, end, point));
+        start = end;
+    }
+    return result;
+}
 void main() {
-    float inner = Radius + (Offset - 1.5) * Scale;
-    float outer = Radius + Offset * Scale;
-    float dist = getDistance(LineStart, LineEnd, Position);
-    float alpha = 1.0 - smoothstep(inner, outer, dist);
-    gl_FragColor = vec4(Color, alpha);
+    // White outline is 1.5px wide, fill takes the rest.
+    // Fill of the previous segment wins over the outline at the joint
+    float dist = (Smooth > 0.5) ? getCurveDistance(Position) : getDistance(LineStart, LineEnd, Position);
+    float joint = min(dist, getDistance(LinePrev, LineStart, Position));
+    float outline = 1.0 - smoothstep(Radius - 1.5 * Scale, Radius, dist);
+    float fill = 1.0 - smoothstep(Radius - 3.0 * Scale, Radius - 1.5 * Scale, joint);
+    gl_FragColor = vec4(mix(vec3(1.0), Color, fill) * outline, outline); // premultiplied
 }
@@ -0,0 +1,37 @@
+#version 120
+precision highp float;
+
+uniform mat4 Proj;
+uniform mat4 View;
+uniform float Scale;    // scene units per screen pixel
+uniform float Height;   // frame height, frame rows go top-down and scene y axis goes up
+varying vec3 Color;
+
+//#vertex
+attribute vec3 in_Corner;       // per vertex: fraction of the arrow, across and back offsets in pixels
+attribute float in_Source;      // per instance: fields of AVMotionVector
+attribute vec2 in_Target;
+attribute vec2 in_Motion;
+attribute float in_MotionScale;
+
+void main() {
+    vec2 target = vec2(in_Target.x, Height - in_Target.y);
+    vec2 motion = in_Motion / max(in_MotionScale, 1.0);
+    vec2 source = target + vec2(motion.x, -motion.y);   // block position in the reference frame
+
+    // Zero vector collapses into a point, short ones get a smaller head
+    vec2 dir = target - source;
+    float len = length(dir);
+    dir = len > 0.001 ? dir / len : vec2(1.0, 0.0);
+    vec2 normal = vec2(-dir.y, dir.x);
+    float size = min(Scale, len / 8.0);
+
+    vec2 position = source + dir * (in_Corner.x * len - in_Corner.z * size) + normal * in_Corner.y * size;
+    gl_Position = Proj * View * vec4(position, 0.0, 1.0);
+    Color = in_Source < 0.0 ? vec3(0.2, 1.0, 0.2) : vec3(1.0, 0.5, 0.1); // past and future references
+}
+
+//#fragment
+void main() {
+    gl_FragColor = vec4(Color, 1.0);
+}
@@ -10,11 +10,16 @@ namespace io::keyboard {
         LEFT = GLFW_KEY_LEFT,
         UP = GLFW_KEY_UP,
         DOWN = GLFW_KEY_DOWN,
+        PAGE_UP = GLFW_KEY_PAGE_UP,
+        PAGE_DOWN = GLFW_KEY_PAGE_DOWN,
         LEFT_SHIFT = GLFW_KEY_LEFT_SHIFT,
         LEFT_CONTROL = GLFW_KEY_LEFT_CONTROL,
         LEFT_ALT = GLFW_KEY_LEFT_ALT,
         COMMA = GLFW_KEY_COMMA,
         PERIOD = GLFW_KEY_PERIOD,
+        LEFT_BRACKET = GLFW_KEY_LEFT_BRACKET,
+        RIGHT_BRACKET = GLFW_KEY_RIGHT_BRACKET,
+        BACKSLASH = GLFW_KEY_BACKSLASH,
 
         W = GLFW_KEY_W,
         S = GLFW_KEY_S,
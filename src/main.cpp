@@ -6,8 +6,11 @@
 #include "io/io.h"
 #include "util/filedialog.h"
 #include "util/fs.h"
+#include "util/scopes.h"
+#include "video/compare.h"
 #include "video/video.h"
 #include "render.h"
+#include "shader/glstate.h"
 #include "resources.h"
 #include "workstate.h"
 #include "imgui.h"
@@ -48,7 +51,8 @@ namespace ui {
 
     enum WorkMode {
         MoveVideo = 0,
-        DrawLines = 1
+        DrawLines = 1,
+        EditLines = 2
     };
 
     class WorkModeHelper {
@@ -57,7 +61,7 @@ namespace ui {
         WorkMode modeResult = WorkMode::MoveVideo;
         static WorkMode update(WorkMode mode, bool alt) {
             if (alt) {
-                return static_cast<WorkMode>((mode + 1) % 2);
+                return (mode == WorkMode::MoveVideo) ? WorkMode::DrawLines : WorkMode::MoveVideo;
             }
             return mode;
         }
@@ -164,8 +168,19 @@ namespace ui {
         bool slideHovered;
         bool hasVideo;
         ImTextureID textureId;
+        ImVec2 textureUV;       // used part of the texture
         ImVec2 size;
+        bool direct = true;     // draw straight into the window instead of showing the texture
+        int viewport[4] = {};   // x, y, width, height in framebuffer pixels
         Slider slider;
+        float loopFrom = -1.f;  // progress of A-B loop markers, negative if no loop
+        float loopTo = -1.f;
+        std::vector<float> cutMarks;    // progress of scene cuts
+        std::vector<float> bitrate;     // per bucket of the whole video, scaled to [0, 1]
+        std::vector<char> frameTypes;   // 'I', 'P', 'B' or '?' of the frames around the shown one
+        int shownType = -1;             // index of the shown frame in 'frameTypes'
+        std::vector<ImVec2> psnrPlot;   // progress and value scaled to [0, 1]
+        std::vector<ImVec2> ssimPlot;
         function<void(bool)> hoverFrameFn;
         function<void(bool)> hoverSlideFn;
         function<void(int, int)> mouseFn;
@@ -173,13 +188,15 @@ namespace ui {
         function<void(const ImVec2&)> reshapeFn;
         function<void(const string&)> acceptDropFn;
         function<void(void)> closeFn;
+        function<void(const int*, const int*)> renderFn;   // viewport and scissor
 
         explicit FrameWindow(const char* label, const char* id) :
             id({ 0 }),
             frameHovered(false),
             slideHovered(false),
             hasVideo(false),
-            textureId(ImTextureID_Invalid) {
+            textureId(ImTextureID_Invalid),
+            textureUV(1, 1) {
             strncpy(this->id, id, sizeof(this->id));
             setName(label);
         }
@@ -225,8 +242,41 @@ namespace ui {
             int ss = (seconds % 60);
             snprintf(slider.seconds, sizeof(slider.seconds), "%02d:%02d", mm, ss);
         }
-        void setTextureID(const ImTextureID& value) {
+        void setLoop(float from, float to) {
+            loopFrom = from;
+            loopTo = to;
+        }
+        void setBitrate(std::vector<float> values) {
+            bitrate = std::move(values);
+        }
+        void setFrameTypes(std::vector<char> types, int shown) {
+            frameTypes = std::move(types);
+            shownType = shown;
+        }
+        void setCuts(std::vector<float> marks) {
+            cutMarks = std::move(marks);
+        }
+        void setPlot(std::vector<ImVec2> psnr, std::vector<ImVec2> ssim) {
+            psnrPlot = std::move(psnr);
+            ssimPlot = std::move(ssim);
+        }
+        void setTextureID(const ImTextureID& value, const ImVec2& uv) {
             textureId = value;
+            textureUV = uv;
+        }
+        static void renderCallback(const ImDrawList*, const ImDrawCmd* cmd) {
+            // Frame stays inside the clip rectangle of the command like the rest of the window
+            auto window = static_cast<FrameWindow*>(cmd->UserCallbackData);
+            const ImGuiIO& io = ImGui::GetIO();
+            const auto& scale = io.DisplayFramebufferScale;
+            const auto& clip = cmd->ClipRect;
+            const int* viewport = window->viewport;
+            const int left = std::max(viewport[0], static_cast<int>(clip.x * scale.x));
+            const int right = std::min(viewport[0] + viewport[2], static_cast<int>(clip.z * scale.x));
+            const int bottom = std::max(viewport[1], static_cast<int>((io.DisplaySize.y - clip.w) * scale.y));
+            const int top = std::min(viewport[1] + viewport[3], static_cast<int>((io.DisplaySize.y - clip.y) * scale.y));
+            const int scissor[4] = { left, bottom, std::max(0, right - left), std::max(0, top - bottom) };
+            window->renderFn(viewport, scissor);
         }
         void draw() {
             bool openedPrevFrame = hasVideo;
@@ -251,8 +301,24 @@ namespace ui {
                 reshapeFn(region);
             }
 
-            // render texture contains video and/or lines && points
-            ImGui::Image(textureId, ImVec2(region.x, region.y), ImVec2(0, 1), ImVec2(1, 0));
+            if (direct && renderFn) {
+                // video and lines are drawn during ImGui rendering, in the order of this window
+                ImGuiIO& io = ImGui::GetIO();
+                const auto& scale = io.DisplayFramebufferScale;
+                viewport[0] = static_cast<int>(cursor.x * scale.x);
+                viewport[1] = static_cast<int>((io.DisplaySize.y - cursor.y - region.y) * scale.y);
+                viewport[2] = static_cast<int>(region.x * scale.x);
+                viewport[3] = static_cast<int>(region.y * scale.y);
+
+                auto drawList = ImGui::GetWindowDrawList();
+                drawList->AddCallback(renderCallback, this);
+                drawList->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
+                ImGui::Dummy(region);
+            }
+            else {
+                // render texture contains video and/or lines && points
+                ImGui::Image(textureId, region, ImVec2(0, textureUV.y), ImVec2(textureUV.x, 0));
+            }
             
             // invisible button
             {
@@ -288,8 +354,9 @@ namespace ui {
             // slider
             if (hasVideo) {
                 constexpr int padding = 8;
+                const float timeline = timelineHeight();
                 auto cursor = ImGui::GetCursorScreenPos();
-                cursor.y -= ImGui::GetFrameHeightWithSpacing() + padding * 2 + 4;
+                cursor.y -= ImGui::GetFrameHeightWithSpacing() + padding * 2 + 4 + timeline;
                 ImGui::SetCursorScreenPos(cursor);
                 ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(padding, padding));
                 ImGui::BeginChild("slider", ImVec2(0, 0), ImGuiChildFlags_AlwaysUseWindowPadding);
@@ -299,6 +366,18 @@ namespace ui {
                 if (changedByUser && slideFn) {
                     slideFn(slider.progress, slider.hold);
                 }
+                if (loopTo >= 0.f) {
+                    drawLoopMarkers();
+                }
+                if (!cutMarks.empty()) {
+                    drawCutMarks();
+                }
+                if (!psnrPlot.empty() || !ssimPlot.empty()) {
+                    drawPlot();
+                }
+                if (timeline > 0.f) {
+                    drawTimeline(timeline);
+                }
                 ImGui::PopItemWidth();
                 ImGui::EndChild();
 
@@ -318,6 +397,118 @@ namespace ui {
                 closeFn();
             }
         }
+        void drawLoopMarkers() const {
+            // Over the track of the last drawn slider, the grab is centered on its value
+            const auto min = ImGui::GetItemRectMin();
+            const auto max = ImGui::GetItemRectMax();
+            const float grab = ImGui::GetStyle().GrabMinSize * 0.5f + ImGui::GetStyle().FramePadding.x * 0.5f;
+            const auto toX = [&](float progress) {
+                return min.x + grab + (max.x - min.x - 2 * grab) * progress / 100.f;
+            };
+
+            const ImU32 color = ImGui::GetColorU32(ImGuiCol_PlotHistogram);
+            auto drawList = ImGui::GetWindowDrawList();
+            drawList->AddRectFilled(ImVec2(toX(loopFrom), max.y - 3), ImVec2(toX(loopTo), max.y), color);
+            drawList->AddLine(ImVec2(toX(loopFrom), min.y), ImVec2(toX(loopFrom), max.y), color, 2.f);
+            drawList->AddLine(ImVec2(toX(loopTo), min.y), ImVec2(toX(loopTo), max.y), color, 2.f);
+        }
+        float timelineHeight() const {
+            constexpr float bitrateHeight = 18.f;
+            constexpr float typesHeight = 8.f;
+            const float spacing = ImGui::GetStyle().ItemSpacing.y;
+            return (bitrate.empty() ? 0.f : bitrateHeight + spacing) + (frameTypes.empty() ? 0.f : typesHeight + spacing);
+        }
+        void drawTimeline(float height) const {
+            /*
+                Bitrate graph of the whole video aligned with the slider track,
+                and picture types of the frames around the shown one in the middle.
+                All bars and cells go into one reservation of the draw list
+            */
+            const auto slider = ImGui::GetItemRectMin();
+            const auto sliderMax = ImGui::GetItemRectMax();
+            const float grab = ImGui::GetStyle().GrabMinSize * 0.5f + ImGui::GetStyle().FramePadding.x * 0.5f;
+            const float spacing = ImGui::GetStyle().ItemSpacing.y;
+            ImGui::Dummy(ImVec2(sliderMax.x - slider.x, height - spacing));
+            const auto min = ImGui::GetItemRectMin();
+            const auto max = ImGui::GetItemRectMax();
+            const float left = slider.x + grab;
+            const float width = sliderMax.x - slider.x - 2 * grab;
+            const float typesHeight = frameTypes.empty() ? 0.f : 8.f;
+            const float bitrateBottom = max.y - (typesHeight > 0.f ? typesHeight + spacing : 0.f);
+
+            auto drawList = ImGui::GetWindowDrawList();
+            const int rects = static_cast<int>(bitrate.size() + frameTypes.size());
+            drawList->PrimReserve(rects * 6, rects * 4);
+
+            const ImU32 barColor = ImGui::GetColorU32(ImGuiCol_PlotHistogram, 0.8f);
+            const float barHeight = bitrateBottom - min.y;
+            for (size_t i = 0; i < bitrate.size(); i++) {
+                const float x0 = left + width * i / bitrate.size();
+                const float x1 = left + width * (i + 1) / bitrate.size();
+                drawList->PrimRect(ImVec2(x0, bitrateBottom - barHeight * bitrate[i]), ImVec2(x1, bitrateBottom), barColor);
+            }
+
+            auto typeColor = [](char type) {
+                switch (type) {
+                case 'I': return IM_COL32(230, 80, 80, 255);
+                case 'P': return IM_COL32(90, 170, 240, 255);
+                case 'B': return IM_COL32(120, 200, 120, 255);
+                default:  return IM_COL32(128, 128, 128, 255);
+                }
+            };
+            const float cell = frameTypes.empty() ? 0.f : width / frameTypes.size();
+            for (size_t i = 0; i < frameTypes.size(); i++) {
+                const float x0 = left + cell * i;
+                // Gap between the cells while they are wide enough to have it
+                const float x1 = x0 + (cell >= 3.f ? cell - 1.f : cell);
+                drawList->PrimRect(ImVec2(x0, max.y - typesHeight), ImVec2(x1, max.y), typeColor(frameTypes[i]));
+            }
+            if (shownType >= 0) {
+                const float x0 = left + cell * shownType;
+                drawList->AddRect(ImVec2(x0 - 1, max.y - typesHeight - 1), ImVec2(x0 + cell, max.y + 1), IM_COL32(255, 255, 255, 255));
+            }
+        }
+        void drawCutMarks() const {
+            const auto min = ImGui::GetItemRectMin();
+            const auto max = ImGui::GetItemRectMax();
+            const float grab = ImGui::GetStyle().GrabMinSize * 0.5f + ImGui::GetStyle().FramePadding.x * 0.5f;
+            const float height = (max.y - min.y) * 0.35f;
+
+            const ImU32 color = IM_COL32(255, 255, 255, 140);
+            auto drawList = ImGui::GetWindowDrawList();
+            for (float progress : cutMarks) {
+                const float x = min.x + grab + (max.x - min.x - 2 * grab) * progress / 100.f;
+                drawList->AddLine(ImVec2(x, min.y), ImVec2(x, min.y + height), color);
+            }
+        }
+        void drawPlot() const {
+            // Per frame values as polylines inside the slider, measured frames only
+            const auto min = ImGui::GetItemRectMin();
+            const auto max = ImGui::GetItemRectMax();
+            const float grab = ImGui::GetStyle().GrabMinSize * 0.5f + ImGui::GetStyle().FramePadding.x * 0.5f;
+            const auto toScreen = [&](const ImVec2& point) {
+                return ImVec2(
+                    min.x + grab + (max.x - min.x - 2 * grab) * point.x / 100.f,
+                    max.y - 2 - (max.y - min.y - 4) * point.y);
+            };
+
+            auto drawList = ImGui::GetWindowDrawList();
+            const ImU32 colors[2] = { IM_COL32(90, 200, 255, 200), IM_COL32(255, 200, 90, 200) };
+            const std::vector<ImVec2>* plots[2] = { &psnrPlot, &ssimPlot };
+            for (int i = 0; i < 2; i++) {
+                std::vector<ImVec2> points;
+                points.reserve(plots[i]->size());
+                for (const auto& point : *plots[i]) {
+                    points.push_back(toScreen(point));
+                }
+                if (points.size() == 1) {
+                    drawList->AddCircleFilled(points[0], 1.5f, colors[i]);
+                }
+                else {
+                    drawList->AddPolyline(points.data(), static_cast<int>(points.size()), colors[i], ImDrawFlags_None, 1.f);
+                }
+            }
+        }
         bool updateSize(const ImVec2& newSize) {
             bool changed =
                 size.x != newSize.x ||
@@ -540,10 +731,86 @@ namespace ui {
         }
     };
 
+    /*
+        Scopes of the shown frame. Counts come with the frame from the loader thread,
+        here they are only shaded into textures when the frame or the brightness changes
+    */
+    struct ScopeView {
+        GLuint waveform = 0;
+        GLuint vectorscope = 0;
+        std::shared_ptr<const scopes::Counts> counts;
+        float brightness = 0.f;     // counts are shaded with
+        float histogram[scopes::levels] = {};
+        float histogramPeak = 0.f;
+        std::vector<uint8_t> shaded;
+        std::vector<uint8_t> pixels;
+
+        void update(std::shared_ptr<const scopes::Counts> value, float gain) {
+            if (value == counts && gain == brightness) {
+                return;
+            }
+            counts = std::move(value);
+            brightness = gain;
+            if (!counts) {
+                return;
+            }
+
+            histogramPeak = 0.f;
+            for (int i = 0; i < scopes::levels; i++) {
+                histogram[i] = static_cast<float>(counts->histogram[i]);
+                histogramPeak = std::max(histogramPeak, histogram[i]);
+            }
+            shaded.resize(scopes::waveformSize);
+            scopes::shade(counts->waveform, scopes::waveformSize, scopes::gain(counts->lumaSamples, scopes::waveformSize, brightness), shaded.data());
+            upload(waveform, scopes::waveWidth, scopes::levels);
+            shaded.resize(scopes::vectorscopeSize);
+            scopes::shade(counts->vectorscope, scopes::vectorscopeSize, scopes::gain(counts->chromaSamples, scopes::vectorscopeSize, brightness), shaded.data());
+            upload(vectorscope, scopes::vectorSize, scopes::vectorSize);
+        }
+        void upload(GLuint& textureId, int width, int height) {
+            // Intensity goes to alpha, the scope is tinted when drawn
+            pixels.resize(shaded.size() * 4);
+            for (size_t i = 0; i < shaded.size(); i++) {
+                pixels[4 * i] = 255;
+                pixels[4 * i + 1] = 255;
+                pixels[4 * i + 2] = 255;
+                pixels[4 * i + 3] = shaded[i];
+            }
+            if (!textureId) {
+                glGenTextures(1, &textureId);
+                gl::state().bindTexture(textureId);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            }
+            gl::state().bindTexture(textureId);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        }
+        void destroy() {
+            for (GLuint textureId : { waveform, vectorscope }) {
+                if (textureId) {
+                    gl::state().forgetTexture(textureId);
+                    glDeleteTextures(1, &textureId);
+                }
+            }
+            waveform = 0;
+            vectorscope = 0;
+            counts.reset();
+        }
+    };
+
     struct FrameController {
         Player& player;
         FrameRender& frameRender;
         FrameWindow& frameWindow;
+        uint64_t cutsVersion = ~0ull;   // scene cuts shown on the slider
+        uint64_t timelineVersion = ~0ull;
+        int64_t timelinePts = -1;       // frame types are shown around it
+        std::vector<PacketTimeline::Entry> packets;    // by pts
+        double bitrateAverage = 0.0;    // Mbit/s
+        double bitratePeak = 0.0;       // of the buckets of the graph
         void linkChildreen();
         void update(const time_point& now);
         void openFile(const string& path);
@@ -551,6 +818,10 @@ namespace ui {
         void togglePause();
         void seekLeft(bool isLong);
         void seekRight(bool isLong);
+        void setLoop(int mark);
+        void seekCut(int direction);
+        void updateCuts();
+        void updateTimeline();
         void updateCursor(const WorkMode& mode);
     };
 
@@ -560,8 +831,29 @@ namespace ui {
     bool openedColor = true;
     bool openedKeys = true;
     bool openedWorkspace = true;
+    bool openedStats = false;
+    bool useProxies = false;
+    bool detectScenes = false;
+    bool showTimeline = false;
+    bool showMotion = false;
+    bool openedCompare = false;
+    bool openedScopes = false;
+    int scopeSource = 0;        // frame of the scopes in split view
+    float scopeBrightness = 1.f;
+    ScopeView scopeView;
+    bool compareEnabled = false;
+    int compareMode = 0;        // 0 wipe, 1 difference, 2 blink
+    int blinkPeriod = 500;      // ms each frame is shown while blinking
+    Comparison compare;         // settings applied to frame 0, frame 1 is shown through it
+    CompareMetrics compareMetrics;
+    uint64_t compareVersion = ~0ull;    // metrics plotted on the slider
+    int64_t comparedPts[2] = { -1, -1 };
+    CompareMetrics::Value compareAverage;
+    size_t compareCount = 0;
     int drawLineWidth = 20;
     float drawLineColor[3] = { 1.0f, 0.0f, 0.0f };
+    bool drawLineSmooth = true;
+    int drawLineFrames = 0;
     FrameController* seekTarget = nullptr;
     FrameWindow* singleModeTarget = nullptr;
 
@@ -571,14 +863,30 @@ namespace ui {
     static void drawMainMenuBar(float& height);
     static void drawColorWindow();
     static void drawHotKeysWindow();
+    static void drawStatsWindow();
+    static void drawCompareWindow();
+    static void drawScopesWindow();
     static void setSplitMode(SplitMode mode);
+    static void setDirectComposite(bool direct);
+    static void setUseProxies(bool enabled);
+    static void setDetectScenes(bool enabled);
+    static void setShowTimeline(bool enabled);
+    static void setShowMotion(bool enabled);
+    static void setCompare(bool enabled);
+    static bool compareActive();
+    static void updateCompare(const time_point& now);
+    static void updateComparePlot();
+    static void updateScopes();
     static void setSeekTarget(FrameController* target, bool hovered);
     static void setLineWidth(int step);
     static void seekLeft(bool isLong);
     static void seekRight(bool isLong);
     static void togglePause();
+    static void setLoop(int mark);
+    static void seekCut(int direction);
     static void undoDrawing();
     static void clearDrawing(); 
+    static void eraseSelected();
     static void rotateVideo(float degrees);
     static void saveState(WorkState& ws);
     static void restoreState(const WorkState& ws);
@@ -682,6 +990,9 @@ static void ui::draw() {
 
     ui::drawColorWindow();
     ui::drawHotKeysWindow();
+    ui::drawStatsWindow();
+    ui::drawCompareWindow();
+    ui::drawScopesWindow();
 }
 static void ui::drawMainMenuBar(float& height) {
     if (ImGui::BeginMainMenuBar()) {
@@ -700,6 +1011,15 @@ static void ui::drawMainMenuBar(float& height) {
             if (ImGui::MenuItem("Workspace", nullptr, openedWorkspace)) { openedWorkspace = !openedWorkspace; }
             if (ImGui::MenuItem("Color", nullptr, openedColor)) { openedColor = !openedColor; }
             if (ImGui::MenuItem("Hot Keys", nullptr, openedKeys)) { openedKeys = !openedKeys; }   
+            if (ImGui::MenuItem("Statistics", nullptr, openedStats)) { openedStats = !openedStats; }
+            if (ImGui::MenuItem("Compare", nullptr, openedCompare)) { openedCompare = !openedCompare; }
+            if (ImGui::MenuItem("Scopes", nullptr, openedScopes)) { openedScopes = !openedScopes; }
+            ImGui::Separator();
+            if (ImGui::MenuItem("Direct composite", nullptr, ::render.direct)) { ui::setDirectComposite(!::render.direct); }
+            if (ImGui::MenuItem("Proxies for heavy video", nullptr, useProxies)) { ui::setUseProxies(!useProxies); }
+            if (ImGui::MenuItem("Detect scene cuts", nullptr, detectScenes)) { ui::setDetectScenes(!detectScenes); }
+            if (ImGui::MenuItem("Bitrate and frame types", nullptr, showTimeline)) { ui::setShowTimeline(!showTimeline); }
+            if (ImGui::MenuItem("Motion vectors", nullptr, showMotion)) { ui::setShowMotion(!showMotion); }
             ImGui::EndMenu();
         }
         
@@ -734,7 +1054,7 @@ static void ui::drawColorWindow() {
     }
 
     ImGui::SetNextWindowPos(ImVec2(285, 70), ImGuiCond_FirstUseEver);
-    ImGui::SetNextWindowSize(ImVec2(460, 100), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2(460, 150), ImGuiCond_FirstUseEver);
     if (ImGui::Begin("Color", &ui::openedColor, ImGuiWindowFlags_NoCollapse)) {
         
         bool changed = false;
@@ -744,6 +1064,15 @@ static void ui::drawColorWindow() {
             fc[0].frameRender.setBrush(ui::drawLineColor, ui::drawLineWidth); //todo: render.setBrush() instead of framecontroller?
             fc[1].frameRender.setBrush(ui::drawLineColor, ui::drawLineWidth); //todo: render.setBrush() --//-- ?
         }
+        if (ImGui::Checkbox("Smooth", &ui::drawLineSmooth)) {
+            fc[0].frameRender.setSmooth(ui::drawLineSmooth);
+            fc[1].frameRender.setSmooth(ui::drawLineSmooth);
+        }
+        if (ImGui::DragInt("Frames", &ui::drawLineFrames, 0.25f, 0, 1000, ui::drawLineFrames ? "%d" : "All")) {
+            fc[0].frameRender.setLineFrames(ui::drawLineFrames);
+            fc[1].frameRender.setLineFrames(ui::drawLineFrames);
+        }
+        ImGui::SetItemTooltip("Number of frames new lines are visible on, starting from the current one");
     }
     ImGui::End();
 }
@@ -754,7 +1083,7 @@ static void ui::drawHotKeysWindow() {
 
 
     ImGui::SetNextWindowPos(ImVec2(285, 200), ImGuiCond_FirstUseEver);
-    ImGui::SetNextWindowSize(ImVec2(460, 350), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2(460, 450), ImGuiCond_FirstUseEver);
     if (ImGui::Begin("Hot Keys", &ui::openedKeys, ImGuiWindowFlags_NoCollapse)) {
 
         {
@@ -769,6 +1098,12 @@ static void ui::drawHotKeysWindow() {
             ImGui::TextDisabled("[X]"); ImGui::SameLine(w1); ImGui::Text("Seek front (?)");
             ImGui::SetItemTooltip("+0.25s when paused\n+1.00s when normal playing");
 
+            ImGui::TextDisabled("[ [ ] / [ ] ]"); ImGui::SameLine(w1); ImGui::Text("Loop start / end (?)");
+            ImGui::SetItemTooltip("Frames of the loop are kept in memory,\nrepeating it doesn't decode the video again");
+            ImGui::TextDisabled("[ \\ ]"); ImGui::SameLine(w1); ImGui::Text("Clear loop");
+            ImGui::TextDisabled("[PG UP/DOWN]"); ImGui::SameLine(w1); ImGui::Text("Prev / next scene cut (?)");
+            ImGui::SetItemTooltip("Cuts are marked on the slider when\n'View > Detect scene cuts' is on");
+
             ImGui::TextDisabled("[ESC]"); ImGui::SameLine(w1); ImGui::Text("Clear all drawn");
             ImGui::TextDisabled("[CTRL + Z]"); ImGui::SameLine(w1); ImGui::Text("Clear last drawn");
 
@@ -811,6 +1146,164 @@ static void ui::drawHotKeysWindow() {
             ImGui::SameLine(w2); ImGui::Text("Zoom video");
 
         }
+
+        ImGui::Separator();
+        {
+            constexpr int w1 = 150;
+
+            ImGui::TextDisabled("[Key 3]");                 ImGui::SameLine(w1); ImGui::Text("Mode 3: edit drawn lines");
+            ImGui::TextDisabled("Mouse LEFT");              ImGui::SameLine(w1); ImGui::Text("Select line");
+            ImGui::TextDisabled("[CTRL] + Mouse LEFT");     ImGui::SameLine(w1); ImGui::Text("Add/remove line to selection");
+            ImGui::TextDisabled("Mouse RIGHT");             ImGui::SameLine(w1); ImGui::Text("Erase lines under cursor");
+            ImGui::TextDisabled("[DEL]");                   ImGui::SameLine(w1); ImGui::Text("Erase selected lines");
+        }
+    }
+    ImGui::End();
+}
+static void ui::drawStatsWindow() {
+    if (!ui::openedStats) {
+        return;
+    }
+
+    ImGui::SetNextWindowPos(ImVec2(285, 250), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2(360, 160), ImGuiCond_FirstUseEver);
+    if (ImGui::Begin("Statistics", &ui::openedStats, ImGuiWindowFlags_NoCollapse)) {
+        for (int i = 0; i < 2; i++) {
+            const auto& stats = fc[i].frameRender.uploadStats;
+            const double average = stats.frames ? static_cast<double>(stats.totalBytes) / stats.frames : 0.0;
+            ImGui::SeparatorText(i == 0 ? "Frame 0" : "Frame 1");
+            ImGui::Text("Upload: %.1f KB last, %.1f KB average", stats.frameBytes / 1024.0, average / 1024.0);
+            ImGui::Text("Dirty: %.1f%% of last frame", 100.f * stats.dirtyFraction);
+            ImGui::Text("Delta frames: %llu of %llu",
+                static_cast<unsigned long long>(stats.deltaFrames),
+                static_cast<unsigned long long>(stats.frames));
+            const auto& proxy = fc[i].player.proxyBuilder;
+            if (proxy.isRunning()) {
+                ImGui::Text("Proxy: building %.0f%%", 100.f * proxy.getProgress());
+            }
+            else if (proxy.isReady()) {
+                ImGui::Text("Proxy: ready");
+            }
+            const auto& scenes = fc[i].player.scenes;
+            if (scenes.isRunning()) {
+                ImGui::Text("Scene cuts: scanning %.0f%%", 100.f * scenes.getProgress());
+            }
+            const auto& timeline = fc[i].player.timeline;
+            if (timeline.isRunning()) {
+                ImGui::Text("Packets: reading %.0f%%", 100.f * timeline.getProgress());
+            }
+            if (!fc[i].packets.empty()) {
+                ImGui::Text("Bitrate: %.2f Mbit/s average, %.2f Mbit/s peak", fc[i].bitrateAverage, fc[i].bitratePeak);
+            }
+            if (ui::showMotion) {
+                ImGui::Text("Motion vectors: %zu", fc[i].frameRender.motionMesh.count);
+            }
+        }
+    }
+    ImGui::End();
+}
+static void ui::drawCompareWindow() {
+    if (!ui::openedCompare) {
+        return;
+    }
+
+    ImGui::SetNextWindowPos(ImVec2(285, 300), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2(360, 230), ImGuiCond_FirstUseEver);
+    if (ImGui::Begin("Compare", &ui::openedCompare, ImGuiWindowFlags_NoCollapse)) {
+        if (ImGui::Checkbox("Show Frame 1 through Frame 0", &ui::compareEnabled)) {
+            ui::setCompare(ui::compareEnabled);
+        }
+        if (ui::compareEnabled && !ui::compareActive()) {
+            ImGui::TextDisabled("Needs two videos of the same size in split view");
+        }
+
+        ImGui::RadioButton("Wipe", &ui::compareMode, 0);
+        ImGui::SameLine();
+        ImGui::RadioButton("Difference", &ui::compareMode, 1);
+        ImGui::SameLine();
+        ImGui::RadioButton("Blink", &ui::compareMode, 2);
+        if (ui::compareMode == 0) {
+            ImGui::SliderFloat("Split", &ui::compare.split, 0.f, 1.f, "%.2f");
+            ImGui::Checkbox("Vertical line", &ui::compare.vertical);
+        }
+        else if (ui::compareMode == 1) {
+            ImGui::SliderFloat("Gain", &ui::compare.gain, 1.f, 64.f, "%.1fx", ImGuiSliderFlags_Logarithmic);
+        }
+        else {
+            ImGui::SliderInt("Period, ms", &ui::blinkPeriod, 100, 2000);
+        }
+
+        ImGui::SeparatorText("Metrics");
+        CompareMetrics::Value value;
+        const RGBFrame* rgb = fc[0].player.currentFrame();
+        const RGBFrame* other = fc[1].player.currentFrame();
+        if (rgb && other && ui::compareMetrics.get(rgb->pts, other->pts, value)) {
+            ImGui::Text("Frame: PSNR %.2f dB, SSIM %.4f", value.psnr, value.ssim);
+        }
+        else {
+            ImGui::TextDisabled("Frame: not measured");
+        }
+        if (ui::compareCount) {
+            ImGui::Text("Average of %zu frames: PSNR %.2f dB, SSIM %.4f", ui::compareCount, ui::compareAverage.psnr, ui::compareAverage.ssim);
+        }
+        ImGui::SetItemTooltip("Plotted on the slider of Frame 0:\nPSNR 20..50 dB in blue, SSIM 0.5..1 in orange");
+    }
+    ImGui::End();
+}
+static void ui::drawScopesWindow() {
+    if (!ui::openedScopes) {
+        return;
+    }
+
+    ImGui::SetNextWindowPos(ImVec2(660, 60), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2(300, 560), ImGuiCond_FirstUseEver);
+    if (ImGui::Begin("Scopes", &ui::openedScopes, ImGuiWindowFlags_NoCollapse)) {
+        if (ui::splitMode != SplitMode::Single) {
+            ImGui::RadioButton("Frame 0", &ui::scopeSource, 0);
+            ImGui::SameLine();
+            ImGui::RadioButton("Frame 1", &ui::scopeSource, 1);
+        }
+        ImGui::SliderFloat("Brightness", &ui::scopeBrightness, 0.25f, 16.f, "%.2fx", ImGuiSliderFlags_Logarithmic);
+
+        const auto& view = ui::scopeView;
+        if (!view.counts) {
+            ImGui::TextDisabled("Shown frame has no planar YUV to measure");
+        }
+        else {
+            const float width = ImGui::GetContentRegionAvail().x;
+            const ImVec4 black = ImVec4(0.f, 0.f, 0.f, 1.f);
+            const ImU32 gridColor = IM_COL32(255, 200, 60, 160);
+            auto drawList = ImGui::GetWindowDrawList();
+
+            ImGui::SeparatorText("Histogram");
+            ImGui::PlotHistogram("##histogram", view.histogram, scopes::levels, 0, nullptr, 0.f, view.histogramPeak, ImVec2(width, 80));
+
+            // Levels 16 and 235 bound the video range of 8-bit luma
+            ImGui::SeparatorText("Waveform");
+            ImGui::ImageWithBg(view.waveform, ImVec2(width, 160), ImVec2(0, 0), ImVec2(1, 1), black, ImVec4(0.4f, 1.f, 0.5f, 1.f));
+            {
+                const ImVec2 min = ImGui::GetItemRectMin();
+                const ImVec2 max = ImGui::GetItemRectMax();
+                for (int level : { 16, 235 }) {
+                    const float y = min.y + (max.y - min.y) * (scopes::levels - 1 - level) / (scopes::levels - 1);
+                    drawList->AddLine(ImVec2(min.x, y), ImVec2(max.x, y), gridColor);
+                }
+            }
+
+            // Neutral colors gather in the center, saturation grows outwards
+            ImGui::SeparatorText("Vectorscope");
+            const float side = std::min(width, 240.f);
+            ImGui::ImageWithBg(view.vectorscope, ImVec2(side, side), ImVec2(0, 0), ImVec2(1, 1), black, ImVec4(1.f, 1.f, 1.f, 1.f));
+            {
+                const ImVec2 min = ImGui::GetItemRectMin();
+                const ImVec2 max = ImGui::GetItemRectMax();
+                const ImVec2 center = ImVec2(0.5f * (min.x + max.x), 0.5f * (min.y + max.y));
+                drawList->AddLine(ImVec2(min.x, center.y), ImVec2(max.x, center.y), gridColor);
+                drawList->AddLine(ImVec2(center.x, min.y), ImVec2(center.x, max.y), gridColor);
+                drawList->AddCircle(center, 0.5f * (max.x - min.x) * 112.f / 128.f, gridColor, 48);
+            }
+            ImGui::SetItemTooltip("Cb goes right, Cr goes up.\nCircle marks the limit of the video range");
+        }
     }
     ImGui::End();
 }
@@ -821,6 +1314,130 @@ static void ui::render() {
 
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    gl::state().invalidate(); // backend restores GL state behind the cache
+}
+static void ui::setDirectComposite(bool direct) {
+    ::render.direct = direct;
+    fc[0].frameWindow.direct = direct;
+    fc[1].frameWindow.direct = direct;
+    ::render.frames[0].dirty = true;
+    ::render.frames[1].dirty = true;
+}
+static void ui::setUseProxies(bool enabled) {
+    useProxies = enabled;
+    fc[0].player.setProxyEnabled(enabled);
+    fc[1].player.setProxyEnabled(enabled);
+}
+static void ui::setDetectScenes(bool enabled) {
+    detectScenes = enabled;
+    fc[0].player.setScenesEnabled(enabled);
+    fc[1].player.setScenesEnabled(enabled);
+}
+static void ui::setShowTimeline(bool enabled) {
+    showTimeline = enabled;
+    fc[0].player.setTimelineEnabled(enabled);
+    fc[1].player.setTimelineEnabled(enabled);
+}
+static void ui::setShowMotion(bool enabled) {
+    showMotion = enabled;
+    fc[0].frameRender.setShowMotion(enabled);
+    fc[1].frameRender.setShowMotion(enabled);
+    fc[0].player.setMotionEnabled(enabled);
+    fc[1].player.setMotionEnabled(enabled);
+}
+static void ui::setCompare(bool enabled) {
+    compareEnabled = enabled;
+    if (enabled) {
+        compareMetrics.start();
+    }
+    else {
+        compareMetrics.stop();
+        compareMetrics.clear();
+    }
+    comparedPts[0] = -1;
+    comparedPts[1] = -1;
+}
+static bool ui::compareActive() {
+    const auto& first = fc[0].frameRender.tiles;
+    const auto& second = fc[1].frameRender.tiles;
+    return compareEnabled && splitMode != SplitMode::Single &&
+        fc[0].player.ps.started && fc[1].player.ps.started &&
+        first.width == second.width && first.height == second.height;
+}
+static void ui::updateCompare(const time_point& now) {
+    using std::chrono::milliseconds;
+
+    // Frame 0 shows both frames, it follows every change of frame 1
+    const bool active = compareActive();
+    Comparison next = compare;
+    next.other = active ? &fc[1].frameRender : nullptr;
+    if (compareMode == 2) {
+        const auto ms = duration_cast<milliseconds>(now.time_since_epoch()).count();
+        next.mode = (ms / std::max(blinkPeriod, 1)) % 2 ? Comparison::Second : Comparison::First;
+    }
+    else {
+        next.mode = compareMode == 1 ? Comparison::Difference : Comparison::Wipe;
+    }
+
+    auto& frame = fc[0].frameRender;
+    if (!(frame.compare == next) || (active && fc[1].frameRender.dirty)) {
+        frame.compare = next;
+        frame.dirty = true;
+    }
+    updateComparePlot();
+    if (!active) {
+        return;
+    }
+
+    const RGBFrame* first = fc[0].player.currentFrame();
+    const RGBFrame* second = fc[1].player.currentFrame();
+    // Pair that can't be measured yet, e.g. a zoomed partial frame, is tried again when it is read whole
+    if (first && second && (first->pts != comparedPts[0] || second->pts != comparedPts[1]) &&
+        compareMetrics.add(*first, *second)) {
+        comparedPts[0] = first->pts;
+        comparedPts[1] = second->pts;
+    }
+}
+static void ui::updateScopes() {
+    // Frames are measured only while the scopes are open
+    fc[0].player.setScopesEnabled(openedScopes);
+    fc[1].player.setScopesEnabled(openedScopes);
+    if (!openedScopes) {
+        scopeView.update(nullptr, scopeBrightness);
+        return;
+    }
+
+    const bool second = splitMode == SplitMode::Single ? singleModeTarget == &fc[1].frameWindow : scopeSource == 1;
+    const RGBFrame* rgb = fc[second ? 1 : 0].player.currentFrame();
+    scopeView.update(rgb ? rgb->levels : nullptr, scopeBrightness);
+}
+static void ui::updateComparePlot() {
+    const uint64_t version = compareMetrics.version();
+    if (version == compareVersion) {
+        return;
+    }
+    compareVersion = version;
+
+    constexpr float psnrFrom = 20.f;
+    constexpr float psnrTo = 50.f;
+    constexpr float ssimFrom = 0.5f;
+    const auto values = compareMetrics.list();
+    const auto& info = fc[0].player.info;
+    std::vector<ImVec2> psnr, ssim;
+    psnr.reserve(values.size());
+    ssim.reserve(values.size());
+    double psnrSum = 0.0, ssimSum = 0.0;
+    for (const auto& [pts, value] : values) {
+        const float progress = info.calcProgress(pts);
+        psnr.emplace_back(progress, std::clamp((value.psnr - psnrFrom) / (psnrTo - psnrFrom), 0.f, 1.f));
+        ssim.emplace_back(progress, std::clamp((value.ssim - ssimFrom) / (1.f - ssimFrom), 0.f, 1.f));
+        psnrSum += value.psnr;
+        ssimSum += value.ssim;
+    }
+    compareCount = values.size();
+    compareAverage.psnr = compareCount ? static_cast<float>(psnrSum / compareCount) : 0.f;
+    compareAverage.ssim = compareCount ? static_cast<float>(ssimSum / compareCount) : 0.f;
+    fc[0].frameWindow.setPlot(std::move(psnr), std::move(ssim));
 }
 static void ui::setSplitMode(SplitMode mode) {
     splitMode = mode;
@@ -864,6 +1481,24 @@ static void ui::seekRight(bool isLong) {
         fc[1].seekRight(isLong);
     }
 }
+static void ui::setLoop(int mark) {
+    if (ui::seekTarget) {
+        ui::seekTarget->setLoop(mark);
+    }
+    else {
+        fc[0].setLoop(mark);
+        fc[1].setLoop(mark);
+    }
+}
+static void ui::seekCut(int direction) {
+    if (ui::seekTarget) {
+        ui::seekTarget->seekCut(direction);
+    }
+    else {
+        fc[0].seekCut(direction);
+        fc[1].seekCut(direction);
+    }
+}
 static void ui::togglePause() {
     if (ui::seekTarget) {
         ui::seekTarget->togglePause();
@@ -897,12 +1532,16 @@ static void ui::clearDrawing() {
         fc[1].frameRender.clearDrawing();
     }
 }
+static void ui::eraseSelected() {
+    fc[0].frameRender.eraseSelected();
+    fc[1].frameRender.eraseSelected();
+}
 static void ui::rotateVideo(float degrees) {
     if (fc[0].frameWindow.hovered()) {
-        fc[0].frameRender.cam.rotate(degrees);
+        fc[0].frameRender.rotateCam(degrees);
     }
     if (fc[1].frameWindow.hovered()) {
-        fc[1].frameRender.cam.rotate(degrees);
+        fc[1].frameRender.rotateCam(degrees);
     }
 }
 static void ui::saveState(WorkState& ws) {
@@ -914,6 +1553,12 @@ static void ui::saveState(WorkState& ws) {
     ws.drawLineColor[0] = ui::drawLineColor[0];
     ws.drawLineColor[1] = ui::drawLineColor[1];
     ws.drawLineColor[2] = ui::drawLineColor[2];
+    ws.drawLineSmooth   = ui::drawLineSmooth;
+    ws.drawLineFrames   = ui::drawLineFrames;
+    ws.useProxies       = ui::useProxies;
+    ws.detectScenes     = ui::detectScenes;
+    ws.showTimeline     = ui::showTimeline;
+    ws.showMotion       = ui::showMotion;
 }
 static void ui::restoreState(const WorkState& ws) {
     ui::openedColor      = ws.openedColor;
@@ -924,6 +1569,12 @@ static void ui::restoreState(const WorkState& ws) {
     ui::drawLineColor[0] = ws.drawLineColor[0];
     ui::drawLineColor[1] = ws.drawLineColor[1];
     ui::drawLineColor[2] = ws.drawLineColor[2];
+    ui::drawLineSmooth   = ws.drawLineSmooth;
+    ui::drawLineFrames   = ws.drawLineFrames;
+    ui::setUseProxies(ws.useProxies);
+    ui::setDetectScenes(ws.detectScenes);
+    ui::setShowTimeline(ws.showTimeline);
+    ui::setShowMotion(ws.showMotion);
 
     if (splitMode == SplitMode::Single) {
         singleModeTarget = &fc[0].frameWindow;
@@ -946,7 +1597,33 @@ static void cmd::openFolder() {
 static void cmd::quitProgram() {
     mainWindow.close();
 }
+namespace idle {
+    /*
+        When nothing is playing the main loop blocks in glfwWaitEventsTimeout.
+        Any input event or a frame from the loader thread (glfwPostEmptyEvent) wakes it up.
+        ImGui needs a few more frames after an event to settle hover and click states.
+    */
+    constexpr int settleFrames = 3;
+    constexpr double timeout = 1.0;
+    int activeFrames = settleFrames;
+
+    static void wakeUp() {
+        activeFrames = settleFrames;
+    }
+    static void waitEvents() {
+        bool playing = fc[0].player.active() || fc[1].player.active() ||
+            (ui::compareActive() && ui::compareMode == 2);    // blinking
+        if (playing || activeFrames > 0) {
+            activeFrames = std::max(0, activeFrames - 1);
+            glfwPollEvents();
+        }
+        else {
+            glfwWaitEventsTimeout(timeout);
+        }
+    }
+}
 static void reshapeCallback(GLFWwindow*, int w, int h) {
+    idle::wakeUp();
     mainWindow.reshape(w, h);
 }
 static void mouseCallback(FrameRender& frame, int mx, int my) {
@@ -1000,11 +1677,34 @@ static void mouseCallback(FrameRender& frame, int mx, int my) {
             frame.moveCursor(mx, my);
         }
     }
+    else if (workMode == ui::WorkMode::EditLines) {
+
+        if (io.MouseWheel) {
+            ui::setLineWidth(io.MouseWheel);
+            fc[0].frameRender.setBrush(ui::drawLineColor, ui::drawLineWidth);
+            fc[1].frameRender.setBrush(ui::drawLineColor, ui::drawLineWidth);
+        }
+
+        if (ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
+            frame.selectLine(mx, my, ImGui::IsKeyDown(ImGuiMod_Ctrl));
+        }
+        else if (ImGui::IsMouseClicked(ImGuiMouseButton_Right)) {
+            frame.eraseLines(mx, my);
+        }
+        else if (hasDelta) {
+            if (ImGui::IsMouseDown(ImGuiMouseButton_Right)) {
+                frame.eraseLines(mx, my);
+            }
+            frame.hoverLine(mx, my);
+            frame.moveCursor(mx, my);
+        }
+    }
 }
 static void keyCallback(GLFWwindow* window, int keyCode, int scanCode, int action, int mods) {
     using namespace io;
     using namespace io::keyboard;
 
+    idle::wakeUp();
     if (ImGui::GetIO().WantCaptureKeyboard) {
         return;
     }
@@ -1029,6 +1729,21 @@ static void keyCallback(GLFWwindow* window, int keyCode, int scanCode, int actio
     else if (key.pressed(X)) {
         ui::seekRight(true);
     }
+    else if (key.pressed(LEFT_BRACKET)) {
+        ui::setLoop(0);
+    }
+    else if (key.pressed(RIGHT_BRACKET)) {
+        ui::setLoop(1);
+    }
+    else if (key.pressed(BACKSLASH)) {
+        ui::setLoop(-1);
+    }
+    else if (key.pressed(PAGE_UP)) {
+        ui::seekCut(-1);
+    }
+    else if (key.pressed(PAGE_DOWN)) {
+        ui::seekCut(1);
+    }
     else if (key.pressed(ESC)) {
         ui::clearDrawing();
     }
@@ -1062,6 +1777,14 @@ static void keyCallback(GLFWwindow* window, int keyCode, int scanCode, int actio
         fc[0].updateCursor(ui::workMode.get());
         fc[1].updateCursor(ui::workMode.get());
     }
+    else if (key.pressed(KEY_3)) {
+        ui::workMode.set(ui::WorkMode::EditLines);
+        fc[0].updateCursor(ui::workMode.get());
+        fc[1].updateCursor(ui::workMode.get());
+    }
+    else if (key.pressed(DEL)) {
+        ui::eraseSelected();
+    }
     else if (key.is(LEFT_ALT) && action != Action::REPEAT) {
         ui::workMode.holdAlt(action == Action::PRESS);
         //todo: refactoring?
@@ -1084,6 +1807,14 @@ static void initWindow(GLFWwindow* window) {
     glfwWindowHint(GLFW_DOUBLEBUFFER, GL_TRUE);
     glfwSetKeyCallback(window, keyCallback);
     glfwSetFramebufferSizeCallback(window, reshapeCallback);
+    glfwSetCursorPosCallback(window, [](GLFWwindow*, double, double) { idle::wakeUp(); });
+    glfwSetMouseButtonCallback(window, [](GLFWwindow*, int, int, int) { idle::wakeUp(); });
+    glfwSetScrollCallback(window, [](GLFWwindow*, double, double) { idle::wakeUp(); });
+    glfwSetCharCallback(window, [](GLFWwindow*, unsigned int) { idle::wakeUp(); });
+    glfwSetWindowFocusCallback(window, [](GLFWwindow*, int) { idle::wakeUp(); });
+    glfwSetCursorEnterCallback(window, [](GLFWwindow*, int) { idle::wakeUp(); });
+    glfwSetWindowRefreshCallback(window, [](GLFWwindow*) { idle::wakeUp(); });
+    glfwSetDropCallback(window, [](GLFWwindow*, int, const char**) { idle::wakeUp(); });
     glfwSetWindowPos(window, 400, 200);
     glfwSwapInterval(1);
     glfwSetTime(0.0);
@@ -1123,13 +1854,20 @@ static void loadWorkspace() {
     //todo: make more clean
     render.frames[0].setBrush(ui::drawLineColor, ui::drawLineWidth);
     render.frames[1].setBrush(ui::drawLineColor, ui::drawLineWidth);
+    render.frames[0].setSmooth(ui::drawLineSmooth);
+    render.frames[1].setSmooth(ui::drawLineSmooth);
+    render.frames[0].setLineFrames(ui::drawLineFrames);
+    render.frames[1].setLineFrames(ui::drawLineFrames);
 }
 
 
 void ui::FrameController::linkChildreen() {
     frameWindow.hoverFrameFn = [this](bool hovered) {
         frameRender.drawReset();
-        frameRender.showCursor(hovered && ui::workMode.get() == DrawLines);
+        frameRender.showCursor(hovered && ui::workMode.get() != MoveVideo);
+        if (!hovered) {
+            frameRender.resetHover();
+        }
     };
     frameWindow.hoverSlideFn = [this](bool hovered) {
         ui::setSeekTarget(this, hovered);
@@ -1142,6 +1880,11 @@ void ui::FrameController::linkChildreen() {
     };
     frameWindow.reshapeFn = [this](const ImVec2& size) {
         frameRender.reshape(size.x, size.y);
+        auto uv = frameRender.fb.uvMax();
+        frameWindow.setTextureID(frameRender.fb.tid, ImVec2(uv.x, uv.y));
+    };
+    frameWindow.renderFn = [this](const int* viewport, const int* scissor) {
+        frameRender.renderDirect(::render.shaders, viewport, scissor);
     };
     frameWindow.acceptDropFn = [this](const string& path) {
         this->openFile(path);
@@ -1149,14 +1892,21 @@ void ui::FrameController::linkChildreen() {
     frameWindow.closeFn = [this]() {
         this->closeFile();
     };
-    frameWindow.setTextureID(frameRender.fb.tid);
+    frameWindow.setTextureID(frameRender.fb.tid, ImVec2(1, 1));
+    player.loader.setNotify([]() {
+        glfwPostEmptyEvent();
+    });
 }
 void ui::FrameController::update(const time_point& now) {
    
     if (player.hasUpdate(now)) {
         const RGBFrame* rgb = player.currentFrame();
+        if (rgb && !frameRender.showTexture(rgb->pts, rgb->proxy)) {
+            frameRender.updateTexture(*rgb);
+        }
         if (rgb) {
-            frameRender.updateTexture(rgb->width, rgb->height, rgb->pixels);
+            frameRender.showLines(rgb->pts, rgb->dur);
+            frameRender.updateMotion(*rgb);
         }
         frameWindow.setProgress(player.ps.progress, player.ps.seconds);
 
@@ -1170,6 +1920,29 @@ void ui::FrameController::update(const time_point& now) {
             }
         }
     }
+    else if (frameRender.missingTiles()) {
+        // Camera has reached pixels of the shown frame which were not uploaded yet
+        const RGBFrame* rgb = player.currentFrame();
+        if (rgb) {
+            frameRender.updateTexture(*rgb);
+        }
+        // Paused frame was converted only partially, playback catches up with the next frames
+        if (rgb && frameRender.missingTiles()) {
+            player.reload();
+        }
+    }
+
+    // Zoomed in view needs only a part of the next frames converted and uploaded
+    player.setRegion(frameRender.getRegionOfInterest());
+
+    if (player.hasLoop()) {
+        frameWindow.setLoop(player.info.calcProgress(player.loopFrom), player.info.calcProgress(player.loopTo));
+    }
+    else {
+        frameWindow.setLoop(-1.f, -1.f);
+    }
+    updateCuts();
+    updateTimeline();
     
 
 }
@@ -1177,8 +1950,9 @@ void ui::FrameController::openFile(const string& path) {
     if (player.start(path.c_str())) {
         const auto fileName = fs::path(path).filename().string();
         const auto& info = player.info;
-        frameRender.clearDrawing();
+        frameRender.openLines(path);
         frameRender.createTexture(info.width, info.height);
+        ui::compareMetrics.clear();
         frameWindow.setVideo(true);
         frameWindow.setName(fileName.c_str());
         cout << "File open - ok: " << path << endl;
@@ -1189,8 +1963,9 @@ void ui::FrameController::openFile(const string& path) {
 }
 void ui::FrameController::closeFile() {
     player.stop();
-    frameRender.clearDrawing();
+    frameRender.closeLines();
     frameRender.clearTexture();
+    ui::compareMetrics.clear();
     frameWindow.setVideo(false);
     frameWindow.setName(nullptr);
 }
@@ -1204,8 +1979,92 @@ void ui::FrameController::seekLeft(bool isLong) {
 void ui::FrameController::seekRight(bool isLong) {
     player.seekRight(isLong);
 }
+void ui::FrameController::setLoop(int mark) {
+    // 0 - loop start at the shown frame, 1 - loop end, otherwise no loop
+    if (mark == 0) {
+        player.setLoopStart();
+    }
+    else if (mark == 1) {
+        player.setLoopEnd();
+    }
+    else {
+        player.clearLoop();
+    }
+}
+void ui::FrameController::seekCut(int direction) {
+    player.seekCut(direction);
+}
+void ui::FrameController::updateCuts() {
+    const uint64_t version = player.scenesEnabled ? player.scenes.version() : 0;
+    if (version == cutsVersion) {
+        return;
+    }
+    cutsVersion = version;
+
+    std::vector<float> marks;
+    if (player.scenesEnabled) {
+        for (int64_t pts : player.scenes.list()) {
+            marks.push_back(player.info.calcProgress(pts));
+        }
+    }
+    frameWindow.setCuts(std::move(marks));
+}
+void ui::FrameController::updateTimeline() {
+    constexpr int buckets = 400;
+    constexpr int typesAround = 60;     // frames on each side of the shown one
+
+    const uint64_t version = player.timelineEnabled ? player.timeline.version() : 0;
+    const bool changed = version != timelineVersion;
+    if (changed) {
+        timelineVersion = version;
+        packets = player.timelineEnabled ? player.timeline.list() : std::vector<PacketTimeline::Entry>();
+
+        // Bytes per bucket of equal duration, scaled by the largest bucket
+        std::vector<double> bytes(packets.empty() ? 0 : buckets, 0.0);
+        double total = 0.0;
+        for (const auto& packet : packets) {
+            const int bucket = std::clamp(static_cast<int>(player.info.calcProgress(packet.pts) / 100.f * buckets), 0, buckets - 1);
+            bytes[bucket] += packet.size;
+            total += packet.size;
+        }
+        const double peak = bytes.empty() ? 0.0 : *std::max_element(bytes.begin(), bytes.end());
+        std::vector<float> values;
+        values.reserve(bytes.size());
+        for (double value : bytes) {
+            values.push_back(peak > 0.0 ? static_cast<float>(value / peak) : 0.f);
+        }
+        frameWindow.setBitrate(std::move(values));
+
+        const double seconds = player.info.ptsToMicros(player.info.durationPts) / 1e6;
+        bitrateAverage = seconds > 0.0 ? total * 8 / seconds / 1e6 : 0.0;
+        bitratePeak = seconds > 0.0 ? peak * 8 / (seconds / buckets) / 1e6 : 0.0;
+    }
+
+    if (!changed && timelinePts == player.ps.framePts) {
+        return;
+    }
+    timelinePts = player.ps.framePts;
+    std::vector<char> types;
+    int shown = -1;
+    if (!packets.empty()) {
+        auto it = std::lower_bound(packets.begin(), packets.end(), timelinePts, [](const PacketTimeline::Entry& entry, int64_t pts) {
+            return entry.pts < pts;
+        });
+        const auto center = std::min<ptrdiff_t>(it - packets.begin(), packets.size() - 1);
+        const auto from = std::max<ptrdiff_t>(center - typesAround, 0);
+        const auto to = std::min<ptrdiff_t>(center + typesAround + 1, packets.size());
+        for (auto i = from; i < to; i++) {
+            types.push_back(packets[i].type);
+        }
+        shown = static_cast<int>(center - from);
+    }
+    frameWindow.setFrameTypes(std::move(types), shown);
+}
 void ui::FrameController::updateCursor(const WorkMode& mode) {
-    frameRender.showCursor(frameWindow.frameHovered && mode == DrawLines);
+    frameRender.showCursor(frameWindow.frameHovered && mode != MoveVideo);
+    if (mode != EditLines) {
+        frameRender.resetHover();
+    }
 }
 
 int main(int argc, char* argv[]) {
@@ -1239,6 +2098,8 @@ int main(int argc, char* argv[]) {
         auto now = steady_clock::now();
         fc[0].update(now);
         fc[1].update(now); 
+        ui::updateCompare(now);
+        ui::updateScopes();
 
         glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
@@ -1250,12 +2111,14 @@ int main(int argc, char* argv[]) {
 
         glFlush();
         glfwSwapBuffers(window);
-        glfwPollEvents();
+        idle::waitEvents();
     }
 
     saveWorkspace();
+    ui::compareMetrics.stop();
     player0.stop();
     player1.stop();
+    ui::scopeView.destroy();
     render.destroyFrames();
     render.destroyShaders();
     render.destroyFrameBuffers();
@@ -0,0 +1,277 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <unordered_map>
+#include "annotations.h"
+#include "frame.h"
+
+using std::cout;
+using std::endl;
+
+namespace {
+	constexpr char magic[4] = { 'F', 'R', 'L', 'N' };
+	constexpr size_t headerSize = sizeof(magic) + sizeof(uint32_t);
+	constexpr size_t recordHeaderSize = sizeof(uint8_t) + sizeof(uint32_t);
+	constexpr size_t strokeHeaderSize = 3 * sizeof(int64_t) + 4 * sizeof(float) + sizeof(uint32_t);
+
+	struct Encoder {
+		std::vector<uint8_t>& out;
+		template<typename T>
+		void put(const T& value) {
+			auto bytes = reinterpret_cast<const uint8_t*>(&value);
+			out.insert(out.end(), bytes, bytes + sizeof(T));
+		}
+	};
+
+	struct Decoder {
+		const uint8_t* ptr;
+		template<typename T>
+		T get() {
+			T value;
+			std::memcpy(&value, ptr, sizeof(T));
+			ptr += sizeof(T);
+			return value;
+		}
+	};
+
+	std::vector<uint8_t> createRecord(uint8_t type, const std::vector<uint8_t>& payload) {
+		std::vector<uint8_t> result;
+		result.reserve(recordHeaderSize + payload.size());
+		Encoder e{ result };
+		e.put(type);
+		e.put(static_cast<uint32_t>(payload.size()));
+		result.insert(result.end(), payload.begin(), payload.end());
+		return result;
+	}
+
+	// Files opened by panes, on the UI thread
+	std::map<fs::path, std::weak_ptr<AnnotationFile>> openFiles;
+}
+
+AnnotationFile::~AnnotationFile() {
+	close();
+}
+std::shared_ptr<AnnotationFile> AnnotationFile::open(const fs::path& mediaPath) {
+	std::error_code ec;
+	auto key = fs::weakly_canonical(mediaPath, ec);
+	if (ec) {
+		key = mediaPath;
+	}
+	for (auto it = openFiles.begin(); it != openFiles.end();) {
+		it = it->second.expired() ? openFiles.erase(it) : std::next(it);
+	}
+
+	auto& entry = openFiles[key];
+	if (auto file = entry.lock()) {
+		return file;
+	}
+	auto file = std::make_shared<AnnotationFile>();
+	file->load(mediaPath);
+	entry = file;
+	return file;
+}
+void AnnotationFile::load(const fs::path& mediaPath) {
+	close();
+
+	path = mediaPath;
+	path += ".lines";
+	writable = true;
+	hasHeader = false;
+
+	std::error_code ec;
+	if (fs::exists(path, ec) && fs::file_size(path, ec) > 0) {
+		if (mapping.open(path)) {
+			size_t validSize = replay();
+
+			// Cut the record torn by a crash, so new records follow the valid ones
+			if (writable && validSize < mapping.size()) {
+				cout << "Annotations: truncated tail of " << toUTF8(path) << endl;
+				loaded.clear();
+				mapping.close();
+				fs::resize_file(path, validSize, ec);
+				if (mapping.open(path)) {
+					replay();
+				}
+			}
+		}
+		else {
+			cout << "Annotations: can't map " << toUTF8(path) << endl;
+			writable = false;
+		}
+	}
+
+	stopped = false;
+	t = std::thread([this]() {
+		writeLoop();
+	});
+}
+void AnnotationFile::close() {
+	if (t.joinable()) {
+		{
+			auto lock = std::lock_guard(mtx);
+			stopped = true;
+		}
+		cv.notify_one();
+		t.join();
+	}
+
+	mapping.close();
+	loaded.clear();
+	pending.clear();
+	path.clear();
+	writable = false;
+	idCounter = 0;
+}
+const std::vector<AnnotationFile::Stroke>& AnnotationFile::strokes() const {
+	return loaded;
+}
+uint64_t AnnotationFile::nextId() {
+	return idCounter++;
+}
+size_t AnnotationFile::replay() {
+	const uint8_t* data = mapping.data();
+	const size_t size = mapping.size();
+
+	Decoder d{ data };
+	if (size < headerSize || std::memcmp(data, magic, sizeof(magic)) != 0) {
+		cout << "Annotations: unknown format of " << toUTF8(path) << endl;
+		writable = false;
+		return size;
+	}
+	d.ptr += sizeof(magic);
+	if (d.get<uint32_t>() != formatVersion) {
+		cout << "Annotations: unsupported version of " << toUTF8(path) << endl;
+		writable = false;
+		return size;
+	}
+	hasHeader = true;
+
+	std::unordered_map<uint64_t, size_t> positions;
+	std::vector<bool> erased;
+	size_t offset = headerSize;
+	while (offset + recordHeaderSize <= size) {
+		d.ptr = data + offset;
+		auto type = d.get<uint8_t>();
+		auto payloadSize = d.get<uint32_t>();
+		if (offset + recordHeaderSize + payloadSize > size) {
+			break;
+		}
+
+		if (type == RecordType::AddStroke && payloadSize >= strokeHeaderSize) {
+			Stroke stroke;
+			stroke.id = d.get<uint64_t>();
+			stroke.ptsFrom = d.get<int64_t>();
+			stroke.ptsTo = d.get<int64_t>();
+			stroke.radius = d.get<float>();
+			stroke.color.r = d.get<float>();
+			stroke.color.g = d.get<float>();
+			stroke.color.b = d.get<float>();
+			stroke.record = d.ptr - data;
+			auto count = d.get<uint32_t>();
+			idCounter = std::max(idCounter, stroke.id + 1);
+
+			// Framing is intact, so only this stroke is skipped, records after it stay valid
+			if (strokeHeaderSize + static_cast<size_t>(count) * sizeof(glm::vec2) == payloadSize) {
+				positions[stroke.id] = loaded.size();
+				loaded.push_back(stroke);
+				erased.push_back(false);
+			}
+			else {
+				cout << "Annotations: skipped malformed stroke " << stroke.id << " of " << toUTF8(path) << endl;
+			}
+		}
+		else if (type == RecordType::EraseStroke && payloadSize == sizeof(uint64_t)) {
+			auto found = positions.find(d.get<uint64_t>());
+			if (found != positions.end()) {
+				erased[found->second] = true;
+				positions.erase(found);
+			}
+		}
+		else if (type == RecordType::ClearAll) {
+			erased.assign(erased.size(), true);
+			positions.clear();
+		}
+		offset += recordHeaderSize + payloadSize;
+	}
+
+	size_t alive = 0;
+	for (size_t i = 0; i < loaded.size(); i++) {
+		if (!erased[i]) {
+			loaded[alive++] = loaded[i];
+		}
+	}
+	loaded.resize(alive);
+	return offset;
+}
+void AnnotationFile::decode(size_t record, std::vector<glm::vec2>& points) const {
+	Decoder d{ mapping.data() + record };
+	auto count = d.get<uint32_t>();
+	points.resize(count);
+	std::memcpy(points.data(), d.ptr, count * sizeof(glm::vec2));
+}
+void AnnotationFile::appendStroke(const Line& line) {
+	std::vector<uint8_t> payload;
+	payload.reserve(strokeHeaderSize + line.points.size() * sizeof(glm::vec2));
+	Encoder e{ payload };
+	e.put(line.id);
+	e.put(line.ptsFrom);
+	e.put(line.ptsTo);
+	e.put(line.radius);
+	e.put(line.color.r);
+	e.put(line.color.g);
+	e.put(line.color.b);
+	e.put(static_cast<uint32_t>(line.points.size()));
+	for (const auto& point : line.points) {
+		e.put(point);
+	}
+	post(createRecord(RecordType::AddStroke, payload));
+}
+void AnnotationFile::appendErase(uint64_t id) {
+	std::vector<uint8_t> payload;
+	Encoder{ payload }.put(id);
+	post(createRecord(RecordType::EraseStroke, payload));
+}
+void AnnotationFile::appendClear() {
+	post(createRecord(RecordType::ClearAll, {}));
+}
+void AnnotationFile::post(const std::vector<uint8_t>& record) {
+	if (!writable) {
+		return;
+	}
+	{
+		auto lock = std::lock_guard(mtx);
+		pending.insert(pending.end(), record.begin(), record.end());
+	}
+	cv.notify_one();
+}
+void AnnotationFile::writeLoop() {
+	std::vector<uint8_t> buffer;
+	while (true) {
+		{
+			auto lock = std::unique_lock(mtx);
+			while (!stopped && pending.empty()) {
+				cv.wait(lock);
+			}
+			if (pending.empty()) {
+				return;
+			}
+			buffer.swap(pending);
+		}
+
+		std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::app);
+		if (!file.is_open()) {
+			cout << "Annotations: can't write " << toUTF8(path) << endl;
+			buffer.clear();
+			continue;
+		}
+		if (!hasHeader) {
+			file.write(magic, sizeof(magic));
+			file.write(reinterpret_cast<const char*>(&formatVersion), sizeof(formatVersion));
+			hasHeader = true;
+		}
+		file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+		buffer.clear();
+	}
+}
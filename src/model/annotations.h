@@ -0,0 +1,71 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+#include "util/fs.h"
+#include "util/mapfile.h"
+
+struct Line;
+
+/*
+    Strokes of a media file kept in the sidecar "<media file>.lines".
+    The sidecar is an append-only log of records: stroke added, stroke erased, all cleared.
+    Loading maps the file and replays the log reading only stroke headers,
+    points are decoded when the stroke becomes visible.
+    Records are appended by the background thread, so saving never blocks rendering.
+    Panes showing the same media share one file, it hands out stroke ids so they never collide
+*/
+class AnnotationFile {
+public:
+    static constexpr uint32_t formatVersion = 1;
+
+    struct Stroke {
+        uint64_t id;
+        int64_t ptsFrom;
+        int64_t ptsTo;
+        float radius;
+        glm::vec3 color;
+        size_t record;      // offset of encoded points in the mapped file
+    };
+
+    AnnotationFile() = default;
+    ~AnnotationFile();
+
+    static std::shared_ptr<AnnotationFile> open(const fs::path& mediaPath);
+    const std::vector<Stroke>& strokes() const;
+    uint64_t nextId();
+    void decode(size_t record, std::vector<glm::vec2>& points) const;
+    void appendStroke(const Line& line);
+    void appendErase(uint64_t id);
+    void appendClear();
+
+private:
+    enum RecordType : uint8_t {
+        AddStroke   = 1,
+        EraseStroke = 2,
+        ClearAll    = 3
+    };
+
+    fs::path path;
+    MappedFile mapping;
+    std::vector<Stroke> loaded;
+    bool writable = false;
+    bool hasHeader = false;
+    uint64_t idCounter = 0;
+
+    std::thread t;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<uint8_t> pending;   // encoded records waiting for the writer
+    bool stopped = false;
+
+    void load(const fs::path& mediaPath);
+    void close();
+    size_t replay();
+    void post(const std::vector<uint8_t>& record);
+    void writeLoop();
+};
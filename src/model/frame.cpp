@@ -1,16 +1,27 @@
-﻿#include <iostream>
+﻿#include <algorithm>
+#include <cfloat>
+#include <iostream>
+#include <glm/gtc/matrix_transform.hpp>
 #include "frame.h"
 #include "shader/shader.h"
+#include "shader/glstate.h"
 #include "util/math.h"
 
 using std::cout;
 using std::endl;
 
 namespace gl {
-	static GLuint createTexture(int16_t width, int16_t height) {
+	static GLint maxTextureSize() {
+		static GLint result = 0;
+		if (result == 0) {
+			glGetIntegerv(GL_MAX_TEXTURE_SIZE, &result);
+		}
+		return result;
+	}
+	static GLuint createTexture(int width, int height) {
 		GLuint videoTextureId = 0;
 		glGenTextures(1, &videoTextureId);
-		glBindTexture(GL_TEXTURE_2D, videoTextureId);
+		state().bindTexture(videoTextureId);
 		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -25,138 +36,550 @@ namespace gl {
 			GL_RGB,			        // Source format
 			GL_UNSIGNED_BYTE,		// Source data type
 			nullptr);               // Source data pointer
-		glBindTexture(GL_TEXTURE_2D, 0);
 		return videoTextureId;
 	}
-	static void updateTexture(GLuint textureId, int16_t width, int16_t height, const uint8_t* pixels) {
+	static void updateTexture(GLuint textureId, int x, int y, int fromX, int fromY, int width, int height, int rowLength, const uint8_t* pixels) {
 		//todo: Probably better to use PBO for streaming data
-		glBindTexture(GL_TEXTURE_2D, textureId);
+		// Rect of 'width' x 'height' from ['fromX', 'fromY'] of the image with 'rowLength' pixels per row
+		// goes to [x, y] of the texture
+		state().bindTexture(textureId);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
+		glPixelStorei(GL_UNPACK_SKIP_PIXELS, fromX);
+		glPixelStorei(GL_UNPACK_SKIP_ROWS, fromY);
 		glTexSubImage2D(GL_TEXTURE_2D,	// Target
 			0,							// Mip-level
-			0,							// X-offset
-			0,							// Y-offset
+			x,							// X-offset
+			y,							// Y-offset
 			width,						// Texture width
 			height,						// Texture height
 			GL_RGB,						// Source format
 			GL_UNSIGNED_BYTE,			// Source data type
 			pixels);					// Source data pointer
-		glBindTexture(GL_TEXTURE_2D, 0);
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+		glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
 	}
 }
 
 void FrameBuffer::create(float w, float h) {
-	width = w;
-	height = h;
-	
 	glGenFramebuffers(1, &fbo);
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-
 	glGenTextures(1, &tid);
-	glBindTexture(GL_TEXTURE_2D, tid);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+	reshape(w, h);
+}
+void FrameBuffer::reshape(float w, float h) {
+	width = std::max(1, static_cast<int>(w));
+	height = std::max(1, static_cast<int>(h));
+
+	// Reallocate only when outgrown or when most of the texture is unused
+	const bool outgrown = width > capacityWidth || height > capacityHeight;
+	const bool wasteful = 4 * width * height < capacityWidth * capacityHeight;
+	if (outgrown || wasteful) {
+		allocate(width, height);
+	}
+}
+void FrameBuffer::allocate(int w, int h) {
+	constexpr int granularity = 128;
+	auto grow = [](int size) {
+		int spare = ((size + size / 4 + granularity - 1) / granularity) * granularity;
+		return std::max(size, std::min(spare, static_cast<int>(gl::maxTextureSize())));
+	};
+	capacityWidth = grow(w);
+	capacityHeight = grow(h);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	gl::state().bindTexture(tid);
+	glTexImage2D(GL_TEXTURE_2D, 0, format, capacityWidth, capacityHeight, 0, format, GL_UNSIGNED_BYTE, NULL);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tid, 0);
-	glBindTexture(GL_TEXTURE_2D, 0);
-
-	glGenRenderbuffers(1, &rbo);
-	glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
-	glBindRenderbuffer(GL_RENDERBUFFER, 0);
 
 	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
 		cout << "Error: Framebuffer is not complete\n";
 	}
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
-void FrameBuffer::reshape(float w, float h) {
-	width = w;
-	height = h;
-	glBindTexture(GL_TEXTURE_2D, tid);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tid, 0);
-	glBindTexture(GL_TEXTURE_2D, 0);
-
-	glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
-	glBindRenderbuffer(GL_RENDERBUFFER, 0);
-}
 void FrameBuffer::destroy() {
 	glDeleteFramebuffers(1, &fbo);
-	glDeleteRenderbuffers(1, &rbo);
-	glDeleteTextures(1, &tid);
+	if (tid) {
+		gl::state().forgetTexture(tid);
+		glDeleteTextures(1, &tid);
+	}
 	fbo = 0;
-	rbo = 0;
 	tid = 0;
 	width = 0;
 	height = 0;
+	capacityWidth = 0;
+	capacityHeight = 0;
+}
+glm::vec2 FrameBuffer::uvMax() const {
+	if (capacityWidth == 0 || capacityHeight == 0) {
+		return { 1.f, 1.f };
+	}
+	return {
+		static_cast<float>(width) / capacityWidth,
+		static_cast<float>(height) / capacityHeight
+	};
 }
 
-void FrameRender::createTexture(int16_t width, int16_t height) {
-    if (imageMesh.textureId) {
-        glDeleteTextures(1, &imageMesh.textureId);
-    }
-	imageMesh = ImageMesh::createImageMesh(width, height);
-	imageMesh.textureId = gl::createTexture(width, height);
-	imageMesh.textureReady = false;
+void TileGrid::create(int w, int h, int tileSize) {
+	destroy();
+	width = w;
+	height = h;
+	tileSize = std::max(tileSize, 1);
+	for (int y = 0; y < h; y += tileSize) {
+		for (int x = 0; x < w; x += tileSize) {
+			Tile tile;
+			tile.x = x;
+			tile.y = y;
+			tile.width = std::min(tileSize, w - x);
+			tile.height = std::min(tileSize, h - y);
+
+			// Image space has y axis up, the first row of the frame is at the top
+			glm::vec2 from = { x, h - y - tile.height };
+			glm::vec2 to = { x + tile.width, h - y };
+			tile.mesh = ImageMesh::createImageMesh(from, to);
+			tile.mesh.upload();
+			tiles.emplace_back(std::move(tile));
+		}
+	}
+}
+void TileGrid::destroy() {
+	for (auto& tile : tiles) {
+		tile.mesh.destroy();
+	}
+	tiles.clear();
+	width = 0;
+	height = 0;
+}
+
+void TextureRing::create(int w, int h, size_t tiles) {
+	destroy();
+	width = w;
+	height = h;
+	tileCount = tiles;
+
+	size_t frameBytes = 4ull * std::max(w, 1) * std::max(h, 1); // GL_RGBA
+	capacity = std::clamp<size_t>(budgetBytes / frameBytes, 1, maxSlots);
+	slots.reserve(capacity);
+}
+void TextureRing::destroy() {
+	for (auto& slot : slots) {
+		gl::state().forgetTextures(slot.ids.data(), slot.ids.size());
+		glDeleteTextures(static_cast<GLsizei>(slot.ids.size()), slot.ids.data());
+	}
+	slots.clear();
+	if (copyFbo[0]) {
+		glDeleteFramebuffers(2, copyFbo);
+		copyFbo[0] = 0;
+		copyFbo[1] = 0;
+	}
+	capacity = 0;
+	active = 0;
+	useCounter = 0;
+	width = 0;
+	height = 0;
+	tileCount = 0;
+}
+void TextureRing::invalidate() {
+	for (auto& slot : slots) {
+		slot.pts = -1;
+		slot.proxy = false;
+		slot.lastUse = 0;
+		slot.loaded.assign(tileCount, FrameRegion());
+	}
+}
+bool TextureRing::select(int64_t pts, bool proxy) {
+	if (pts < 0) {
+		return false;
+	}
+	for (size_t i = 0; i < slots.size(); i++) {
+		if (slots[i].pts == pts && (!slots[i].proxy || proxy)) {
+			active = i;
+			slots[i].lastUse = ++useCounter;
+			return true;
+		}
+	}
+	return false;
+}
+size_t TextureRing::find(int64_t pts) const {
+	if (pts < 0) {
+		return slots.size();
+	}
+	for (size_t i = 0; i < slots.size(); i++) {
+		if (slots[i].pts == pts && !slots[i].proxy) {
+			return i;
+		}
+	}
+	return slots.size();
+}
+void TextureRing::copy(GLuint from, GLuint to, int w, int h) {
+	// Texture to texture copy on GPU through a pair of framebuffers
+	if (!copyFbo[0]) {
+		glGenFramebuffers(2, copyFbo);
+	}
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, copyFbo[0]);
+	glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, from, 0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, copyFbo[1]);
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, to, 0);
+	glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
+TextureRing::Slot& TextureRing::acquire(int64_t pts) {
+	if (slots.size() < capacity) {
+		Slot slot;
+		slot.ids.assign(tileCount, 0);
+		slots.emplace_back(std::move(slot));
+		active = slots.size() - 1;
+	}
+	else {
+		// Reuse least recently shown slot
+		active = 0;
+		for (size_t i = 1; i < slots.size(); i++) {
+			if (slots[i].lastUse < slots[active].lastUse) {
+				active = i;
+			}
+		}
+	}
+	// Proxy slot of the same frame is replaced rather than kept twice
+	for (size_t i = 0; i < slots.size(); i++) {
+		if (slots[i].pts == pts && slots[i].proxy) {
+			active = i;
+		}
+	}
+
+	auto& slot = slots[active];
+	slot.pts = pts;
+	slot.proxy = false;
+	slot.lastUse = ++useCounter;
+	slot.loaded.assign(tileCount, FrameRegion());
+	return slot;
+}
+const TextureRing::Slot* TextureRing::activeSlot() const {
+	return active < slots.size() ? &slots[active] : nullptr;
+}
+
+void FrameRender::createTexture(int width, int height) {
+	tiles.create(width, height, gl::maxTextureSize());
+	textures.create(width, height, tiles.tiles.size());
+	uploadStats = UploadStats();
+	textureReady = false;
+	overlay.valid = false;
     cam.init({ width * 0.5f, height * 0.5f }, 1.f);
+	dirty = true;
+}
+bool FrameRender::showTexture(int64_t pts, bool proxy) {
+	if (!textures.select(pts, proxy)) {
+		return false;
+	}
+	textureReady = true;
+	dirty = true;
+	return true;
 }
-void FrameRender::updateTexture(int16_t width, int16_t height, const uint8_t* pixels) {
-	gl::updateTexture(imageMesh.textureId, width, height, pixels);
-	imageMesh.textureReady = true;
+void FrameRender::updateTexture(const RGBFrame& frame) {
+	if (frame.width != tiles.width || frame.height != tiles.height) {
+		return;
+	}
+	if (textures.select(frame.pts, frame.proxy)) {
+		// Exact frame already on GPU isn't overwritten by its proxy
+		auto& slot = textures.slots[textures.active];
+		if (slot.proxy == frame.proxy) {
+			uploadTiles(slot, frame);
+		}
+		textureReady = true;
+		dirty = true;
+		return;
+	}
+
+	// Changed blocks are enough when the frame they are compared with is complete on GPU
+	const size_t base = textures.find(frame.basePts);
+	const bool delta = !frame.dirtyBlocks.empty() && base < textures.slots.size() && isComplete(textures.slots[base]);
+
+	uploadStats.frameBytes = 0;
+	auto& slot = textures.acquire(frame.pts);
+	slot.proxy = frame.proxy;
+	if (delta) {
+		if (textures.active != base) {
+			copyTiles(textures.slots[base], slot);
+		}
+		uploadBlocks(slot, frame);
+	}
+	else {
+		uploadTiles(slot, frame);
+	}
+
+	const auto dirtyBlocks = std::count(frame.dirtyBlocks.begin(), frame.dirtyBlocks.end(), 1);
+	uploadStats.frames++;
+	uploadStats.deltaFrames += delta ? 1 : 0;
+	uploadStats.dirtyFraction = delta ? static_cast<float>(dirtyBlocks) / frame.dirtyBlocks.size() : 1.f;
+	textureReady = true;
+	dirty = true;
+}
+void FrameRender::updateMotion(const RGBFrame& frame) {
+	if (showMotion) {
+		motionMesh.upload(frame.motion, frame.pts);
+		dirty = true;
+	}
+}
+void FrameRender::setShowMotion(bool show) {
+	if (showMotion != show) {
+		showMotion = show;
+		motionMesh.clear();
+		dirty = true;
+	}
+}
+void FrameRender::uploadTiles(TextureRing::Slot& slot, const RGBFrame& frame) {
+	// Tiles out of view are uploaded when the camera reaches them
+	glm::vec2 from, to;
+	getVisibleRect(from, to);
+	for (size_t i = 0; i < tiles.tiles.size(); i++) {
+		const auto& tile = tiles.tiles[i];
+		const FrameRegion rect = frame.region.intersect({ tile.x, tile.y, tile.width, tile.height });
+		if (rect.empty() || slot.loaded[i].contains(rect) || !isVisible(tile, from, to)) {
+			continue;
+		}
+		uploadRect(slot, i, rect, frame);
+		slot.loaded[i] = rect; // previous content may be kept too, but only one rect is tracked
+	}
+}
+void FrameRender::uploadBlocks(TextureRing::Slot& slot, const RGBFrame& frame) {
+	// Slot holds the base frame, dirty blocks of a row are uploaded in runs
+	const int columns = (frame.width + BlockDiff::blockSize - 1) / BlockDiff::blockSize;
+	const int rows = static_cast<int>(frame.dirtyBlocks.size()) / std::max(columns, 1);
+	const FrameRegion whole = { 0, 0, frame.width, frame.height };
+	for (int row = 0; row < rows; row++) {
+		const uint8_t* mask = frame.dirtyBlocks.data() + static_cast<size_t>(row) * columns;
+		for (int column = 0; column < columns; column++) {
+			if (!mask[column]) {
+				continue;
+			}
+			int end = column;
+			while (end < columns && mask[end]) {
+				end++;
+			}
+
+			constexpr int size = BlockDiff::blockSize;
+			const FrameRegion run = whole.intersect({ column * size, row * size, (end - column) * size, size });
+			for (size_t i = 0; i < tiles.tiles.size(); i++) {
+				const auto& tile = tiles.tiles[i];
+				const FrameRegion rect = run.intersect({ tile.x, tile.y, tile.width, tile.height });
+				if (!rect.empty()) {
+					uploadRect(slot, i, rect, frame);
+				}
+			}
+			column = end;
+		}
+	}
+	for (size_t i = 0; i < tiles.tiles.size(); i++) {
+		const auto& tile = tiles.tiles[i];
+		slot.loaded[i] = { tile.x, tile.y, tile.width, tile.height };
+	}
+}
+void FrameRender::uploadRect(TextureRing::Slot& slot, size_t tileIndex, const FrameRegion& rect, const RGBFrame& frame) {
+	const auto& tile = tiles.tiles[tileIndex];
+	if (!slot.ids[tileIndex]) {
+		slot.ids[tileIndex] = gl::createTexture(tile.width, tile.height);
+	}
+	gl::updateTexture(slot.ids[tileIndex], rect.x - tile.x, rect.y - tile.y, rect.x, rect.y, rect.width, rect.height, frame.width, frame.pixels);
+
+	const uint64_t bytes = 3ull * rect.width * rect.height;
+	uploadStats.frameBytes += bytes;
+	uploadStats.totalBytes += bytes;
+}
+void FrameRender::copyTiles(const TextureRing::Slot& from, TextureRing::Slot& to) {
+	for (size_t i = 0; i < tiles.tiles.size(); i++) {
+		const auto& tile = tiles.tiles[i];
+		if (!to.ids[i]) {
+			to.ids[i] = gl::createTexture(tile.width, tile.height);
+		}
+		textures.copy(from.ids[i], to.ids[i], tile.width, tile.height);
+	}
+}
+bool FrameRender::isComplete(const TextureRing::Slot& slot) const {
+	for (size_t i = 0; i < tiles.tiles.size(); i++) {
+		const auto& tile = tiles.tiles[i];
+		if (!(slot.loaded[i] == FrameRegion{ tile.x, tile.y, tile.width, tile.height })) {
+			return false;
+		}
+	}
+	return true;
+}
+const TextureRing::Slot* FrameRender::getCompareSlot() const {
+	const auto other = compare.other;
+	if (!other || !other->textureReady ||
+		other->tiles.width != tiles.width || other->tiles.height != tiles.height ||
+		other->tiles.tiles.size() != tiles.tiles.size()) {
+		return nullptr;
+	}
+	return other->textures.activeSlot();
+}
+bool FrameRender::missingTiles() const {
+	const auto slot = textures.activeSlot();
+	if (!textureReady || !slot) {
+		return false;
+	}
+
+	const FrameRegion visible = getVisibleRegion(0.f);
+	for (size_t i = 0; i < tiles.tiles.size(); i++) {
+		const auto& tile = tiles.tiles[i];
+		const FrameRegion rect = visible.intersect({ tile.x, tile.y, tile.width, tile.height });
+		if (!slot->loaded[i].contains(rect)) {
+			return true;
+		}
+	}
+	return false;
+}
+FrameRegion FrameRender::getRegionOfInterest() const {
+	/*
+		Part of the frame worth converting and uploading: visible area with a margin,
+		so panning doesn't run out of pixels before the next frames arrive.
+		Empty region means whole frame, when cutting doesn't save much
+	*/
+	constexpr float margin = 0.5f;	// of visible size on each side
+	const FrameRegion region = getVisibleRegion(margin);
+	const int64_t area = static_cast<int64_t>(region.width) * region.height;
+	const int64_t frameArea = static_cast<int64_t>(tiles.width) * tiles.height;
+	if (2 * area > frameArea) {
+		return {};
+	}
+	return region;
 }
 void FrameRender::clearTexture() {
-	imageMesh.textureReady = false;
+	textures.invalidate();
+	textureReady = false;
+	motionMesh.clear();
+	dirty = true;
 }
 void FrameRender::destroyTexture() {
-	if (imageMesh.textureId) {
-		glDeleteTextures(1, &imageMesh.textureId);
-		imageMesh.textureId = 0;
-		imageMesh.textureReady = false;
-	}
+	textures.destroy();
+	tiles.destroy();
+	textureReady = false;
+}
+void FrameRender::destroyMeshes() {
+	lineMesh.destroy();
+	strokeMesh.destroy();
+	highlightMesh.destroy();
+	cursor.mesh.destroy();
+	overlay.mesh.destroy();
+	overlay.fb.destroy();
+	overlay.valid = false;
+	motionMesh.destroy();
 }
 void FrameRender::reshape(int width, int height) {
 	cam.reshape(width, height);
 	fb.reshape(width, height);
+	dirty = true;
 }
 void FrameRender::moveCam(int dx, int dy) {
 	cam.move(dx, -dy);
+	dirty = true;
 }
 void FrameRender::zoomCam(float units) {
 	cam.zoom(units * 0.1f);
 	updateCursor();
+	dirty = true;
 }
-void FrameRender::render(ShaderContext& shaders) const {
-	
-	glBindFramebuffer(GL_FRAMEBUFFER, fb.fbo);
-	glBindRenderbuffer(GL_RENDERBUFFER, fb.rbo);
-	glBindTexture(GL_TEXTURE_2D, fb.tid);
+void FrameRender::rotateCam(float degrees) {
+	cam.rotate(degrees);
+	dirty = true;
+}
+void FrameRender::render(ShaderContext& shaders) {
+	lineMesh.upload();
+	strokeMesh.upload();
+	highlightMesh.upload();
+	cursor.mesh.upload();
+
+	if (overlayOutdated()) {
+		bakeOverlay(shaders);
+	}
 
+	glBindFramebuffer(GL_FRAMEBUFFER, fb.fbo);
 	glViewport(0, 0, fb.width, fb.height);
 	glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT);
 
-	shaders.video.enable();
-	shaders.video.render(*this);
-	shaders.video.disable();
-
-	shaders.lines.enable();
-	shaders.lines.render(*this);
-	shaders.lines.disable();
+	draw(shaders);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+void FrameRender::renderDirect(ShaderContext& shaders, const int viewport[4], const int scissor[4]) {
+	/*
+		Draws straight into the region of the default framebuffer,
+		called from ImGui draw callback, so ImGui restores its own state afterwards
+		and the state cache can't trust anything set before
+	*/
+	gl::state().invalidate();
+	if (scissor[2] <= 0 || scissor[3] <= 0) {
+		return;
+	}
+	lineMesh.upload();
+	strokeMesh.upload();
+	highlightMesh.upload();
+	cursor.mesh.upload();
 
-	shaders.point.enable();
-	for (const auto& line : lines) {
-		//shaders.point.render(cam, line.points);
+	glDisable(GL_SCISSOR_TEST);
+	if (overlayOutdated()) {
+		bakeOverlay(shaders);
 	}
-	shaders.point.disable();
 
-	glBindTexture(GL_TEXTURE_2D, 0);
-	glBindRenderbuffer(GL_RENDERBUFFER, 0);
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(scissor[0], scissor[1], scissor[2], scissor[3]);
+	glClearColor(0.1f, 0.1f, 0.15f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	draw(shaders);
+	dirty = false;
+}
+void FrameRender::draw(ShaderContext& shaders) {
+	// Baked texture becomes blurry when zoomed in deeper than it can be baked,
+	// in that case finished strokes are drawn directly
+	const bool useOverlay = overlay.valid && cam.scale.x < 1.25f * overlay.scale;
+
+	shaders.video.enable();
+	const auto slot = textures.activeSlot();
+	if (textureReady && slot) {
+		glm::vec2 from, to;
+		getVisibleRect(from, to);
+		const auto other = getCompareSlot();
+		const glm::vec2 frameSize = { tiles.width, tiles.height };
+		for (size_t i = 0; i < tiles.tiles.size(); i++) {
+			auto& tile = tiles.tiles[i];
+			if (!slot->loaded[i].empty() && isVisible(tile, from, to)) {
+				tile.mesh.textureId = slot->ids[i];
+				tile.mesh.textureReady = true;
+				// Tile of the other frame must hold at least the pixels of this one
+				if (other && other->loaded[i].contains(slot->loaded[i])) {
+					shaders.compare.enable();
+					shaders.compare.render(cam, tile.mesh, other->ids[i], compare, frameSize);
+				}
+				else {
+					shaders.video.enable();
+					shaders.video.render(cam, tile.mesh);
+				}
+			}
+		}
+	}
+	if (showMotion && textureReady) {
+		shaders.motion.enable();
+		shaders.motion.render(cam, static_cast<float>(tiles.height), motionMesh);
+	}
+	if (useOverlay) {
+		shaders.video.enable();
+		gl::state().setBlend(true);
+		gl::state().blendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+		shaders.video.render(cam, overlay.mesh);
+	}
+
+	shaders.lines.enable();
+	if (!useOverlay) {
+		shaders.lines.render(cam.proj, cam.view, cam.scale_inverse, lineSmooth, lineMesh);
+	}
+	shaders.lines.render(cam.proj, cam.view, cam.scale_inverse, lineSmooth, highlightMesh);
+	shaders.lines.render(cam.proj, cam.view, cam.scale_inverse, lineSmooth, strokeMesh);
+	if (drawType == DrawType::None && cursor.visible) {
+		shaders.lines.render(cam.proj, cam.view, cam.scale_inverse, lineSmooth, cursor.mesh);
+	}
 }
 
 glm::vec2 FrameRender::toOpenGLSpace(int x, int y) const {
@@ -171,6 +594,36 @@ glm::vec2 FrameRender::toOpenGLSpace(int x, int y) const {
     );
     return result;
 }
+void FrameRender::getVisibleRect(glm::vec2& from, glm::vec2& to) const {
+	// Bounds of the view corners in scene space, camera may be rotated
+	from = glm::vec2(FLT_MAX);
+	to = glm::vec2(-FLT_MAX);
+	for (const glm::vec2 corner : { glm::vec2(-1, -1), glm::vec2(1, -1), glm::vec2(1, 1), glm::vec2(-1, 1) }) {
+		auto point4D = cam.pv_inverse * glm::vec4(corner.x, corner.y, 0.5f, 1.f);
+		glm::vec2 point = { point4D.x / point4D.w, point4D.y / point4D.w };
+		from = glm::min(from, point);
+		to = glm::max(to, point);
+	}
+}
+FrameRegion FrameRender::getVisibleRegion(float margin) const {
+	glm::vec2 from, to;
+	getVisibleRect(from, to);
+	const glm::vec2 extra = margin * (to - from);
+	from -= extra;
+	to += extra;
+
+	// Image space has y axis up, frame rows go top-down
+	const int x0 = std::clamp(static_cast<int>(std::floor(from.x)), 0, tiles.width);
+	const int x1 = std::clamp(static_cast<int>(std::ceil(to.x)), 0, tiles.width);
+	const int y0 = std::clamp(static_cast<int>(std::floor(tiles.height - to.y)), 0, tiles.height);
+	const int y1 = std::clamp(static_cast<int>(std::ceil(tiles.height - from.y)), 0, tiles.height);
+	return { x0, y0, x1 - x0, y1 - y0 };
+}
+bool FrameRender::isVisible(const TileGrid::Tile& tile, const glm::vec2& from, const glm::vec2& to) const {
+	const auto& min = tile.mesh.position[0];
+	const auto& max = tile.mesh.position[2];
+	return min.x <= to.x && from.x <= max.x && min.y <= to.y && from.y <= max.y;
+}
 glm::vec2 FrameRender::toSceneSpace(int x, int y) const {
     auto point2D = toOpenGLSpace(x, y);	// x=[-1, 1], y=[-1, 1]
     auto point4D = cam.pv_inverse * glm::vec4(point2D.x, point2D.y, 0.5f, 1.f);
@@ -179,23 +632,36 @@ glm::vec2 FrameRender::toSceneSpace(int x, int y) const {
 float FrameRender::getLineRadius() const {
 	return 0.5f * lineWidth * cam.scale_inverse;
 }
+glm::vec3 FrameRender::getLineColor() const {
+	return { lineColor[0], lineColor[1], lineColor[2] };
+}
+float FrameRender::getSimplifyTolerance() const {
+	return simplifyTolerance * cam.scale_inverse;
+}
 void FrameRender::setBrush(const float color[3], float width) {
-	if (lineWidth != width) {
-		lineWidth = width;
-		
-		float radius = getLineRadius();
-		cursor.mesh.createPoint(0, cursor.position, radius);
-	}
-	
+	lineWidth = width;
 	lineColor[0] = color[0];
 	lineColor[1] = color[1];
 	lineColor[2] = color[2];
-	lineMesh.color[0] = color[0];
-	lineMesh.color[1] = color[1];
-	lineMesh.color[2] = color[2];
-	cursor.mesh.color[0] = color[0];
-	cursor.mesh.color[1] = color[1];
-	cursor.mesh.color[2] = color[2];
+
+	float radius = getLineRadius();
+	cursor.mesh.createPoint(cursor.position, radius, getLineColor());
+	dirty = true;
+}
+void FrameRender::setSmooth(bool smooth) {
+	if (lineSmooth != smooth) {
+		lineSmooth = smooth;
+
+		// Hit-testing follows the drawn shape, the active stroke isn't indexed yet
+		lineIndex.clear();
+		for (const auto& line : lines) {
+			if (drawType == DrawType::None || &line != &lines.back()) {
+				indexLine(line);
+			}
+		}
+		overlay.valid = false;
+		dirty = true;
+	}
 }
 void FrameRender::moveCursor(int x, int y) {
 	/*cout << "move cursor" << endl;*/
@@ -205,7 +671,10 @@ void FrameRender::moveCursor(int x, int y) {
 }
 void FrameRender::showCursor(bool visible) {
 	//cout << "show cursor " << visible << endl;
-	cursor.visible = visible;
+	if (cursor.visible != visible) {
+		cursor.visible = visible;
+		dirty = true;
+	}
 	if (cursor.visible) {
 		updateCursor();
 	}
@@ -214,50 +683,84 @@ void FrameRender::updateCursor() {
 	if (cursor.visible) {
 		float radius = getLineRadius();
 		cursor.position = toSceneSpace(cursor.screen.x, cursor.screen.y);
-		cursor.mesh.createPoint(0, cursor.position, radius);
+		cursor.mesh.createPoint(cursor.position, radius, getLineColor());
+		dirty = true;
 	}
 }
 
 namespace paint {
-	static void updateVertex(LineVertex* data, const Segment& s, float r) {
-		//if (s.openLeft && s.openRight) {
-		data[0] = LineVertex{ s.p1 - r * s.dir - r * s.n1, s.p1, s.p2, r };
-		data[1] = LineVertex{ s.p1 - r * s.dir + r * s.n1, s.p1, s.p2, r };
-		data[2] = LineVertex{ s.p2 + r * s.dir - r * s.n2, s.p1, s.p2, r };
-		data[3] = LineVertex{ s.p2 + r * s.dir + r * s.n2, s.p1, s.p2, r };
-		/*}
-		else if (s.openLeft) {
-			data[0] = LineVertex{ s.p1 - r * s.dir - r * s.n1, s.p1, s.p2, r };
-			data[1] = LineVertex{ s.p1 - r * s.dir + r * s.n1, s.p1, s.p2, r };
-			data[2] = LineVertex{ s.p2 - r * s.n2, s.p1, s.p2, r };
-			data[3] = LineVertex{ s.p2 + r * s.n2, s.p1, s.p2, r };
-		}
-		else if (s.openRight) {
-			data[0] = LineVertex{ s.p1 - r * s.n1, s.p1, s.p2, r };
-			data[1] = LineVertex{ s.p1 + r * s.n1, s.p1, s.p2, r };
-			data[2] = LineVertex{ s.p2 + r * s.dir - r * s.n2, s.p1, s.p2, r };
-			data[3] = LineVertex{ s.p2 + r * s.dir + r * s.n2, s.p1, s.p2, r };
-		}
-		else {
-			data[0] = LineVertex{ s.p1 - r * s.n1, s.p1, s.p2, r };
-			data[1] = LineVertex{ s.p1 + r * s.n1, s.p1, s.p2, r };
-			data[2] = LineVertex{ s.p2 - r * s.n2, s.p1, s.p2, r };
-			data[3] = LineVertex{ s.p2 + r * s.n2, s.p1, s.p2, r };
-		}*/
-	}
 	static void updateMesh(const Line& line, LineMesh& mesh) {
 		auto segmentCount = line.segments.size();
-		auto expectedSize = line.meshOffset + 4 * segmentCount;
-		while (mesh.vertex.size() < expectedSize) {
-			mesh.reserveQuad();
-		}
+		auto expectedSize = line.meshOffset + segmentCount;
+		mesh.reserve(expectedSize);
 
-		auto lastQuad = &mesh.vertex[0] + expectedSize - 4;
 		auto& segment = line.segments.back();
-		updateVertex(lastQuad, segment, line.radius);
+		auto& prev = segmentCount > 1 ?
+			line.segments[segmentCount - 2].p1 :
+			segment.p1;
+		mesh.instance[expectedSize - 1] = LineInstance{ segment.p1, segment.p2, prev, segment.p2, line.radius, line.color };
+		mesh.markDirty(expectedSize - 1, 1);
+
+		// Curve of the previous segment bends towards the last point
+		if (segmentCount > 1) {
+			mesh.instance[expectedSize - 2].next = segment.p2;
+			mesh.markDirty(expectedSize - 2, 1);
+		}
+	}
+	// Catmull-Rom curve of lines.glsl between p1 and p2
+	static glm::vec2 curvePoint(const glm::vec2& prev, const glm::vec2& p1, const glm::vec2& p2, const glm::vec2& next, float t) {
+		const glm::vec2 a = 2.f * p1;
+		const glm::vec2 b = p2 - prev;
+		const glm::vec2 c = 2.f * prev - 5.f * p1 + 4.f * p2 - next;
+		const glm::vec2 d = 3.f * p1 - prev - 3.f * p2 + next;
+		return 0.5f * (a + t * (b + t * (c + t * d)));
+	}
+	// Calls fn(p1, p2) for the pieces of the line as the shader draws it, smooth curve is split like in lines.glsl
+	template<typename Fn>
+	static void forEachPiece(const Line& line, bool smooth, Fn fn) {
+		constexpr int curveSteps = 8;
+		const auto& segments = line.segments;
+		const auto count = segments.size();
+		for (size_t i = 0; i < count; i++) {
+			const auto& segment = segments[i];
+			if (!smooth) {
+				fn(segment.p1, segment.p2);
+				continue;
+			}
+			const auto& prev = (i > 0) ? segments[i - 1].p1 : segment.p1;
+			const auto& next = (i + 1 < count) ? segments[i + 1].p2 : segment.p2;
+			glm::vec2 start = segment.p1;
+			for (int step = 1; step <= curveSteps; step++) {
+				const glm::vec2 end = curvePoint(prev, segment.p1, segment.p2, next, static_cast<float>(step) / curveSteps);
+				fn(start, end);
+				start = end;
+			}
+		}
 	}
-	static void drawPoint(Line& line, LineMesh& mesh, const glm::vec2& pos) {
-		line.addPoint(pos);
+	static void fillMesh(const Line& line, LineMesh& mesh) {
+		const auto& segments = line.segments;
+		const auto count = segments.size();
+		mesh.reserve(line.meshOffset + count);
+
+		for (size_t i = 0; i < count; i++) {
+			const auto& segment = segments[i];
+			const auto& prev = (i > 0) ? segments[i - 1].p1 : segment.p1;
+			const auto& next = (i + 1 < count) ? segments[i + 1].p2 : segment.p2;
+			mesh.instance[line.meshOffset + i] = LineInstance{ segment.p1, segment.p2, prev, next, line.radius, line.color };
+		}
+		mesh.markDirty(line.meshOffset, count);
+	}
+	static void drawPoint(Line& line, LineMesh& mesh, PolylineSimplifier& simplifier, const glm::vec2& pos, float tolerance) {
+		if (line.points.empty()) {
+			simplifier.reset(pos);
+			line.addPoint(pos);
+		} 
+		else if (simplifier.push(pos, tolerance) == PolylineSimplifier::Result::Append) {
+			line.addPoint(pos);
+		} 
+		else {
+			line.moveLast(pos);
+		}
 		updateMesh(line, mesh);
 	}
 	static void drawSegment(Line& line, LineMesh& mesh, const glm::vec2& pos) {
@@ -268,10 +771,10 @@ namespace paint {
 		}
 		updateMesh(line, mesh);
 	}
-	static void draw(Line& line, LineMesh& mesh, const glm::vec2& pos, DrawType type) {
+	static void draw(Line& line, LineMesh& mesh, PolylineSimplifier& simplifier, const glm::vec2& pos, float tolerance, DrawType type) {
 		switch (type) {
 		case DrawType::Points: { 
-			drawPoint(line, mesh, pos); 
+			drawPoint(line, mesh, simplifier, pos, tolerance); 
 			break; 
 		}
 		case DrawType::Segments: { 
@@ -293,9 +796,15 @@ void FrameRender::drawStart(int x, int y, DrawType type) {
 	drawType = type;
 	auto pos = toSceneSpace(x, y);
 	auto radius = getLineRadius();
-	auto offset = lineMesh.offset();
-	Line& line = lines.emplace_back(Line(radius, offset));
-	paint::draw(line, lineMesh, pos, drawType);
+	Line& line = lines.emplace_back(Line(radius, getLineColor(), 0));
+	line.id = annotations ? annotations->nextId() : lineCounter++;
+	sessionLines = std::min(sessionLines, line.id);
+	if (lineFrames > 0 && frameDur > 0) {
+		line.ptsFrom = framePts;
+		line.ptsTo = framePts + lineFrames * frameDur;
+	}
+	paint::draw(line, strokeMesh, simplifier, pos, getSimplifyTolerance(), drawType);
+	dirty = true;
 }
 void FrameRender::drawNext(int x, int y) {
 
@@ -304,7 +813,8 @@ void FrameRender::drawNext(int x, int y) {
 	}
 
 	auto pos = toSceneSpace(x, y);
-	paint::draw(lines.back(), lineMesh, pos, drawType);
+	paint::draw(lines.back(), strokeMesh, simplifier, pos, getSimplifyTolerance(), drawType);
+	dirty = true;
 }
 void FrameRender::drawStop(int x, int y) {
 
@@ -313,12 +823,87 @@ void FrameRender::drawStop(int x, int y) {
 	}
 
 	auto pos = toSceneSpace(x, y);
-	paint::draw(lines.back(), lineMesh, pos, drawType);
-	drawType = DrawType::None;
+	paint::draw(lines.back(), strokeMesh, simplifier, pos, getSimplifyTolerance(), drawType);
+	finishStroke();
+	dirty = true;
 }
 void FrameRender::drawReset() {
 	if (drawType != DrawType::None) {
-		drawType = DrawType::None;
+		finishStroke();
+		dirty = true;
+	}
+}
+void FrameRender::finishStroke() {
+	// Move instances of the active stroke to finished ones
+	auto& line = lines.back();
+	line.meshOffset = lineMesh.offset();
+	lineMesh.reserve(line.meshOffset + strokeMesh.instance.size());
+	std::copy(strokeMesh.instance.begin(), strokeMesh.instance.end(), lineMesh.instance.begin() + line.meshOffset);
+	strokeMesh.clear();
+	drawType = DrawType::None;
+	overlay.valid = false;
+	indexLine(line);
+	lineTimes.insert(line.ptsFrom, line.ptsTo, &line);
+	visibleLines.push_back(&line);
+	if (annotations) {
+		annotations->appendStroke(line);
+	}
+}
+void FrameRender::setLineFrames(int frames) {
+	lineFrames = frames;
+}
+void FrameRender::showLines(int64_t pts, int64_t dur) {
+	framePts = pts;
+	frameDur = dur;
+
+	std::vector<Line*> visible;
+	lineTimes.query(pts, [&visible](Line* line) { visible.push_back(line); });
+	std::sort(visible.begin(), visible.end(), [](const Line* left, const Line* right) { 
+		return left->id < right->id; 
+	});
+	if (visible == visibleLines) {
+		return;
+	}
+	visibleLines = std::move(visible);
+	for (auto line : visibleLines) {
+		if (line->record) {
+			decodeLine(*line);
+		}
+	}
+
+	// Strokes of other frames can't stay selected
+	selectedLines.erase(std::remove_if(selectedLines.begin(), selectedLines.end(), [this](const Line* line) {
+		return !isVisible(line);
+	}), selectedLines.end());
+	if (hoveredLine && !isVisible(hoveredLine)) {
+		hoveredLine = nullptr;
+	}
+
+	updateLineMesh();
+	updateHighlight();
+	overlay.valid = false;
+	dirty = true;
+}
+bool FrameRender::isVisible(const Line* line) const {
+	auto found = std::lower_bound(visibleLines.begin(), visibleLines.end(), line, [](const Line* left, const Line* right) {
+		return left->id < right->id;
+	});
+	return found != visibleLines.end() && *found == line;
+}
+void FrameRender::decodeLine(Line& line) {
+	std::vector<glm::vec2> points;
+	annotations->decode(line.record, points);
+	for (const auto& point : points) {
+		line.addPoint(point);
+	}
+	line.record = 0;
+	indexLine(line);
+}
+void FrameRender::updateLineMesh() {
+	lineMesh.clear();
+	for (auto line : visibleLines) {
+		line->meshOffset = lineMesh.offset();
+		paint::fillMesh(*line, lineMesh);
 	}
 }
 void FrameRender::undoDrawing() {
@@ -326,12 +911,256 @@ void FrameRender::undoDrawing() {
 		return;
 	}
 
-	lineMesh.trim(lines.back().meshOffset);
-	lines.pop_back();
+	if (drawType != DrawType::None) {
+		strokeMesh.clear();
+		drawType = DrawType::None;
+		lines.pop_back();
+	} else if (lines.back().id >= sessionLines) {
+		eraseLine(&lines.back());
+	}
+	dirty = true;
 }
 void FrameRender::clearDrawing() {
+	if (annotations && !lines.empty()) {
+		// Other pane may have strokes this one doesn't know about
+		if (annotations.use_count() > 1) {
+			for (const auto& line : lines) {
+				annotations->appendErase(line.id);
+			}
+		} else {
+			annotations->appendClear();
+		}
+	}
 	lines.clear();
+	lineTimes.clear();
+	visibleLines.clear();
+	lineIndex.clear();
+	selectedLines.clear();
+	hoveredLine = nullptr;
 	lineMesh.clear();
+	strokeMesh.clear();
+	highlightMesh.clear();
+	drawType = DrawType::None;
+	overlay.valid = false;
+	dirty = true;
+}
+void FrameRender::openLines(const std::string& mediaPath) {
+	closeLines();
+	annotations = AnnotationFile::open(fs::path(mediaPath));
+
+	std::vector<IntervalTree<Line*>::Interval> intervals;
+	for (const auto& stroke : annotations->strokes()) {
+		Line& line = lines.emplace_back(Line(stroke.radius, stroke.color, 0));
+		line.id = stroke.id;
+		line.ptsFrom = stroke.ptsFrom;
+		line.ptsTo = stroke.ptsTo;
+		line.record = stroke.record;
+		intervals.push_back({ line.ptsFrom, line.ptsTo, &line });
+	}
+	lineTimes.insert(intervals);
+}
+void FrameRender::closeLines() {
+	// Release first: strokes removed with the file must not be logged as cleared
+	annotations.reset();
+	clearDrawing();
+	sessionLines = UINT64_MAX;
+}
+void FrameRender::hoverLine(int x, int y) {
+	if (drawType != DrawType::None) {
+		return;
+	}
+
+	auto line = findLine(toSceneSpace(x, y), 2.f * cam.scale_inverse);
+	if (hoveredLine != line) {
+		hoveredLine = line;
+		updateHighlight();
+	}
+}
+void FrameRender::resetHover() {
+	if (hoveredLine) {
+		hoveredLine = nullptr;
+		updateHighlight();
+	}
+}
+void FrameRender::selectLine(int x, int y, bool add) {
+	if (drawType != DrawType::None) {
+		return;
+	}
+
+	auto line = findLine(toSceneSpace(x, y), 2.f * cam.scale_inverse);
+	auto found = std::find(selectedLines.begin(), selectedLines.end(), line);
+	if (!add) {
+		selectedLines.clear();
+		if (line) {
+			selectedLines.push_back(line);
+		}
+	}
+	else if (found != selectedLines.end()) {
+		selectedLines.erase(found);
+	}
+	else if (line) {
+		selectedLines.push_back(line);
+	}
+	updateHighlight();
+}
+void FrameRender::eraseLines(int x, int y) {
+	if (drawType != DrawType::None) {
+		return;
+	}
+
+	auto pos = toSceneSpace(x, y);
+	auto radius = getLineRadius();
+	while (auto line = findLine(pos, radius)) {
+		eraseLine(line);
+	}
+}
+void FrameRender::eraseSelected() {
+	if (drawType != DrawType::None) {
+		return;
+	}
+
+	while (!selectedLines.empty()) {
+		eraseLine(selectedLines.back());
+	}
+}
+const Line* FrameRender::findLine(const glm::vec2& pos, float radius) const {
+	// Topmost is the one drawn last
+	const Line* result = nullptr;
+	lineIndex.query(pos, radius, [this, &result](const Line* line) {
+		if ((!result || line->id > result->id) && isVisible(line)) {
+			result = line;
+		}
+	});
+	return result;
+}
+void FrameRender::indexLine(const Line& line) {
+	paint::forEachPiece(line, lineSmooth, [this, &line](const glm::vec2& p1, const glm::vec2& p2) {
+		lineIndex.insert(&line, p1, p2, line.radius);
+	});
+}
+void FrameRender::eraseLine(const Line* line) {
+	auto it = std::find_if(lines.begin(), lines.end(), [line](const Line& item) { return &item == line; });
+	if (it == lines.end()) {
+		return;
+	}
+
+	paint::forEachPiece(*line, lineSmooth, [this, line](const glm::vec2& p1, const glm::vec2& p2) {
+		lineIndex.remove(line, p1, p2, line->radius);
+	});
+	lineTimes.remove(&*it);
+	if (annotations) {
+		annotations->appendErase(line->id);
+	}
+
+	// Instances of later visible strokes shift into the gap
+	auto visible = std::find(visibleLines.begin(), visibleLines.end(), &*it);
+	if (visible != visibleLines.end()) {
+		const size_t count = line->segments.size();
+		lineMesh.erase(line->meshOffset, count);
+		for (auto next = std::next(visible); next != visibleLines.end(); next++) {
+			(*next)->meshOffset -= count;
+		}
+		visibleLines.erase(visible);
+	}
+
+	selectedLines.erase(std::remove(selectedLines.begin(), selectedLines.end(), line), selectedLines.end());
+	if (hoveredLine == line) {
+		hoveredLine = nullptr;
+	}
+	lines.erase(it);
+
+	updateHighlight();
+	overlay.valid = false;
+	dirty = true;
+}
+void FrameRender::updateHighlight() {
+	// Selected strokes get inverted color, hovered one is brightened
+	highlightMesh.clear();
+	auto append = [this](const Line* line, bool selected) {
+		auto from = highlightMesh.offset();
+		auto count = line->segments.size();
+		highlightMesh.reserve(from + count);
+		for (size_t i = 0; i < count; i++) {
+			auto instance = lineMesh.instance[line->meshOffset + i];
+			instance.color = selected ? 
+				glm::vec3(1.f) - instance.color : 
+				glm::mix(instance.color, glm::vec3(1.f), 0.5f);
+			highlightMesh.instance[from + i] = instance;
+		}
+	};
+	for (auto line : selectedLines) {
+		append(line, true);
+	}
+	bool hoveredSelected = std::find(selectedLines.begin(), selectedLines.end(), hoveredLine) != selectedLines.end();
+	if (hoveredLine && !hoveredSelected) {
+		append(hoveredLine, false);
+	}
+	dirty = true;
+}
+float FrameRender::getOverlayScale(const glm::vec2& extent) const {
+	float maxSize = std::min(Overlay::maxSize, gl::maxTextureSize());
+	float maxScale = std::min(maxSize / std::max(extent.x, 1.f), maxSize / std::max(extent.y, 1.f));
+	return std::min(std::abs(cam.scale.x), maxScale);
+}
+bool FrameRender::overlayOutdated() const {
+	if (lineMesh.empty()) {
+		return false;
+	}
+	if (!overlay.valid) {
+		return true;
+	}
+
+	// Rebake when texel density differs from the screen enough to be visible
+	glm::vec2 extent = overlay.mesh.position[2] - overlay.mesh.position[0];
+	float ratio = getOverlayScale(extent) / overlay.scale;
+	return ratio > 1.25f || ratio < 0.5f;
+}
+void FrameRender::bakeOverlay(ShaderContext& shaders) {
+
+	// Bounds of image and visible finished strokes in scene space
+	glm::vec2 from = { 0, 0 };
+	glm::vec2 to = { textures.width, textures.height };
+	for (const auto line : visibleLines) {
+		for (const auto& point : line->points) {
+			from = glm::min(from, point - line->radius);
+			to = glm::max(to, point + line->radius);
+		}
+	}
+
+	const glm::vec2 extent = to - from;
+	const float scale = getOverlayScale(extent);
+	const int width = std::max(1, static_cast<int>(std::ceil(extent.x * scale)));
+	const int height = std::max(1, static_cast<int>(std::ceil(extent.y * scale)));
+
+	auto& fb = overlay.fb;
+	if (!fb.fbo) {
+		fb.format = GL_RGBA;
+		fb.create(width, height);
+	} else if (fb.width != width || fb.height != height) {
+		fb.reshape(width, height);
+	}
+
+	overlay.mesh.destroy();
+	overlay.mesh = ImageMesh::createQuadMesh(from, to);
+	for (auto& uv : overlay.mesh.texture) {
+		uv *= fb.uvMax();
+	}
+	overlay.mesh.upload();
+	overlay.mesh.textureId = fb.tid;
+	overlay.mesh.textureReady = true;
+	overlay.scale = scale;
+	overlay.valid = true;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, fb.fbo);
+	glViewport(0, 0, fb.width, fb.height);
+	glClearColor(0.f, 0.f, 0.f, 0.f);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	const auto proj = glm::ortho(from.x, to.x, from.y, to.y);
+	const auto view = glm::mat4(1.f);
+	shaders.lines.enable();
+	shaders.lines.render(proj, view, 1.f / scale, lineSmooth, lineMesh);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
 static glm::vec2 dirOrDefault(const glm::vec2& p1, const glm::vec2& p2, const glm::vec2& defVal) {
@@ -356,8 +1185,9 @@ void Segment::moveP2(const glm::vec2& pos) {
 }
 
 
-Line::Line(float radius, size_t meshOffset) :
+Line::Line(float radius, const glm::vec3& color, size_t meshOffset) :
 	radius(radius),
+	color(color),
 	meshOffset(meshOffset) { }
 void Line::addPoint(const glm::vec2& pos) {
 	if (points.size() > 1) {
@@ -2,20 +2,118 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <list>
+#include "model/annotations.h"
 #include "model/camera.h"
 #include "model/mesh.h"
+#include "util/blockdiff.h"
+#include "util/intervaltree.h"
+#include "util/polyline.h"
+#include "util/spatialgrid.h"
+#include "video/frame.h"
 
 struct ShaderContext; //forward
 
+/*
+    Color-only render target. The texture is allocated with spare capacity,
+    so resizing within it only changes the used part [0, width] x [0, height]
+*/
 struct FrameBuffer {
     GLuint fbo = 0; //frame buffer id
-    GLuint rbo = 0; //render buffer id
     GLuint tid = 0; //render texture id
+    GLenum format = GL_RGB;
     int width  = 0;
     int height = 0;
+    int capacityWidth = 0;
+    int capacityHeight = 0;
     void create(float w, float h);
     void reshape(float w, float h);
     void destroy();
+    glm::vec2 uvMax() const;
+
+private:
+    void allocate(int w, int h);
+};
+
+/*
+    Frame split into tiles of at most maximum texture size,
+    so frames larger than one texture can hold are still shown.
+    Every tile has its own quad in image space
+*/
+struct TileGrid {
+    struct Tile {
+        int x = 0;          // pixel rect in the frame, rows go top-down
+        int y = 0;
+        int width = 0;
+        int height = 0;
+        ImageMesh mesh;
+    };
+
+    int width = 0;
+    int height = 0;
+    std::vector<Tile> tiles;
+
+    void create(int w, int h, int tileSize);
+    void destroy();
+};
+
+/*
+    Keeps the last uploaded video frames resident on the GPU.
+    Every slot holds textures of the frame tiles and is tagged with the pts of the frame,
+    so stepping back and forth only switches the displayed slot.
+    Tile textures are created and filled on demand, only the visible tiles
+    and only the part of them converted from the source frame.
+    Slot count is limited by 'budgetBytes'
+*/
+struct TextureRing {
+    static constexpr size_t budgetBytes = 256 * 1024 * 1024;
+    static constexpr size_t maxSlots = 32;
+
+    struct Slot {
+        std::vector<GLuint> ids;        // per tile, 0 until the tile is uploaded first time
+        std::vector<FrameRegion> loaded;    // frame pixels of 'pts' each tile holds
+        int64_t pts = -1;
+        bool proxy = false;             // holds a proxy frame, stands in only for other proxy frames
+        uint64_t lastUse = 0;
+    };
+
+    std::vector<Slot> slots;
+    size_t capacity = 0;
+    size_t active = 0;
+    uint64_t useCounter = 0;
+    int width = 0;
+    int height = 0;
+    size_t tileCount = 0;
+    GLuint copyFbo[2] = { 0, 0 };   // read and draw framebuffers of slot to slot copy
+
+    void create(int w, int h, size_t tiles);
+    void destroy();
+    void invalidate();
+    bool select(int64_t pts, bool proxy);
+    size_t find(int64_t pts) const;
+    Slot& acquire(int64_t pts);
+    const Slot* activeSlot() const;
+    void copy(GLuint from, GLuint to, int w, int h);
+};
+
+struct UploadStats {
+    uint64_t frames = 0;
+    uint64_t deltaFrames = 0;   // frames uploaded as changed blocks only
+    uint64_t frameBytes = 0;    // uploaded for the last frame
+    uint64_t totalBytes = 0;
+    float dirtyFraction = 1.f;  // of the last frame
+};
+
+/*
+    Finished strokes baked into a texture in image space.
+    Texture is rebaked when strokes change or camera scale changes enough,
+    so finished strokes cost one textured quad per frame
+*/
+struct Overlay {
+    static constexpr int maxSize = 4096;
+    FrameBuffer fb;
+    ImageMesh mesh;
+    float scale = 0.f;  // texels per scene unit
+    bool valid = false;
 };
 
 struct Cursor {
@@ -36,11 +134,16 @@ struct Segment {
 
 struct Line {
     float radius;
+    glm::vec3 color;
     std::vector<glm::vec2> points;
     std::vector<Segment> segments;
-    size_t meshOffset;
+    size_t meshOffset;  // first instance in LineMesh
+    uint64_t id = 0;    // drawing order
+    int64_t ptsFrom = INT64_MIN;    // visible on frames [ptsFrom, ptsTo)
+    int64_t ptsTo = INT64_MAX;
+    size_t record = 0;  // offset of points in sidecar until decoded
 
-    Line(float radius, size_t meshOffset);
+    Line(float radius, const glm::vec3& color, size_t meshOffset);
     void addPoint(const glm::vec2& pos);
     void moveLast(const glm::vec2& pos);
 };
@@ -51,27 +154,85 @@ enum struct DrawType {
     Segments    = 2
 };
 
+struct FrameRender; //forward
+
+/*
+    Frame of another pane shown through this one, tiles of both frames
+    are sampled in one pass by the compare shader.
+    Frames must have the same size, their tile grids then match one to one
+*/
+struct Comparison {
+    enum Mode {
+        Wipe        = 0,
+        Difference  = 1,
+        First       = 2,    // blink shows the frames in turns
+        Second      = 3
+    };
+    const FrameRender* other = nullptr;     // nullptr - comparison is off
+    Mode mode = Mode::Wipe;
+    float split = 0.5f;     // wipe line in fractions of the frame width or height
+    bool vertical = true;   // wipe line is vertical, the first frame is on the left
+    float gain = 4.f;       // difference amplification
+
+    bool operator==(const Comparison&) const = default;
+};
+
 struct FrameRender {
     FrameBuffer fb;
     Camera cam;
     Cursor cursor;
-    ImageMesh imageMesh;
+    TileGrid tiles;
+    TextureRing textures;
+    UploadStats uploadStats;
+    bool textureReady = false;
     
     DrawType drawType = DrawType::None;
     float lineWidth = 5.f;
     float lineColor[3] = {1.f, 0.f, 0.f};
+    bool lineSmooth = true;
+    int lineFrames = 0;     // frames new stroke stays visible, 0 - whole video
+    int64_t framePts = 0;   // shown frame
+    int64_t frameDur = 0;
+    uint64_t lineCounter = 0;   // ids of strokes without sidecar
+    uint64_t sessionLines = UINT64_MAX;     // first id drawn since the sidecar opened, older strokes can't be undone
     std::list<Line> lines;
-    LineMesh lineMesh;   
+    std::shared_ptr<AnnotationFile> annotations;
+    IntervalTree<Line*> lineTimes;              // pts intervals of finished strokes
+    std::vector<Line*> visibleLines;            // sorted by id, their instances are in lineMesh
+    SpatialGrid<const Line*> lineIndex;         // segments of finished strokes
+    PolylineSimplifier simplifier;              // drops points of active stroke
+    static constexpr float simplifyTolerance = 1.f; // max deviation in screen pixels
+    std::vector<const Line*> selectedLines;
+    const Line* hoveredLine = nullptr;
+    LineMesh lineMesh;      // finished strokes
+    LineMesh strokeMesh;    // stroke under the mouse
+    LineMesh highlightMesh; // selected and hovered strokes
+    Overlay overlay;
+    Comparison compare;
+    MotionMesh motionMesh;  // vectors of the shown frame
+    bool showMotion = false;
+    bool dirty = true;  // fb content is out of date and must be rendered again
 
-    void createTexture(int16_t width, int16_t height);
-    void updateTexture(int16_t width, int16_t height, const uint8_t* pixels);
+    void createTexture(int width, int height);
+    bool showTexture(int64_t pts, bool proxy);
+    void updateTexture(const RGBFrame& frame);
+    void updateMotion(const RGBFrame& frame);
+    bool missingTiles() const;
+    FrameRegion getRegionOfInterest() const;
     void clearTexture();
     void destroyTexture();
+    void destroyMeshes();
     void reshape(int width, int height);
     void moveCam(int dx, int dy);
     void zoomCam(float value);
-    void render(ShaderContext& shader) const;
+    void rotateCam(float degrees);
+    void render(ShaderContext& shader);
+    void renderDirect(ShaderContext& shader, const int viewport[4], const int scissor[4]);
     void setBrush(const float color[3], float width);
+    void setSmooth(bool smooth);
+    void setLineFrames(int frames);
+    void setShowMotion(bool show);
+    void showLines(int64_t pts, int64_t dur);
     void moveCursor(int x, int y);
     void showCursor(bool visible);
     void drawStart(int x, int y, DrawType type);
@@ -80,10 +241,40 @@ struct FrameRender {
     void drawReset();
     void undoDrawing();
     void clearDrawing();
+    void openLines(const std::string& mediaPath);
+    void closeLines();
+    void hoverLine(int x, int y);
+    void resetHover();
+    void selectLine(int x, int y, bool add);
+    void eraseLines(int x, int y);
+    void eraseSelected();
 
 private:
     glm::vec2 toOpenGLSpace(int x, int y) const;
     glm::vec2 toSceneSpace(int x, int y) const;
     void updateCursor();
+    void getVisibleRect(glm::vec2& from, glm::vec2& to) const;
+    FrameRegion getVisibleRegion(float margin) const;
+    bool isVisible(const TileGrid::Tile& tile, const glm::vec2& from, const glm::vec2& to) const;
+    void uploadTiles(TextureRing::Slot& slot, const RGBFrame& frame);
+    void uploadBlocks(TextureRing::Slot& slot, const RGBFrame& frame);
+    void uploadRect(TextureRing::Slot& slot, size_t tileIndex, const FrameRegion& rect, const RGBFrame& frame);
+    void copyTiles(const TextureRing::Slot& from, TextureRing::Slot& to);
+    bool isComplete(const TextureRing::Slot& slot) const;
+    const TextureRing::Slot* getCompareSlot() const;
+    void draw(ShaderContext& shaders);
     float getLineRadius() const;
+    glm::vec3 getLineColor() const;
+    float getSimplifyTolerance() const;
+    void finishStroke();
+    bool isVisible(const Line* line) const;
+    void decodeLine(Line& line);
+    void updateLineMesh();
+    const Line* findLine(const glm::vec2& pos, float radius) const;
+    void indexLine(const Line& line);
+    void eraseLine(const Line* line);
+    void updateHighlight();
+    float getOverlayScale(const glm::vec2& extent) const;
+    bool overlayOutdated() const;
+    void bakeOverlay(ShaderContext& shaders);
 };
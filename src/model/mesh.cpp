@@ -1,14 +1,93 @@
+#include <algorithm>
 #include "mesh.h"
+#include "shader/glstate.h"
+#include "shader/layout.h"
 
 using std::vector;
 using glm::vec2;
 
-ImageMesh ImageMesh::createImageMesh(int w, int h) {
+static size_t growCapacity(size_t capacity, size_t required) {
+    size_t result = std::max<size_t>(capacity, 256);
+    while (result < required) {
+        result *= 2;
+    }
+    return result;
+}
+
+void GLMesh::create() {
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ibo);
+
+    // Element buffer binding is a part of vao state
+    gl::state().bindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+void GLMesh::destroy() {
+    if (vao) {
+        gl::state().forgetVertexArray(vao);
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &vbo);
+        glDeleteBuffers(1, &ibo);
+    }
+    if (shape) {
+        glDeleteBuffers(1, &shape);
+    }
+    vao = 0;
+    vbo = 0;
+    ibo = 0;
+    shape = 0;
+    vertexBytes = 0;
+    indexBytes = 0;
+}
+bool GLMesh::reserveVertex(size_t bytes) {
+    if (bytes <= vertexBytes) {
+        return false;
+    }
+
+    vertexBytes = growCapacity(vertexBytes, bytes);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+}
+bool GLMesh::reserveIndex(size_t bytes) {
+    if (bytes <= indexBytes) {
+        return false;
+    }
+
+    indexBytes = growCapacity(indexBytes, bytes);
+    gl::state().bindVertexArray(vao);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, nullptr, GL_DYNAMIC_DRAW);
+    return true;
+}
+void GLMesh::updateVertex(size_t offset, size_t size, const void* data) const {
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+void GLMesh::updateIndex(size_t offset, size_t size, const void* data) const {
+    gl::state().bindVertexArray(vao);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset, size, data);
+}
+void GLMesh::createShape(size_t size, const void* data) {
+    // Left bound to GL_ARRAY_BUFFER for the per-vertex attribute pointers
+    if (!shape) {
+        glGenBuffers(1, &shape);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, shape);
+    glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+}
+
+ImageMesh ImageMesh::createImageMesh(const vec2& from, const vec2& to) {
+    // Image rows go top-down, so the first row is at 'to.y'
     auto position = vector<vec2> {
-        { 0, 0 },
-        { w, 0 },
-        { w, h },
-        { 0, h }
+        { from.x, from.y },
+        { to.x, from.y },
+        { to.x, to.y },
+        { from.x, to.y }
     };
     auto texture = vector<vec2> {
         { 0, 1 },
@@ -27,39 +106,212 @@ ImageMesh ImageMesh::createImageMesh(int w, int h) {
         std::move(face)
     };
 }
+ImageMesh ImageMesh::createQuadMesh(const vec2& from, const vec2& to) {
+    auto position = vector<vec2> {
+        { from.x, from.y },
+        { to.x, from.y },
+        { to.x, to.y },
+        { from.x, to.y }
+    };
+    auto texture = vector<vec2> {
+        { 0, 0 },
+        { 1, 0 },
+        { 1, 1 },
+        { 0, 1 }
+    };
+    auto face = vector<GLFace>{
+       { 0, 1, 2 },
+       { 2, 3, 0 }
+    };
+    return ImageMesh{
+        0, false,
+        std::move(position),
+        std::move(texture),
+        std::move(face)
+    };
+}
+void ImageMesh::upload() {
+    if (!gpu.vao) {
+        gpu.create();
+    }
+
+    // vbo = [position..., texture...]
+    const size_t positionBytes = position.size() * sizeof(vec2);
+    const size_t textureBytes = texture.size() * sizeof(vec2);
+    const size_t faceBytes = face.size() * sizeof(GLFace);
+    gpu.reserveVertex(positionBytes + textureBytes);
+    gpu.reserveIndex(faceBytes);
+    gpu.updateVertex(0, positionBytes, position.data());
+    gpu.updateVertex(positionBytes, textureBytes, texture.data());
+    gpu.updateIndex(0, faceBytes, face.data());
 
-void LineMesh::reserveQuad() {
-    const uint16_t i = vertex.size();
-    vertex.resize(vertex.size() + 4);
-    face.emplace_back(i + 0, i + 1, i + 2);
-    face.emplace_back(i + 2, i + 1, i + 3);
+    constexpr GLuint position = VideoLayout::Position.location;
+    constexpr GLuint texture = VideoLayout::Texture.location;
+    gl::state().bindVertexArray(gpu.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, gpu.vbo);
+    glEnableVertexAttribArray(position);
+    glEnableVertexAttribArray(texture);
+    glVertexAttribPointer(position, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+    glVertexAttribPointer(texture, 2, GL_FLOAT, GL_FALSE, 0, reinterpret_cast<const void*>(positionBytes));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+void ImageMesh::destroy() {
+    gpu.destroy();
+}
+
+void LineMesh::reserve(size_t count) {
+    if (instance.size() < count) {
+        auto from = instance.size();
+        instance.resize(count);
+        markDirty(from, count - from);
+    }
 }
 bool LineMesh::empty() const {
-    return vertex.empty() || face.empty();
+    return instance.empty();
 }
 void LineMesh::clear() {
-    vertex.clear();
-    face.clear();
+    instance.clear();
+    dirtyFrom = 0;
+    dirtyTo = 0;
 }
-void LineMesh::createPoint(size_t vertexOffset, const glm::vec2& pos, float radius) {
+void LineMesh::createPoint(const glm::vec2& pos, float radius, const glm::vec3& color) {
+    reserve(1);
+    instance[0] = LineInstance{ pos, pos, pos, pos, radius, color };
+    markDirty(0, 1);
+}
+size_t LineMesh::offset() const {
+    return instance.size();
+}
+void LineMesh::trim(size_t size) {
+    instance.resize(std::min(size, instance.size()));
+    dirtyTo = std::min(dirtyTo, instance.size());
+    dirtyFrom = std::min(dirtyFrom, dirtyTo);
+}
+void LineMesh::erase(size_t from, size_t count) {
+    instance.erase(instance.begin() + from, instance.begin() + from + count);
+    dirtyTo = std::min(dirtyTo, instance.size());
+    dirtyFrom = std::min(dirtyFrom, dirtyTo);
+    markDirty(from, instance.size() - from);
+}
+void LineMesh::markDirty(size_t from, size_t count) {
+    if (dirtyFrom == dirtyTo) {
+        dirtyFrom = from;
+        dirtyTo = from + count;
+        return;
+    }
+    dirtyFrom = std::min(dirtyFrom, from);
+    dirtyTo = std::max(dirtyTo, from + count);
+}
+void LineMesh::upload() {
+    if (!gpu.vao) {
+        gpu.create();
+
+        // Unit quad drawn as triangle strip, shared by all instances
+        static const vec2 corners[4] = { { -1, -1 }, { -1, 1 }, { 1, -1 }, { 1, 1 } };
+        gpu.createShape(sizeof(corners), corners);
 
-    while (vertex.size() < vertexOffset + 4) {
-        reserveQuad();
+        using L = LinesLayout;
+        gl::state().bindVertexArray(gpu.vao);
+        for (const auto& attribute : L::attributes) {
+            glEnableVertexAttribArray(attribute.location);
+        }
+        glVertexAttribPointer(L::Corner.location, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+
+        constexpr GLsizei stride = sizeof(LineInstance);
+        glBindBuffer(GL_ARRAY_BUFFER, gpu.vbo);
+        glVertexAttribPointer(L::LineStart.location, 2, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void*>(offsetof(LineInstance, p0)));
+        glVertexAttribPointer(L::LineEnd.location, 2, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void*>(offsetof(LineInstance, p1)));
+        glVertexAttribPointer(L::LinePrev.location, 2, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void*>(offsetof(LineInstance, prev)));
+        glVertexAttribPointer(L::LineNext.location, 2, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void*>(offsetof(LineInstance, next)));
+        glVertexAttribPointer(L::Radius.location, 1, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void*>(offsetof(LineInstance, radius)));
+        glVertexAttribPointer(L::Color.location, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void*>(offsetof(LineInstance, color)));
+        for (const auto& attribute : L::attributes) {
+            if (attribute.location != L::Corner.location) {
+                glVertexAttribDivisor(attribute.location, 1);
+            }
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // Reallocated buffer loses its content and needs the full upload
+    if (gpu.reserveVertex(instance.size() * sizeof(LineInstance))) {
+        dirtyFrom = 0;
+        dirtyTo = instance.size();
+    }
+
+    if (dirtyFrom < dirtyTo) {
+        constexpr size_t size = sizeof(LineInstance);
+        gpu.updateVertex(dirtyFrom * size, (dirtyTo - dirtyFrom) * size, instance.data() + dirtyFrom);
     }
 
-    const auto dx = glm::vec2(radius, 0);
-    const auto dy = glm::vec2(0, radius);
-    vertex[0] = LineVertex{ pos - dx - dy, pos, pos, radius };
-    vertex[1] = LineVertex{ pos - dx + dy, pos, pos, radius };
-    vertex[2] = LineVertex{ pos + dx - dy, pos, pos, radius };
-    vertex[3] = LineVertex{ pos + dx + dy, pos, pos, radius };
+    dirtyFrom = 0;
+    dirtyTo = 0;
 }
-size_t LineMesh::offset() const {
-    return vertex.size();
+void LineMesh::destroy() {
+    gpu.destroy();
+    dirtyFrom = 0;
+    dirtyTo = instance.size();
+}
+
+bool MotionMesh::empty() const {
+    return count == 0;
 }
-void LineMesh::trim(size_t vertexSize) {
-    size_t trimSize = std::min(vertexSize, vertex.size());
-    vertex.resize(trimSize);
-    face.resize(trimSize / size_t(2));
+void MotionMesh::clear() {
+    count = 0;
+    pts = -1;
+    data = nullptr;
 }
+void MotionMesh::upload(const MotionVectors& vectors, int64_t framePts) {
+    // Frame decoded again, e.g. after the export is enabled, has other vectors under the same pts
+    if (framePts == pts && vectors.data.get() == data) {
+        return;
+    }
+    pts = framePts;
+    data = vectors.data.get();
+    count = vectors.empty() ? 0 : vectors.count;
+    if (count == 0) {
+        return;
+    }
+
+    if (!gpu.vao) {
+        gpu.create();
+
+        // Arrow along x from the source (0) to the target (1), drawn as triangles.
+        // Across and back offsets are in screen pixels: shaft and head base
+        static const glm::vec3 arrow[9] = {
+            { 0, -0.75f, 0 }, { 1, -0.75f, 5 }, { 0, 0.75f, 0 },
+            { 0, 0.75f, 0 }, { 1, -0.75f, 5 }, { 1, 0.75f, 5 },
+            { 1, 0, 0 }, { 1, -3, 6 }, { 1, 3, 6 }
+        };
+        gpu.createShape(sizeof(arrow), arrow);
+
+        using M = MotionLayout;
+        gl::state().bindVertexArray(gpu.vao);
+        for (const auto& attribute : M::attributes) {
+            glEnableVertexAttribArray(attribute.location);
+        }
+        glVertexAttribPointer(M::Corner.location, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
 
+        const auto& layout = MotionVectors::layout;
+        const GLsizei stride = static_cast<GLsizei>(layout.stride);
+        glBindBuffer(GL_ARRAY_BUFFER, gpu.vbo);
+        glVertexAttribPointer(M::Source.location, 1, GL_INT, GL_FALSE, stride, reinterpret_cast<const void*>(layout.source));
+        glVertexAttribPointer(M::Target.location, 2, GL_SHORT, GL_FALSE, stride, reinterpret_cast<const void*>(layout.target));
+        glVertexAttribPointer(M::Motion.location, 2, GL_INT, GL_FALSE, stride, reinterpret_cast<const void*>(layout.motion));
+        glVertexAttribPointer(M::MotionScale.location, 1, GL_UNSIGNED_SHORT, GL_FALSE, stride, reinterpret_cast<const void*>(layout.motionScale));
+        for (const auto& attribute : M::attributes) {
+            if (attribute.location != M::Corner.location) {
+                glVertexAttribDivisor(attribute.location, 1);
+            }
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    const size_t bytes = count * MotionVectors::layout.stride;
+    gpu.reserveVertex(bytes);
+    gpu.updateVertex(0, bytes, vectors.data.get());
+}
+void MotionMesh::destroy() {
+    gpu.destroy();
+    clear();
+}
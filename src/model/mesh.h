@@ -3,6 +3,7 @@
 #include <glm/glm.hpp>
 #include <cstdint>
 #include <vector>
+#include "video/frame.h"
 
 struct GLFace {
     uint16_t a = 0;
@@ -10,30 +11,90 @@ struct GLFace {
     uint16_t c = 0;
 };
 
+/*
+    Vertex array object with its vertex and index buffers.
+    Buffers grow by doubling, so appending geometry rarely reallocates them.
+    Attribute locations are bound by Shader::create in declaration order,
+    so every mesh sets up its layout once with fixed locations.
+    Instanced meshes keep instances in vbo and the shape of one instance in 'shape'
+*/
+struct GLMesh {
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLuint ibo = 0;
+    GLuint shape = 0;       // per-vertex attributes shared by instances, static
+    size_t vertexBytes = 0; // vbo capacity
+    size_t indexBytes = 0;  // ibo capacity
+
+    void create();
+    void destroy();
+    bool reserveVertex(size_t bytes);
+    bool reserveIndex(size_t bytes);
+    void updateVertex(size_t offset, size_t size, const void* data) const;
+    void updateIndex(size_t offset, size_t size, const void* data) const;
+    void createShape(size_t size, const void* data);
+};
+
 struct ImageMesh {
     GLuint textureId = 0;
     bool textureReady = false;
     std::vector<glm::vec2> position;
     std::vector<glm::vec2> texture;
     std::vector<GLFace> face;
-    static ImageMesh createImageMesh(int w, int h);
+    GLMesh gpu;
+    static ImageMesh createImageMesh(const glm::vec2& from, const glm::vec2& to);
+    static ImageMesh createQuadMesh(const glm::vec2& from, const glm::vec2& to);
+    void upload();
+    void destroy();
 };
 
-struct LineVertex {
-    glm::vec2 position;
-    glm::vec2 segmentP0;
-    glm::vec2 segmentP1;
+/*
+    One instance per stroke segment.
+    Vertex shader expands a unit quad around the segment,
+    fragment shader computes outline and fill in one pass.
+    'prev' is the start of previous segment of the same stroke,
+    it keeps the outline from covering the fill at the joint
+*/
+struct LineInstance {
+    glm::vec2 p0;
+    glm::vec2 p1;
+    glm::vec2 prev;     // point before p0 and after p1, used for joints and smoothing
+    glm::vec2 next;
     float radius = 0.f;
+    glm::vec3 color;
 };
 
 struct LineMesh {
-    std::vector<LineVertex> vertex;
-    std::vector<GLFace> face;
-    glm::vec3 color;
-    void reserveQuad();
+    std::vector<LineInstance> instance;
+    GLMesh gpu;                 // vbo contains instances, shape contains quad corners
+    size_t dirtyFrom = 0;       // instance range changed since last upload
+    size_t dirtyTo = 0;
+
+    void reserve(size_t count);
     bool empty() const;
     void clear();
-    void createPoint(size_t vertexOffset, const glm::vec2& pos, float radius);
+    void createPoint(const glm::vec2& pos, float radius, const glm::vec3& color);
     size_t offset() const;
-    void trim(size_t vertexSize);
+    void trim(size_t size);
+    void erase(size_t from, size_t count);
+    void markDirty(size_t from, size_t count);
+    void upload();
+    void destroy();
+};
+
+/*
+    Arrows of decoder motion vectors, one instance per vector.
+    Instance buffer takes the AVMotionVector array of the frame as is,
+    attributes read its fields, so no vector is touched on CPU
+*/
+struct MotionMesh {
+    size_t count = 0;
+    int64_t pts = -1;           // frame of the uploaded vectors
+    const uint8_t* data = nullptr;
+    GLMesh gpu;                 // vbo contains vectors, shape contains arrow vertices
+
+    bool empty() const;
+    void clear();
+    void upload(const MotionVectors& vectors, int64_t framePts);
+    void destroy();
 };
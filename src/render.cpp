@@ -4,31 +4,46 @@
 
 void Render::createShaders() {
 	shaders.video.create(resources::videoShader);
+	shaders.compare.create(resources::compareShader);
 	shaders.lines.create(resources::linesShader);
-	shaders.point.create(resources::pointShader);
+	shaders.motion.create(resources::motionShader);
 }
 void Render::reloadShaders() {
 	destroyShaders();
 	createShaders();
+	frames[0].dirty = true;
+	frames[1].dirty = true;
 }
 void Render::destroyShaders() {
 	shaders.video.destroy();
+	shaders.compare.destroy();
 	shaders.lines.destroy();
-	shaders.point.destroy();
+	shaders.motion.destroy();
 }
 void Render::destroyFrames() {
 	frames[0].destroyTexture();
 	frames[1].destroyTexture();
+	frames[0].destroyMeshes();
+	frames[1].destroyMeshes();
 }
 void Render::createFrameBuffers() {
 	frames[0].fb.create(1, 1);
 	frames[1].fb.create(1, 1);
+	frames[0].dirty = true;
+	frames[1].dirty = true;
 }
 void Render::destroyFrameBuffers() {
 	frames[0].fb.destroy();
 	frames[1].fb.destroy();
 }
 void Render::renderFrames() {
-	frames[0].render(shaders);
-	frames[1].render(shaders);
+	if (direct) {
+		return;
+	}
+	for (auto& frame : frames) {
+		if (frame.dirty) {
+			frame.dirty = false;
+			frame.render(shaders);
+		}
+	}
 }
@@ -5,6 +5,7 @@
 struct Render {
 	ShaderContext shaders;
 	FrameRender frames[2];
+	bool direct = true;	// frames are drawn by ImGui callbacks, framebuffers stay unused
 	void createShaders();
 	void reloadShaders();
 	void destroyShaders();
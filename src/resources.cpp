@@ -8,11 +8,14 @@
 
 namespace resources {
 	const char* programName = "Frames Player by Levin K. (v1.0.2)";
+	const char* compareShader = _FRAMES_DATA_PATH("./data/shaders/compare.glsl");
 	const char* linesShader = _FRAMES_DATA_PATH("./data/shaders/lines.glsl");
-	const char* pointShader = _FRAMES_DATA_PATH("./data/shaders/point.glsl");
+	const char* motionShader = _FRAMES_DATA_PATH("./data/shaders/motion.glsl");
 	const char* videoShader = _FRAMES_DATA_PATH("./data/shaders/video.glsl");
 	const char* font		= _FRAMES_DATA_PATH("./data/fonts/calibri.ttf");
 	const char* workspace = "./workspace.ini";
+	const char* shaderCache = "./shadercache";
+	const char* proxyCache = "./proxycache";
 }
 
 #undef _FRAMES_DATA_PATH
\ No newline at end of file
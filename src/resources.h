@@ -2,9 +2,12 @@
 
 namespace resources {
 	extern const char* programName;
+	extern const char* compareShader;
 	extern const char* linesShader;
-	extern const char* pointShader;
+	extern const char* motionShader;
 	extern const char* videoShader;
 	extern const char* font;	
 	extern const char* workspace;
+	extern const char* shaderCache;
+	extern const char* proxyCache;
 }
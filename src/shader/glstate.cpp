@@ -0,0 +1,73 @@
+#include "glstate.h"
+
+gl::State& gl::state() {
+    static State instance;
+    return instance;
+}
+
+void gl::State::invalidate() {
+    program = unknown;
+    textures[0] = unknown;
+    textures[1] = unknown;
+    vertexArray = unknown;
+    blend = -1;
+    blendSrc = GL_NONE;
+    blendDst = GL_NONE;
+}
+void gl::State::useProgram(GLuint id) {
+    if (program != id) {
+        program = id;
+        glUseProgram(id);
+    }
+}
+void gl::State::bindTexture(GLuint id, int unit) {
+    if (textures[unit] != id) {
+        textures[unit] = id;
+        if (unit != 0) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+        }
+        glBindTexture(GL_TEXTURE_2D, id);
+        if (unit != 0) {
+            glActiveTexture(GL_TEXTURE0);
+        }
+    }
+}
+void gl::State::bindVertexArray(GLuint id) {
+    if (vertexArray != id) {
+        vertexArray = id;
+        glBindVertexArray(id);
+    }
+}
+void gl::State::setBlend(bool enabled) {
+    int value = enabled ? 1 : 0;
+    if (blend != value) {
+        blend = value;
+        enabled ? glEnable(GL_BLEND) : glDisable(GL_BLEND);
+    }
+}
+void gl::State::blendFunc(GLenum src, GLenum dst) {
+    if (blendSrc != src || blendDst != dst) {
+        blendSrc = src;
+        blendDst = dst;
+        glBlendFunc(src, dst);
+    }
+}
+void gl::State::forgetProgram(GLuint id) {
+    if (program == id) {
+        program = unknown;
+    }
+}
+void gl::State::forgetTextures(const GLuint* ids, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        for (GLuint& bound : textures) {
+            if (bound == ids[i]) {
+                bound = unknown;
+            }
+        }
+    }
+}
+void gl::State::forgetVertexArray(GLuint id) {
+    if (vertexArray == id) {
+        vertexArray = unknown;
+    }
+}
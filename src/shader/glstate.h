@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <glad/glad.h>
+
+namespace gl {
+
+    /*
+        Shadow copy of the GL state changed while rendering frames.
+        Setters skip driver calls which wouldn't change anything.
+        Texture bindings are tracked for units 0 and 1, unit 0 stays the active one
+        so code binding textures without the cache doesn't need to know about unit 1.
+        Must be invalidated after foreign code (ImGui backend) has touched GL.
+        Deleted objects must be forgotten, GL may reuse their ids for new ones
+    */
+    class State {
+    public:
+        void invalidate();
+        void useProgram(GLuint id);
+        void bindTexture(GLuint id, int unit = 0);
+        void bindVertexArray(GLuint id);
+        void setBlend(bool enabled);
+        void blendFunc(GLenum src, GLenum dst);
+        void forgetProgram(GLuint id);
+        void forgetTextures(const GLuint* ids, size_t count);
+        void forgetTexture(GLuint id) { forgetTextures(&id, 1); }
+        void forgetVertexArray(GLuint id);
+
+    private:
+        static constexpr GLuint unknown = ~0u;
+        static constexpr int units = 2;
+        GLuint program = unknown;
+        GLuint textures[units] = { unknown, unknown };
+        GLuint vertexArray = unknown;
+        int blend = -1;             // -1 unknown, 0 disabled, 1 enabled
+        GLenum blendSrc = GL_NONE;
+        GLenum blendDst = GL_NONE;
+    };
+
+    State& state();
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <type_traits>
+#include <glm/glm.hpp>
+
+/*
+    Compile-time interfaces of the shaders.
+    Uniform slot is typed and bound to its layout, so setting a value of wrong type
+    or a uniform of another shader doesn't compile. Attribute locations are shared
+    by program linking and vertex arrays of the meshes
+*/
+template<typename Layout, typename T>
+struct UniformSlot {
+    using Owner = Layout;
+    using Type = T;
+    uint8_t index;      // slot in the location table of the program
+    const char* name;
+};
+
+struct AttributeSlot {
+    uint32_t location;
+    const char* name;
+};
+
+constexpr bool sameName(const char* left, const char* right) {
+    while (*left && *left == *right) {
+        left++;
+        right++;
+    }
+    return *left == *right;
+}
+
+// Name of the slot is at its index in the uniforms of its layout
+template<const auto& Slot>
+constexpr bool validUniform() {
+    using Layout = typename std::remove_cvref_t<decltype(Slot)>::Owner;
+    return Slot.index < Layout::uniforms.size() && sameName(Layout::uniforms[Slot.index], Slot.name);
+}
+
+template<typename Layout>
+constexpr bool validAttributes() {
+    for (uint32_t i = 0; i < Layout::attributes.size(); i++) {
+        if (Layout::attributes[i].location != i) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct VideoLayout {
+    static constexpr UniformSlot<VideoLayout, int> VideoTexture = { 0, "VideoTexture" };
+    static constexpr UniformSlot<VideoLayout, glm::mat4> Proj   = { 1, "Proj" };
+    static constexpr UniformSlot<VideoLayout, glm::mat4> View   = { 2, "View" };
+    static constexpr std::array uniforms = { VideoTexture.name, Proj.name, View.name };
+
+    static constexpr AttributeSlot Position = { 0, "in_Position" };
+    static constexpr AttributeSlot Texture  = { 1, "in_Texture" };
+    static constexpr std::array attributes = { Position, Texture };
+};
+static_assert(validUniform<VideoLayout::VideoTexture>());
+static_assert(validUniform<VideoLayout::Proj>());
+static_assert(validUniform<VideoLayout::View>());
+
+struct CompareLayout {
+    static constexpr UniformSlot<CompareLayout, int> TextureA       = { 0, "TextureA" };
+    static constexpr UniformSlot<CompareLayout, int> TextureB       = { 1, "TextureB" };
+    static constexpr UniformSlot<CompareLayout, glm::mat4> Proj     = { 2, "Proj" };
+    static constexpr UniformSlot<CompareLayout, glm::mat4> View     = { 3, "View" };
+    static constexpr UniformSlot<CompareLayout, float> Mode         = { 4, "Mode" };
+    static constexpr UniformSlot<CompareLayout, float> Split        = { 5, "Split" };
+    static constexpr UniformSlot<CompareLayout, float> Vertical     = { 6, "Vertical" };
+    static constexpr UniformSlot<CompareLayout, float> Gain         = { 7, "Gain" };
+    static constexpr UniformSlot<CompareLayout, float> Scale        = { 8, "Scale" };
+    static constexpr std::array uniforms = {
+        TextureA.name, TextureB.name, Proj.name, View.name,
+        Mode.name, Split.name, Vertical.name, Gain.name, Scale.name };
+
+    static constexpr AttributeSlot Position = { 0, "in_Position" };
+    static constexpr AttributeSlot Texture  = { 1, "in_Texture" };
+    static constexpr std::array attributes = { Position, Texture };
+};
+static_assert(validUniform<CompareLayout::TextureA>());
+static_assert(validUniform<CompareLayout::TextureB>());
+static_assert(validUniform<CompareLayout::Proj>());
+static_assert(validUniform<CompareLayout::View>());
+static_assert(validUniform<CompareLayout::Mode>());
+static_assert(validUniform<CompareLayout::Split>());
+static_assert(validUniform<CompareLayout::Vertical>());
+static_assert(validUniform<CompareLayout::Gain>());
+static_assert(validUniform<CompareLayout::Scale>());
+
+struct LinesLayout {
+    static constexpr UniformSlot<LinesLayout, glm::mat4> Proj = { 0, "Proj" };
+    static constexpr UniformSlot<LinesLayout, glm::mat4> View = { 1, "View" };
+    static constexpr UniformSlot<LinesLayout, float> Scale    = { 2, "Scale" };
+    static constexpr UniformSlot<LinesLayout, float> Smooth   = { 3, "Smooth" };
+    static constexpr std::array uniforms = { Proj.name, View.name, Scale.name, Smooth.name };
+
+    static constexpr AttributeSlot Corner    = { 0, "in_Corner" };     // per vertex
+    static constexpr AttributeSlot LineStart = { 1, "in_LineStart" };  // per instance
+    static constexpr AttributeSlot LineEnd   = { 2, "in_LineEnd" };
+    static constexpr AttributeSlot LinePrev  = { 3, "in_LinePrev" };
+    static constexpr AttributeSlot LineNext  = { 4, "in_LineNext" };
+    static constexpr AttributeSlot Radius    = { 5, "in_Radius" };
+    static constexpr AttributeSlot Color     = { 6, "in_Color" };
+    static constexpr std::array attributes = { Corner, LineStart, LineEnd, LinePrev, LineNext, Radius, Color };
+};
+static_assert(validUniform<LinesLayout::Proj>());
+static_assert(validUniform<LinesLayout::View>());
+static_assert(validUniform<LinesLayout::Scale>());
+static_assert(validUniform<LinesLayout::Smooth>());
+
+struct MotionLayout {
+    static constexpr UniformSlot<MotionLayout, glm::mat4> Proj = { 0, "Proj" };
+    static constexpr UniformSlot<MotionLayout, glm::mat4> View = { 1, "View" };
+    static constexpr UniformSlot<MotionLayout, float> Scale    = { 2, "Scale" };
+    static constexpr UniformSlot<MotionLayout, float> Height   = { 3, "Height" };
+    static constexpr std::array uniforms = { Proj.name, View.name, Scale.name, Height.name };
+
+    static constexpr AttributeSlot Corner      = { 0, "in_Corner" };       // per vertex
+    static constexpr AttributeSlot Source      = { 1, "in_Source" };       // per instance: fields of AVMotionVector
+    static constexpr AttributeSlot Target      = { 2, "in_Target" };
+    static constexpr AttributeSlot Motion      = { 3, "in_Motion" };
+    static constexpr AttributeSlot MotionScale = { 4, "in_MotionScale" };
+    static constexpr std::array attributes = { Corner, Source, Target, Motion, MotionScale };
+};
+static_assert(validUniform<MotionLayout::Proj>());
+static_assert(validUniform<MotionLayout::View>());
+static_assert(validUniform<MotionLayout::Scale>());
+static_assert(validUniform<MotionLayout::Height>());
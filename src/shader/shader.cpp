@@ -1,136 +1,80 @@
 #include "shader.h"
+#include "glstate.h"
 
-VideoShader::VideoShader() : Shader(3, 2) {
-    u[0] = Uniform("VideoTexture");
-    u[1] = Uniform("Proj");
-    u[2] = Uniform("View");
-    a[0] = Attribute(VEC_2, "in_Position");
-    a[1] = Attribute(VEC_2, "in_Texture");
-}
 void VideoShader::enable() const {
     Shader::enable();
-    glEnable(GL_TEXTURE_2D);
-    //glEnable(GL_DEPTH_TEST);
-}
-void VideoShader::disable() const {
-    Shader::disable();
-    glDisable(GL_TEXTURE_2D);
-    //glDisable(GL_DEPTH_TEST);
+    gl::state().setBlend(false);
 }
-void VideoShader::render(const FrameRender& frame) {
-    if (!frame.imageMesh.textureReady) {
+void VideoShader::render(const Camera& cam, const ImageMesh& mesh) {
+    if (!mesh.textureReady) {
         return;
     }
 
-    glBindTexture(GL_TEXTURE_2D, frame.imageMesh.textureId);
-    set1(u[0], 0);
-    set4(u[1], frame.cam.proj);
-    set4(u[2], frame.cam.view);
-    attr(a[0], frame.imageMesh.position);
-    attr(a[1], frame.imageMesh.texture);
-    drawFaces(frame.imageMesh.face);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    gl::state().bindTexture(mesh.textureId);
+    set<VideoLayout::VideoTexture>(0);
+    set<VideoLayout::Proj>(cam.proj);
+    set<VideoLayout::View>(cam.view);
+    gl::state().bindVertexArray(mesh.gpu.vao);
+    drawFaces(mesh.face.size());
 }
 
-LinesShader::LinesShader() : Shader(5, 4) {
-    u[0] = Uniform("Proj");
-    u[1] = Uniform("View");
-    u[2] = Uniform("Color");
-    u[3] = Uniform("Offset");
-    u[4] = Uniform("Scale");
+void CompareShader::enable() const {
+    Shader::enable();
+    gl::state().setBlend(false);
+}
+void CompareShader::render(const Camera& cam, const ImageMesh& mesh, GLuint other, const Comparison& compare, const glm::vec2& frameSize) {
+    if (!mesh.textureReady) {
+        return;
+    }
 
-    a[0] = Attribute(VEC_2, "in_Position");
-    a[1] = Attribute(VEC_2, "in_LineStart");
-    a[2] = Attribute(VEC_2, "in_LineEnd");
-    a[3] = Attribute(VEC_2, "in_Radius");
+    // Wipe line is given from the left or top edge, scene y axis goes up
+    const float split = compare.vertical ? compare.split * frameSize.x : (1.f - compare.split) * frameSize.y;
+    gl::state().bindTexture(mesh.textureId);
+    gl::state().bindTexture(other, 1);
+    set<CompareLayout::TextureA>(0);
+    set<CompareLayout::TextureB>(1);
+    set<CompareLayout::Proj>(cam.proj);
+    set<CompareLayout::View>(cam.view);
+    set<CompareLayout::Mode>(static_cast<float>(compare.mode));
+    set<CompareLayout::Split>(split);
+    set<CompareLayout::Vertical>(compare.vertical ? 1.f : 0.f);
+    set<CompareLayout::Gain>(compare.gain);
+    set<CompareLayout::Scale>(cam.scale_inverse);
+    gl::state().bindVertexArray(mesh.gpu.vao);
+    drawFaces(mesh.face.size());
 }
+
 void LinesShader::enable() const {
     Shader::enable();
-    glDisable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-}
-void LinesShader::disable() const {
-    Shader::disable();
-    glDisable(GL_BLEND);
-    glDisable(GL_DEPTH_TEST);
+    gl::state().setBlend(true);
+    gl::state().blendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA); // shader outputs premultiplied alpha
 }
-void LinesShader::render(const FrameRender& frame) {
-    
-    set4(u[0], frame.cam.proj);
-    set4(u[1], frame.cam.view);
-    set1(u[4], frame.cam.scale_inverse);
-
-    static const auto whiteColor = glm::vec3(1.f, 1.f, 1.f);
-
-    // Lines
-    if (!frame.lineMesh.empty()) {
-        const auto& mesh = frame.lineMesh;
-        const auto& vertex = mesh.vertex.data();
-        attr(a[0], vertex, sizeof(LineVertex), offsetof(LineVertex, position));
-        attr(a[1], vertex, sizeof(LineVertex), offsetof(LineVertex, segmentP0));
-        attr(a[2], vertex, sizeof(LineVertex), offsetof(LineVertex, segmentP1));
-        attr(a[3], vertex, sizeof(LineVertex), offsetof(LineVertex, radius));
-
-        //background
-        set3(u[2], whiteColor);
-        set1(u[3], 0.f);
-        drawFaces(mesh.face);
-
-        //foreground
-        set3(u[2], mesh.color);
-        set1(u[3], -1.5f);
-        drawFaces(mesh.face);
+void LinesShader::render(const glm::mat4& proj, const glm::mat4& view, float scale, bool smooth, const LineMesh& mesh) {
+    if (mesh.empty()) {
+        return;
     }
 
-    // Cursor
-    {
-        const bool no_draw = frame.drawType == DrawType::None;
-        const bool visible = frame.cursor.visible;
-        if (no_draw && visible) {
-            const auto& mesh = frame.cursor.mesh;
-            const auto& vertex = mesh.vertex.data();
-            attr(a[0], vertex, sizeof(LineVertex), offsetof(LineVertex, position));
-            attr(a[1], vertex, sizeof(LineVertex), offsetof(LineVertex, segmentP0));
-            attr(a[2], vertex, sizeof(LineVertex), offsetof(LineVertex, segmentP1));
-            attr(a[3], vertex, sizeof(LineVertex), offsetof(LineVertex, radius));
-
-            //background
-            set3(u[2], whiteColor);
-            set1(u[3], 0.f);
-            drawFaces(mesh.face);
-
-            //foreground
-            set3(u[2], mesh.color);
-            set1(u[3], -1.5f);
-            drawFaces(mesh.face);
-        }
-    }
+    set<LinesLayout::Proj>(proj);
+    set<LinesLayout::View>(view);
+    set<LinesLayout::Scale>(scale);
+    set<LinesLayout::Smooth>(smooth ? 1.f : 0.f);
+    gl::state().bindVertexArray(mesh.gpu.vao);
+    drawQuads(mesh.instance.size());
 }
 
-PointShader::PointShader() : Shader(2, 1) {
-    u[0] = Uniform("Proj");
-    u[1] = Uniform("View");
-    a[0] = Attribute(VEC_2, "in_Position");
-}
-void PointShader::enable() const {
+void MotionShader::enable() const {
     Shader::enable();
-    glDisable(GL_DEPTH_TEST);
-    //glDepthMask(GL_FALSE);
-    glEnable(0x8642); //GL_PROGRAM_POINT_SIZE
+    gl::state().setBlend(false);
 }
-void PointShader::disable() const {
-    Shader::disable();
-    //glDepthMask(GL_TRUE);
-    glDisable(0x8642); //GL_PROGRAM_POINT_SIZE
-}
-void PointShader::render(const Camera& cam, const std::vector<glm::vec2>& points) {
-    if (points.empty()) {
+void MotionShader::render(const Camera& cam, float frameHeight, const MotionMesh& mesh) {
+    if (mesh.empty()) {
         return;
     }
-    set4(u[0], cam.proj);
-    set4(u[1], cam.view);
-    attr(a[0], points.data(), 0, 0);
-    glDrawArrays(GL_LINE_STRIP, 0, points.size());
-    glDrawArrays(GL_POINTS, 0, points.size());
+
+    set<MotionLayout::Proj>(cam.proj);
+    set<MotionLayout::View>(cam.view);
+    set<MotionLayout::Scale>(cam.scale_inverse);
+    set<MotionLayout::Height>(frameHeight);
+    gl::state().bindVertexArray(mesh.gpu.vao);
+    drawArrows(mesh.count);
 }
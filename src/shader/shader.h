@@ -2,32 +2,33 @@
 #include "shaderBase.h"
 #include "model/frame.h"
 
-class VideoShader : public Shader {
+class VideoShader : public ShaderProgram<VideoLayout> {
 public:
-    VideoShader();
     void enable() const override;
-    void disable() const override;
-    void render(const FrameRender& frame);
+    void render(const Camera& cam, const ImageMesh& mesh);
 };
 
-class LinesShader : public Shader {
+class CompareShader : public ShaderProgram<CompareLayout> {
 public:
-    LinesShader();
     void enable() const override;
-    void disable() const override;
-    void render(const FrameRender& frame);
+    void render(const Camera& cam, const ImageMesh& mesh, GLuint other, const Comparison& compare, const glm::vec2& frameSize);
 };
 
-class PointShader : public Shader {
+class LinesShader : public ShaderProgram<LinesLayout> {
 public:
-    PointShader();
     void enable() const override;
-    void disable() const override;
-    void render(const Camera& cam, const std::vector<glm::vec2>& points);
+    void render(const glm::mat4& proj, const glm::mat4& view, float scale, bool smooth, const LineMesh& mesh);
+};
+
+class MotionShader : public ShaderProgram<MotionLayout> {
+public:
+    void enable() const override;
+    void render(const Camera& cam, float frameHeight, const MotionMesh& mesh);
 };
 
 struct ShaderContext {
     VideoShader video;
+    CompareShader compare;
     LinesShader lines;
-    PointShader point;
-};
\ No newline at end of file
+    MotionShader motion;
+};
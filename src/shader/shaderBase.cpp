@@ -3,8 +3,11 @@
 #include <fstream>
 #include <iostream>
 #include <string_view>
+#include <vector>
 #include "shaderBase.h"
-#include "model/mesh.h"
+#include "glstate.h"
+#include "resources.h"
+#include "util/fs.h"
 
 using std::string;
 
@@ -120,7 +123,7 @@ static GLuint compile(GLenum shaderType, const char* shaderText) {
     glDeleteShader(shader);
     return 0;
 }
-static GLuint link(GLuint vertexShader, GLuint fragmentShader) {
+static GLuint link(GLuint vertexShader, GLuint fragmentShader, const AttributeSlot* attributes, size_t count) {
     if (!vertexShader || !fragmentShader) {
         warning("Can't link shader because of empty parts");
         return 0;
@@ -130,6 +133,15 @@ static GLuint link(GLuint vertexShader, GLuint fragmentShader) {
     GLuint program = glCreateProgram();
     glAttachShader(program, vertexShader);
     glAttachShader(program, fragmentShader);
+
+    // Meshes set up their vertex arrays with these locations
+    for (size_t i = 0; i < count; i++) {
+        glBindAttribLocation(program, attributes[i].location, attributes[i].name);
+    }
+
+    if (glGetProgramBinary) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
     glLinkProgram(program);
     glGetProgramiv(program, GL_LINK_STATUS, &linked);
     if (linked) {
@@ -156,13 +168,121 @@ static GLuint link(GLuint vertexShader, GLuint fragmentShader) {
     glDeleteProgram(program);
     return 0;
 }
-static GLuint build(const char* path) {
+/*
+    Linked programs are cached in resources::shaderCache as
+        uint64 key | uint32 binary format | binary
+    Key covers the sources, attribute locations and the driver,
+    so any change of them makes the program to be compiled again
+*/
+namespace binary {
+    static bool supported() {
+        if (!glGetProgramBinary || !glProgramBinary) {
+            return false;
+        }
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+    }
+    static uint64_t hash(uint64_t seed, std::string_view text) {
+        // FNV-1a
+        for (unsigned char c : text) {
+            seed ^= c;
+            seed *= 0x100000001b3ull;
+        }
+        return seed;
+    }
+    static uint64_t key(const Source& source, const AttributeSlot* attributes, size_t count) {
+        uint64_t result = 0xcbf29ce484222325ull;
+        for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+            auto value = reinterpret_cast<const char*>(glGetString(name));
+            result = hash(result, value ? value : "");
+        }
+        result = hash(result, source.vertex);
+        result = hash(result, source.fragment);
+        for (size_t i = 0; i < count; i++) {
+            result = hash(result, std::to_string(attributes[i].location));
+            result = hash(result, attributes[i].name);
+        }
+        return result;
+    }
+    static fs::path cachePath(const char* path) {
+        return fs::path(resources::shaderCache) / fs::path(path).filename().replace_extension(".bin");
+    }
+    static GLuint load(const char* path, uint64_t key) {
+        std::ifstream input(cachePath(path), std::ifstream::binary);
+        if (!input) {
+            return 0;
+        }
+
+        uint64_t storedKey = 0;
+        uint32_t format = 0;
+        input.read(reinterpret_cast<char*>(&storedKey), sizeof(storedKey));
+        input.read(reinterpret_cast<char*>(&format), sizeof(format));
+        if (!input || storedKey != key) {
+            return 0;
+        }
+        std::vector<char> data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        if (data.empty()) {
+            return 0;
+        }
+
+        // Driver may still reject the binary, then the program is compiled as usual
+        GLint linked = 0;
+        GLuint program = glCreateProgram();
+        glProgramBinary(program, format, data.data(), static_cast<GLsizei>(data.size()));
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            glDeleteProgram(program);
+            return 0;
+        }
+        return program;
+    }
+    static void save(const char* path, uint64_t key, GLuint program) {
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) {
+            return;
+        }
+
+        GLenum format = 0;
+        std::vector<char> data(length);
+        glGetProgramBinary(program, length, &length, &format, data.data());
+        if (length <= 0) {
+            return;
+        }
+
+        std::error_code error;
+        fs::create_directories(resources::shaderCache, error);
+        std::ofstream output(cachePath(path), std::ofstream::binary | std::ofstream::trunc);
+        if (!output) {
+            warning("Could not write shader cache for", path);
+            return;
+        }
+        const uint32_t storedFormat = format;
+        output.write(reinterpret_cast<const char*>(&key), sizeof(key));
+        output.write(reinterpret_cast<const char*>(&storedFormat), sizeof(storedFormat));
+        output.write(data.data(), length);
+    }
+}
+
+static GLuint build(const char* path, const AttributeSlot* attributes, size_t count) {
     Source shaderSource = load(path);
+    const bool cached = binary::supported();
+    const uint64_t key = cached ? binary::key(shaderSource, attributes, count) : 0;
+    if (cached) {
+        if (GLuint programId = binary::load(path, key)) {
+            return programId;
+        }
+    }
+
     GLuint vertexShader = compile(GL_VERTEX_SHADER, shaderSource.vertex.c_str());
     GLuint fragmentShader = compile(GL_FRAGMENT_SHADER, shaderSource.fragment.c_str());
-    GLuint programId = link(vertexShader, fragmentShader);
+    GLuint programId = link(vertexShader, fragmentShader, attributes, count);
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
+    if (cached && programId) {
+        binary::save(path, key, programId);
+    }
     return programId;
 }
 
@@ -181,117 +301,58 @@ Source& Source::operator=(Source&& right) noexcept {
     return *this;
 }
 
-Attribute::Attribute() : id(-1), size(-1), type(GL_NONE) {}
-Attribute::Attribute(GLSLType type, string name) :
-    id(-1),
-    size(type.size),
-    type(type.type),
-    name(std::move(name)) {
-}
-
-Uniform::Uniform() : id(-1) {}
-Uniform::Uniform(string name) :
-    id(-1),
-    name(std::move(name)) {
-}
-
-Shader::Shader(uint8_t uniforms, uint8_t attributes) :
-    programId(0) {
-    u.resize(uniforms);
-    a.resize(attributes);
-}
+Shader::Shader() : programId(0) { }
 Shader::~Shader() {
     destroy();
 }
-void Shader::create(const char* path) {
-
-    programId = build(path);
-    if (programId == 0) {
-        return;
-    }
-
-    glUseProgram(programId);
-    for (auto& uniform : u) {
-        uniform.id = glGetUniformLocation(programId, uniform.name.c_str());
-    }
-    for (auto& attribute : a) {
-        attribute.id = glGetAttribLocation(programId, attribute.name.c_str());
-    }
-    glUseProgram(0);
+bool Shader::build(const char* path, const AttributeSlot* attributes, size_t count) {
+    destroy();
+    programId = ::build(path, attributes, count);
+    return programId != 0;
 }
 void Shader::destroy() {
     if (programId > 0) {
+        gl::state().forgetProgram(programId);
         glDeleteProgram(programId);
         programId = 0;
     }
 }
 void Shader::enable() const {
-    glUseProgram(programId);
-    for (auto& attribute : a) {
-        if (attribute.id != -1) {
-            glEnableVertexAttribArray(attribute.id);
-        }
-    }
+    gl::state().useProgram(programId);
 }
-void Shader::disable() const {
-    for (auto& attribute : a) {
-        if (attribute.id != -1) {
-            glDisableVertexAttribArray(attribute.id);
-        }
+void Shader::set(GLint location, int value) {
+    if (location != -1) {
+        glUniform1i(location, value);
     }
-    glUseProgram(0);
 }
-void Shader::attr(const Attribute& attribute, const void* data, GLsizei stride, GLuint offset) {
-    if (attribute.id != -1) {
-        glVertexAttribPointer(
-            attribute.id,
-            attribute.size,
-            attribute.type,
-            GL_FALSE,
-            stride,
-            static_cast<const GLbyte*>(data) + offset
-        );
+void Shader::set(GLint location, float value) {
+    if (location != -1) {
+        glUniform1f(location, value);
     }
 }
-void Shader::attr(const Attribute& attribute, GLsizei stride, GLuint offset) {
-    if (attribute.id != -1) {
-        glVertexAttribPointer(
-            attribute.id,
-            attribute.size,
-            attribute.type,
-            GL_FALSE,
-            stride,
-            static_cast<const GLubyte*>(nullptr) + offset
-        );
+void Shader::set(GLint location, const glm::mat4& value) {
+    if (location != -1) {
+        glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
     }
 }
-void Shader::attr(const Attribute& attribute, const std::vector<float>& data) {
-    attr(attribute, data.data(), 0, 0);
-}
-void Shader::attr(const Attribute& attribute, const std::vector<glm::vec2>& data) {
-    attr(attribute, data.data(), 0, 0);
-}
-void Shader::attr(const Attribute& attribute, const std::vector<glm::vec3>& data) {
-    attr(attribute, data.data(), 0, 0);
-}
-void Shader::set1(const Uniform& uniform, float value) {
-    if (uniform.id != -1) {
-        glUniform1f(uniform.id, value);
-    }
-}
-void Shader::set3(const Uniform& uniform, const glm::vec3& value) {
-    if (uniform.id != -1) {
-        glUniform3fv(uniform.id, 1, glm::value_ptr(value));
+void Shader::drawFaces(size_t count) {
+    if (count == 0) {
+        return;
     }
+    // Faces are taken from element buffer of the bound vertex array
+    glDrawElements(GL_TRIANGLES, static_cast<int>(count * 3u), GL_UNSIGNED_SHORT, nullptr);
 }
-void Shader::set4(const Uniform& uniform, const glm::mat4& value) {
-    if (uniform.id != -1) {
-        glUniformMatrix4fv(uniform.id, 1, GL_FALSE, glm::value_ptr(value));
+void Shader::drawQuads(size_t instances) {
+    if (instances == 0) {
+        return;
     }
+    // Unit quad as triangle strip, expanded per instance in vertex shader
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(instances));
 }
-void Shader::drawFaces(const std::vector<GLFace>& faces) {
-    if (faces.empty()) {
+void Shader::drawArrows(size_t instances) {
+    if (instances == 0) {
         return;
     }
-    glDrawElements(GL_TRIANGLES, static_cast<int>(faces.size() * 3u), GL_UNSIGNED_SHORT, faces.data());
+    // Shaft of two triangles and the head, placed per instance in vertex shader
+    glDrawArraysInstanced(GL_TRIANGLES, 0, 9, static_cast<GLsizei>(instances));
 }
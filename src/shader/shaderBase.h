@@ -1,59 +1,59 @@
 #pragma once
 #include <glad/glad.h>
 #include <glm/glm.hpp>
-#include <vector>
-#include <string>
-
-struct GLFace; //forward
-
-struct GLSLType {
-    GLint size;
-    GLenum type;
-};
-
-struct Attribute {
-    GLint id;
-    GLint size;
-    GLenum type;
-    std::string name;
-    Attribute();
-    Attribute(GLSLType type, std::string name);
-};
-
-struct Uniform {
-    GLint id;
-    std::string name;
-    Uniform();
-    explicit Uniform(std::string name);
-};
+#include <array>
+#include <type_traits>
+#include "layout.h"
 
 class Shader {
 
 protected:
-    constexpr static const GLSLType FLOAT = GLSLType{ 1, GL_FLOAT };
-    constexpr static const GLSLType VEC_2 = GLSLType{ 2, GL_FLOAT };
-    constexpr static const GLSLType VEC_3 = GLSLType{ 3, GL_FLOAT };
-
-    static void attr(const Attribute& attribute, const void* data, GLsizei stride, GLuint offset);
-    static void attr(const Attribute& attribute, GLsizei stride, GLuint offset);
-    static void attr(const Attribute& attribute, const std::vector<float>& data);
-    static void attr(const Attribute& attribute, const std::vector<glm::vec2>& data);
-    static void attr(const Attribute& attribute, const std::vector<glm::vec3>& data);
-    static void set1(const Uniform& uniform, float value);
-    static void set3(const Uniform& uniform, const glm::vec3& value);
-    static void set4(const Uniform& uniform, const glm::mat4& value);
-    static void drawFaces(const std::vector<GLFace>& faces);
+    static void set(GLint location, int value);
+    static void set(GLint location, float value);
+    static void set(GLint location, const glm::mat4& value);
+    static void drawFaces(size_t count);
+    static void drawQuads(size_t instances);
+    static void drawArrows(size_t instances);
 
     GLuint programId;
-    std::vector<Attribute> a;
-    std::vector<Uniform> u;
+    bool build(const char* path, const AttributeSlot* attributes, size_t count);
 public:
 
-    Shader(uint8_t uniforms, uint8_t attributes);
+    Shader();
     virtual ~Shader();
 
-    void create(const char* path);
     void destroy();
     virtual void enable() const;
-    virtual void disable() const;
+};
+
+/*
+    Program with the interface described by Layout:
+        Layout::uniforms    - uniform names, index is the slot in location table
+        Layout::attributes  - attribute slots, bound to their locations before linking
+*/
+template<typename Layout>
+class ShaderProgram : public Shader {
+    static_assert(validAttributes<Layout>(), "Attribute locations must follow declaration order");
+    std::array<GLint, Layout::uniforms.size()> locations;
+
+public:
+    void create(const char* path) {
+        locations.fill(-1);
+        if (!build(path, Layout::attributes.data(), Layout::attributes.size())) {
+            return;
+        }
+        for (size_t i = 0; i < locations.size(); i++) {
+            locations[i] = glGetUniformLocation(programId, Layout::uniforms[i]);
+        }
+    }
+
+protected:
+    template<const auto& Slot, typename T>
+    void set(const T& value) const {
+        using SlotType = std::remove_cvref_t<decltype(Slot)>;
+        static_assert(std::is_same_v<typename SlotType::Owner, Layout>, "Uniform belongs to another shader");
+        static_assert(std::is_same_v<T, typename SlotType::Type>, "Value type differs from the uniform type");
+        static_assert(validUniform<Slot>(), "Uniform slot doesn't match its name in the layout");
+        Shader::set(locations[Slot.index], value);
+    }
 };
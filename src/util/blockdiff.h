@@ -0,0 +1,110 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRAMES_BLOCKDIFF_SSE2
+#endif
+
+/*
+	Compares every image with a copy of the previous one in square blocks.
+	Changed blocks are marked in the mask and copied over the previous image,
+	so static content costs one read of both images and no writes.
+
+	Example:
+
+	BlockDiff diff;
+	diff.compare(frame0, w, h, lineSize, 3);	// false: nothing to compare with
+	diff.compare(frame1, w, h, lineSize, 3);	// true: diff.mask() has changed blocks of frame1
+*/
+class BlockDiff {
+public:
+	static constexpr int blockSize = 64;
+
+	void reset() {
+		valid = false;
+	}
+
+	// Returns false when image can't be compared, then every block is marked dirty
+	bool compare(const uint8_t* pixels, int width, int height, int lineSize, int pixelSize) {
+		blocksX = (width + blockSize - 1) / blockSize;
+		blocksY = (height + blockSize - 1) / blockSize;
+		dirty.assign(static_cast<size_t>(blocksX) * blocksY, 0);
+		dirtyCount = 0;
+
+		const size_t bytes = static_cast<size_t>(lineSize) * height;
+		if (!valid || previous.size() != bytes || w != width || h != height || bpp != pixelSize) {
+			previous.assign(pixels, pixels + bytes);
+			std::fill(dirty.begin(), dirty.end(), 1);
+			dirtyCount = dirty.size();
+			valid = true;
+			w = width;
+			h = height;
+			bpp = pixelSize;
+			return false;
+		}
+
+		for (int by = 0; by < blocksY; by++) {
+			const int y0 = by * blockSize;
+			const int y1 = std::min(height, y0 + blockSize);
+			for (int bx = 0; bx < blocksX; bx++) {
+				const size_t offset = static_cast<size_t>(bx) * blockSize * pixelSize;
+				const size_t rowBytes = static_cast<size_t>(std::min(blockSize, width - bx * blockSize)) * pixelSize;
+				for (int y = y0; y < y1; y++) {
+					const size_t row = static_cast<size_t>(y) * lineSize + offset;
+					if (!equal(pixels + row, previous.data() + row, rowBytes)) {
+						// Rows above are equal, the rest of the block is refreshed
+						for (; y < y1; y++) {
+							const size_t copyRow = static_cast<size_t>(y) * lineSize + offset;
+							std::memcpy(previous.data() + copyRow, pixels + copyRow, rowBytes);
+						}
+						dirty[static_cast<size_t>(by) * blocksX + bx] = 1;
+						dirtyCount++;
+						break;
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	const std::vector<uint8_t>& mask() const {
+		return dirty;
+	}
+	int columns() const {
+		return blocksX;
+	}
+	int rows() const {
+		return blocksY;
+	}
+	float dirtyFraction() const {
+		return dirty.empty() ? 0.f : static_cast<float>(dirtyCount) / dirty.size();
+	}
+
+	static bool equal(const uint8_t* a, const uint8_t* b, size_t bytes) {
+		size_t i = 0;
+#ifdef FRAMES_BLOCKDIFF_SSE2
+		for (; i + 16 <= bytes; i += 16) {
+			const __m128i left = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+			const __m128i right = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi8(left, right)) != 0xFFFF) {
+				return false;
+			}
+		}
+#endif
+		return std::memcmp(a + i, b + i, bytes - i) == 0;
+	}
+
+private:
+	std::vector<uint8_t> previous;
+	std::vector<uint8_t> dirty;     // per block, row by row
+	size_t dirtyCount = 0;
+	int blocksX = 0;
+	int blocksY = 0;
+	int w = 0;
+	int h = 0;
+	int bpp = 0;
+	bool valid = false;
+};
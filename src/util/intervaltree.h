@@ -0,0 +1,108 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/*
+	Augmented interval tree over half-open intervals [from, to).
+	Intervals are kept sorted by start in a vector which is an implicit
+	balanced tree: middle of every range is its root and stores the max
+	end of the range. Stabbing query costs O(log(n) + k), modification
+	costs O(n) and is expected to be rare compared to queries
+
+	Example:
+
+	IntervalTree<int> tree;
+	tree.insert(0, 10, 1);
+	tree.insert(5, 20, 2);
+	tree.query(7, [](const int& value) { ... });   // 1, 2
+	tree.query(15, [](const int& value) { ... });  // 2
+*/
+template<typename T>
+class IntervalTree {
+public:
+	struct Interval {
+		int64_t from;
+		int64_t to;
+		T value;
+	};
+
+	// Bulk insert which rebuilds the tree only once
+	void insert(const std::vector<Interval>& intervals) {
+		for (const auto& item : intervals) {
+			nodes.push_back(Node{ item.from, item.to, item.to, item.value });
+		}
+		std::stable_sort(nodes.begin(), nodes.end(), [](const Node& left, const Node& right) {
+			return left.from < right.from;
+		});
+		build(0, nodes.size());
+	}
+
+	void insert(int64_t from, int64_t to, const T& value) {
+		auto pos = std::upper_bound(nodes.begin(), nodes.end(), from, [](int64_t from, const Node& node) {
+			return from < node.from;
+		});
+		nodes.insert(pos, Node{ from, to, to, value });
+		build(0, nodes.size());
+	}
+
+	void remove(const T& value) {
+		nodes.erase(std::remove_if(nodes.begin(), nodes.end(), [&](const Node& node) {
+			return node.value == value;
+		}), nodes.end());
+		build(0, nodes.size());
+	}
+
+	void clear() {
+		nodes.clear();
+	}
+
+	size_t size() const {
+		return nodes.size();
+	}
+
+	// Calls fn(value) for every interval containing point, ordered by start
+	template<typename Fn>
+	void query(int64_t point, Fn fn) const {
+		query(0, nodes.size(), point, fn);
+	}
+
+private:
+	struct Node {
+		int64_t from;
+		int64_t to;
+		int64_t maxTo;	// max end in subtree
+		T value;
+	};
+	std::vector<Node> nodes;
+
+	int64_t build(size_t lo, size_t hi) {
+		if (lo >= hi) {
+			return INT64_MIN;
+		}
+		const size_t mid = lo + (hi - lo) / 2;
+		auto& node = nodes[mid];
+		node.maxTo = std::max({ node.to, build(lo, mid), build(mid + 1, hi) });
+		return node.maxTo;
+	}
+
+	template<typename Fn>
+	void query(size_t lo, size_t hi, int64_t point, Fn& fn) const {
+		if (lo >= hi) {
+			return;
+		}
+		const size_t mid = lo + (hi - lo) / 2;
+		const auto& node = nodes[mid];
+		if (node.maxTo <= point) {
+			return;
+		}
+
+		query(lo, mid, point, fn);
+		if (node.from <= point) {
+			if (point < node.to) {
+				fn(node.value);
+			}
+			query(mid + 1, hi, point, fn);
+		}
+	}
+};
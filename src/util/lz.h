@@ -0,0 +1,181 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/*
+	Byte-oriented LZ77 codec in the spirit of LZ4: no entropy stage,
+	so decoding is a loop of copies and runs at memory speed.
+
+	Stream is a list of sequences:
+		token       - literal count in high nibble, match length - 4 in low nibble
+		[255...]    - continuation of literal count when the nibble is 15
+		literals
+		offset      - 2 bytes, little endian, absent in the last sequence
+		[255...]    - continuation of match length when the nibble is 15
+
+	'delta' filter replaces every byte by its difference with the byte 'stride' back,
+	flat areas of an image become zero runs which compress much better.
+
+	Example:
+
+	std::vector<uint8_t> packed(lz::bound(size));
+	packed.resize(lz::compress(data, size, packed.data()));
+	lz::decompress(packed.data(), packed.size(), restored, size);
+*/
+namespace lz {
+
+	constexpr size_t minMatch = 4;
+	constexpr size_t maxOffset = 65535;
+	constexpr int hashBits = 14;
+
+	inline size_t bound(size_t size) {
+		return size + size / 255 + 16;
+	}
+
+	namespace detail {
+		inline uint32_t read32(const uint8_t* p) {
+			uint32_t value;
+			std::memcpy(&value, p, sizeof(value));
+			return value;
+		}
+		inline uint32_t hash(uint32_t value) {
+			return (value * 2654435761u) >> (32 - hashBits);
+		}
+		inline uint8_t* writeLength(uint8_t* out, size_t length) {
+			for (; length >= 255; length -= 255) {
+				*out++ = 255;
+			}
+			*out++ = static_cast<uint8_t>(length);
+			return out;
+		}
+		inline uint8_t* writeSequence(uint8_t* out, const uint8_t* literals, size_t literalCount, size_t offset, size_t matchLength) {
+			const size_t matchCode = matchLength ? matchLength - minMatch : 0;
+			uint8_t* token = out++;
+			*token = static_cast<uint8_t>(((literalCount < 15 ? literalCount : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+			if (literalCount >= 15) {
+				out = writeLength(out, literalCount - 15);
+			}
+			std::memcpy(out, literals, literalCount);
+			out += literalCount;
+			if (matchLength) {
+				*out++ = static_cast<uint8_t>(offset);
+				*out++ = static_cast<uint8_t>(offset >> 8);
+				if (matchCode >= 15) {
+					out = writeLength(out, matchCode - 15);
+				}
+			}
+			return out;
+		}
+		inline bool readLength(const uint8_t*& in, const uint8_t* end, size_t& length) {
+			uint8_t value;
+			do {
+				if (in >= end) {
+					return false;
+				}
+				value = *in++;
+				length += value;
+			} while (value == 255);
+			return true;
+		}
+	}
+
+	// Returns size of compressed data, 'out' must hold bound(size) bytes
+	inline size_t compress(const uint8_t* data, size_t size, uint8_t* out) {
+		using namespace detail;
+		std::vector<uint32_t> table(size_t(1) << hashBits, 0);
+		uint8_t* const start = out;
+		const uint8_t* anchor = data;
+		const uint8_t* p = data;
+		const uint8_t* const end = data + size;
+
+		while (size >= minMatch && p + minMatch <= end) {
+			const uint32_t value = read32(p);
+			const uint32_t h = hash(value);
+			const uint8_t* candidate = data + table[h];
+			table[h] = static_cast<uint32_t>(p - data);
+
+			const size_t offset = static_cast<size_t>(p - candidate);
+			if (candidate >= p || offset > maxOffset || read32(candidate) != value) {
+				p++;
+				continue;
+			}
+
+			size_t length = minMatch;
+			while (p + length < end && candidate[length] == p[length]) {
+				length++;
+			}
+			out = writeSequence(out, anchor, static_cast<size_t>(p - anchor), offset, length);
+			p += length;
+			anchor = p;
+		}
+
+		out = writeSequence(out, anchor, static_cast<size_t>(end - anchor), 0, 0);
+		return static_cast<size_t>(out - start);
+	}
+
+	// Returns false when data is damaged or doesn't fit 'size' bytes exactly
+	inline bool decompress(const uint8_t* data, size_t dataSize, uint8_t* out, size_t size) {
+		using namespace detail;
+		const uint8_t* in = data;
+		const uint8_t* const inEnd = data + dataSize;
+		uint8_t* p = out;
+		uint8_t* const end = out + size;
+
+		while (in < inEnd) {
+			const uint8_t token = *in++;
+			size_t literalCount = token >> 4;
+			if (literalCount == 15 && !readLength(in, inEnd, literalCount)) {
+				return false;
+			}
+			if (literalCount > static_cast<size_t>(inEnd - in) || literalCount > static_cast<size_t>(end - p)) {
+				return false;
+			}
+			std::memcpy(p, in, literalCount);
+			in += literalCount;
+			p += literalCount;
+			if (in == inEnd) {
+				break; // last sequence has literals only
+			}
+
+			if (inEnd - in < 2) {
+				return false;
+			}
+			const size_t offset = in[0] | (in[1] << 8);
+			in += 2;
+			size_t length = token & 15;
+			if (length == 15 && !readLength(in, inEnd, length)) {
+				return false;
+			}
+			length += minMatch;
+			if (offset == 0 || offset > static_cast<size_t>(p - out) || length > static_cast<size_t>(end - p)) {
+				return false;
+			}
+
+			// Match may overlap the bytes it produces
+			const uint8_t* match = p - offset;
+			if (offset >= length) {
+				std::memcpy(p, match, length);
+				p += length;
+			}
+			else {
+				for (size_t i = 0; i < length; i++) {
+					*p++ = *match++;
+				}
+			}
+		}
+		return p == end;
+	}
+
+	inline void deltaEncode(uint8_t* data, size_t size, size_t stride) {
+		for (size_t i = size; i-- > stride;) {
+			data[i] = static_cast<uint8_t>(data[i] - data[i - stride]);
+		}
+	}
+	inline void deltaDecode(uint8_t* data, size_t size, size_t stride) {
+		for (size_t i = stride; i < size; i++) {
+			data[i] = static_cast<uint8_t>(data[i] + data[i - stride]);
+		}
+	}
+}
@@ -0,0 +1,101 @@
+#include "mapfile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+#ifdef _WIN32
+bool MappedFile::open(const fs::path& path) {
+	close();
+
+	// Share write access: the file may be appended while mapped
+	HANDLE handle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0) {
+		CloseHandle(handle);
+		return false;
+	}
+
+	HANDLE map = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!map) {
+		CloseHandle(handle);
+		return false;
+	}
+
+	void* view = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+	if (!view) {
+		CloseHandle(map);
+		CloseHandle(handle);
+		return false;
+	}
+
+	file = handle;
+	mapping = map;
+	ptr = static_cast<const uint8_t*>(view);
+	length = static_cast<size_t>(size.QuadPart);
+	return true;
+}
+void MappedFile::close() {
+	if (ptr) {
+		UnmapViewOfFile(ptr);
+	}
+	if (mapping) {
+		CloseHandle(mapping);
+	}
+	if (file) {
+		CloseHandle(file);
+	}
+	ptr = nullptr;
+	length = 0;
+	mapping = nullptr;
+	file = nullptr;
+}
+#else
+bool MappedFile::open(const fs::path& path) {
+	close();
+
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	// Mapping stays valid after the descriptor is closed
+	void* view = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (view == MAP_FAILED) {
+		return false;
+	}
+
+	ptr = static_cast<const uint8_t*>(view);
+	length = static_cast<size_t>(info.st_size);
+	return true;
+}
+void MappedFile::close() {
+	if (ptr) {
+		munmap(const_cast<uint8_t*>(ptr), length);
+	}
+	ptr = nullptr;
+	length = 0;
+}
+#endif
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include "util/fs.h"
+
+/* Read-only memory mapping of a whole file */
+class MappedFile {
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile();
+
+	bool open(const fs::path& path);
+	void close();
+	const uint8_t* data() const { return ptr; }
+	size_t size() const { return length; }
+
+private:
+	const uint8_t* ptr = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#endif
+};
@@ -0,0 +1,118 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRAMES_METRICS_SSE2
+#endif
+
+/*
+	Full-reference quality metrics of two RGB24 images of the same size.
+	PSNR is taken over all channels. SSIM is taken over the luma of
+	non-overlapping 8x8 blocks and averaged, which is close enough to
+	the gaussian window version to tell encodes apart and much cheaper.
+
+	Example:
+
+	double mse = metrics::mse(a, b, w, h, lineSize);
+	double psnr = metrics::psnr(mse);	// dB, maxPsnr for identical images
+	double ssim = metrics::ssim(a, b, w, h, lineSize);
+*/
+namespace metrics {
+
+	constexpr double maxPsnr = 100.0;
+	constexpr int ssimBlock = 8;
+
+	// Sum of squared differences of 'size' bytes
+	inline uint64_t squaredError(const uint8_t* a, const uint8_t* b, size_t size) {
+		uint64_t sum = 0;
+		size_t i = 0;
+#ifdef FRAMES_METRICS_SSE2
+		// Every step adds at most 2 * 2 * 255^2 to a 32-bit lane, so lanes are flushed well before overflow
+		constexpr size_t flushSteps = 4096;
+		const __m128i zero = _mm_setzero_si128();
+		while (i + 16 <= size) {
+			__m128i acc = _mm_setzero_si128();
+			for (size_t step = 0; step < flushSteps && i + 16 <= size; step++, i += 16) {
+				const __m128i left = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+				const __m128i right = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+				const __m128i low = _mm_sub_epi16(_mm_unpacklo_epi8(left, zero), _mm_unpacklo_epi8(right, zero));
+				const __m128i high = _mm_sub_epi16(_mm_unpackhi_epi8(left, zero), _mm_unpackhi_epi8(right, zero));
+				acc = _mm_add_epi32(acc, _mm_madd_epi16(low, low));
+				acc = _mm_add_epi32(acc, _mm_madd_epi16(high, high));
+			}
+			uint32_t lanes[4];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+			sum += static_cast<uint64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+		}
+#endif
+		for (; i < size; i++) {
+			const int d = static_cast<int>(a[i]) - b[i];
+			sum += static_cast<uint64_t>(d * d);
+		}
+		return sum;
+	}
+
+	// Mean squared error per channel value
+	inline double mse(const uint8_t* a, const uint8_t* b, int width, int height, int lineSize) {
+		if (width <= 0 || height <= 0) {
+			return 0.0;
+		}
+		const size_t rowBytes = static_cast<size_t>(width) * 3;
+		uint64_t sum = 0;
+		for (int y = 0; y < height; y++) {
+			const size_t row = static_cast<size_t>(y) * lineSize;
+			sum += squaredError(a + row, b + row, rowBytes);
+		}
+		return static_cast<double>(sum) / (static_cast<double>(rowBytes) * height);
+	}
+
+	inline double psnr(double mse) {
+		if (mse <= 0.0) {
+			return maxPsnr;
+		}
+		return std::min(maxPsnr, 10.0 * std::log10(255.0 * 255.0 / mse));
+	}
+
+	// Mean SSIM of luma blocks, partial blocks at the right and bottom edges are skipped
+	inline double ssim(const uint8_t* a, const uint8_t* b, int width, int height, int lineSize) {
+		constexpr double c1 = (0.01 * 255) * (0.01 * 255);
+		constexpr double c2 = (0.03 * 255) * (0.03 * 255);
+		constexpr double n = ssimBlock * ssimBlock;
+		auto luma = [](const uint8_t* p) {
+			return (77 * p[0] + 150 * p[1] + 29 * p[2]) >> 8;
+		};
+
+		double total = 0.0;
+		size_t blocks = 0;
+		for (int by = 0; by + ssimBlock <= height; by += ssimBlock) {
+			for (int bx = 0; bx + ssimBlock <= width; bx += ssimBlock) {
+				int64_t sumA = 0, sumB = 0, sumAA = 0, sumBB = 0, sumAB = 0;
+				for (int y = by; y < by + ssimBlock; y++) {
+					const uint8_t* rowA = a + static_cast<size_t>(y) * lineSize + static_cast<size_t>(bx) * 3;
+					const uint8_t* rowB = b + static_cast<size_t>(y) * lineSize + static_cast<size_t>(bx) * 3;
+					for (int x = 0; x < ssimBlock; x++) {
+						const int64_t la = luma(rowA + x * 3);
+						const int64_t lb = luma(rowB + x * 3);
+						sumA += la;
+						sumB += lb;
+						sumAA += la * la;
+						sumBB += lb * lb;
+						sumAB += la * lb;
+					}
+				}
+				const double meanA = sumA / n;
+				const double meanB = sumB / n;
+				const double varA = sumAA / n - meanA * meanA;
+				const double varB = sumBB / n - meanB * meanB;
+				const double cov = sumAB / n - meanA * meanB;
+				total += ((2 * meanA * meanB + c1) * (2 * cov + c2)) /
+					((meanA * meanA + meanB * meanB + c1) * (varA + varB + c2));
+				blocks++;
+			}
+		}
+		return blocks ? total / blocks : 1.0;
+	}
+}
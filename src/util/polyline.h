@@ -0,0 +1,68 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+
+/*
+	Streaming Douglas-Peucker simplification of a polyline being drawn.
+	Keeps the last fixed point and raw points received after it.
+	A new point extends the last segment while every raw point stays
+	within tolerance of it, otherwise the previous point becomes fixed
+
+	Example:
+
+	PolylineSimplifier simplifier;
+	simplifier.reset({ 0, 0 });
+	simplifier.push({ 1, 0 }, 0.5f);	// Append: [0,0] - [1,0]
+	simplifier.push({ 2, 0.1f }, 0.5f);	// Extend: [0,0] - [2,0.1]
+	simplifier.push({ 2, 2 }, 0.5f);	// Append: [0,0] - [2,0.1] - [2,2]
+*/
+class PolylineSimplifier {
+public:
+	enum struct Result {
+		Append,		// pos is a new point of polyline
+		Extend		// pos replaces last point of polyline
+	};
+
+	void reset(const glm::vec2& start) {
+		run.clear();
+		run.push_back(start);
+	}
+
+	Result push(const glm::vec2& pos, float tolerance) {
+		if (run.size() > 1 && run.size() < maxRun && fits(pos, tolerance)) {
+			run.push_back(pos);
+			return Result::Extend;
+		}
+
+		if (run.size() > 1) {
+			const glm::vec2 fixed = run.back();
+			run.clear();
+			run.push_back(fixed);
+		}
+		run.push_back(pos);
+		return Result::Append;
+	}
+
+private:
+	// Bounds the cost of a single push on long straight strokes
+	static constexpr size_t maxRun = 64;
+	std::vector<glm::vec2> run;
+
+	bool fits(const glm::vec2& end, float tolerance) const {
+		const glm::vec2 start = run.front();
+		const glm::vec2 dir = end - start;
+		const float length2 = glm::dot(dir, dir);
+		const float tolerance2 = tolerance * tolerance;
+
+		for (size_t i = 1; i < run.size(); i++) {
+			const glm::vec2 point = run[i];
+			float t = length2 > 0.f ? glm::dot(point - start, dir) / length2 : 0.f;
+			t = glm::clamp(t, 0.f, 1.f);
+			const glm::vec2 delta = point - (start + t * dir);
+			if (glm::dot(delta, delta) > tolerance2) {
+				return false;
+			}
+		}
+		return true;
+	}
+};
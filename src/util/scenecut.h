@@ -0,0 +1,206 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRAMES_SCENECUT_SSE2
+#endif
+
+/*
+	Scene cut detection on 8-bit YUV planes.
+	Every frame is reduced to histograms of Y, U and V and a tiny luma thumbnail,
+	taken from at most 'maxRows' rows of every plane. Histograms tell a change
+	of the colors, the thumbnail tells a change of the layout when colors stay.
+	Detector marks a cut when the difference of neighbour frames is high
+	and clearly above the recent differences, so fast motion doesn't flood it.
+
+	Example:
+
+	scenecut::Features previous, current;
+	scenecut::Detector detector;
+	scenecut::extract(planes, lineSizes, w, h, 1, 1, current);
+	if (detector.push(scenecut::difference(previous, current))) { ... }
+*/
+namespace scenecut {
+
+	constexpr int bins = 32;
+	constexpr int thumbWidth = 32;
+	constexpr int thumbHeight = 18;
+	constexpr int maxRows = 180;
+
+	struct Features {
+		uint32_t histogram[3][bins] = {};
+		uint8_t thumbnail[thumbWidth * thumbHeight] = {};
+		bool valid = false;
+	};
+
+	namespace detail {
+		inline uint32_t sumBytes(const uint8_t* p, size_t size) {
+			uint32_t sum = 0;
+			size_t i = 0;
+#ifdef FRAMES_SCENECUT_SSE2
+			const __m128i zero = _mm_setzero_si128();
+			__m128i acc = _mm_setzero_si128();
+			for (; i + 16 <= size; i += 16) {
+				acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)), zero));
+			}
+			sum = static_cast<uint32_t>(_mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+#endif
+			for (; i < size; i++) {
+				sum += p[i];
+			}
+			return sum;
+		}
+		inline uint32_t absDiff(const uint8_t* a, const uint8_t* b, size_t size) {
+			uint32_t sum = 0;
+			size_t i = 0;
+#ifdef FRAMES_SCENECUT_SSE2
+			__m128i acc = _mm_setzero_si128();
+			for (; i + 16 <= size; i += 16) {
+				const __m128i left = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+				const __m128i right = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+				acc = _mm_add_epi64(acc, _mm_sad_epu8(left, right));
+			}
+			sum = static_cast<uint32_t>(_mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+#endif
+			for (; i < size; i++) {
+				sum += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+			}
+			return sum;
+		}
+
+		// Four tables take turns, so increments of equal neighbour values don't wait for each other
+		inline void countRow(const uint8_t* p, size_t size, uint32_t (&tables)[4][bins]) {
+			constexpr int shift = 3;	// 256 values to 32 bins
+			size_t i = 0;
+#ifdef FRAMES_SCENECUT_SSE2
+			alignas(16) uint8_t index[16];
+			const __m128i mask = _mm_set1_epi8(bins - 1);
+			for (; i + 16 <= size; i += 16) {
+				const __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+				_mm_store_si128(reinterpret_cast<__m128i*>(index), _mm_and_si128(_mm_srli_epi16(values, shift), mask));
+				for (int k = 0; k < 16; k += 4) {
+					tables[0][index[k]]++;
+					tables[1][index[k + 1]]++;
+					tables[2][index[k + 2]]++;
+					tables[3][index[k + 3]]++;
+				}
+			}
+#endif
+			for (; i < size; i++) {
+				tables[i & 3][p[i] >> shift]++;
+			}
+		}
+
+		inline void histogram(const uint8_t* plane, int lineSize, int width, int height, uint32_t (&out)[bins]) {
+			uint32_t tables[4][bins] = {};
+			const int step = std::max(1, (height + maxRows - 1) / maxRows);
+			for (int y = 0; y < height; y += step) {
+				countRow(plane + static_cast<size_t>(y) * lineSize, static_cast<size_t>(width), tables);
+			}
+			for (int b = 0; b < bins; b++) {
+				out[b] = tables[0][b] + tables[1][b] + tables[2][b] + tables[3][b];
+			}
+		}
+
+		inline float histogramDistance(const uint32_t (&a)[bins], const uint32_t (&b)[bins]) {
+			uint64_t totalA = 0, totalB = 0;
+			for (int i = 0; i < bins; i++) {
+				totalA += a[i];
+				totalB += b[i];
+			}
+			if (!totalA || !totalB) {
+				return 0.f;
+			}
+			// Half of L1 distance of normalized histograms, in [0, 1]
+			double distance = 0.0;
+			for (int i = 0; i < bins; i++) {
+				distance += std::abs(static_cast<double>(a[i]) / totalA - static_cast<double>(b[i]) / totalB);
+			}
+			return static_cast<float>(0.5 * distance);
+		}
+	}
+
+	// 'shiftX' and 'shiftY' are log2 of chroma subsampling, 1 and 1 for 4:2:0
+	inline void extract(const uint8_t* const planes[3], const int lineSizes[3], int width, int height, int shiftX, int shiftY, Features& out) {
+		using namespace detail;
+		out = Features();
+		if (width < thumbWidth || height < thumbHeight) {
+			return;
+		}
+
+		const int chromaWidth = (width + (1 << shiftX) - 1) >> shiftX;
+		const int chromaHeight = (height + (1 << shiftY) - 1) >> shiftY;
+		histogram(planes[0], lineSizes[0], width, height, out.histogram[0]);
+		histogram(planes[1], lineSizes[1], chromaWidth, chromaHeight, out.histogram[1]);
+		histogram(planes[2], lineSizes[2], chromaWidth, chromaHeight, out.histogram[2]);
+
+		// Cell averages over the sampled rows
+		uint32_t sums[thumbWidth * thumbHeight] = {};
+		uint32_t counts[thumbHeight] = {};
+		const int step = std::max(1, (height + maxRows - 1) / maxRows);
+		for (int y = 0; y < height; y += step) {
+			const int cy = y * thumbHeight / height;
+			const uint8_t* row = planes[0] + static_cast<size_t>(y) * lineSizes[0];
+			for (int cx = 0; cx < thumbWidth; cx++) {
+				const int x0 = cx * width / thumbWidth;
+				const int x1 = (cx + 1) * width / thumbWidth;
+				sums[cy * thumbWidth + cx] += sumBytes(row + x0, static_cast<size_t>(x1 - x0));
+			}
+			counts[cy]++;
+		}
+		for (int cy = 0; cy < thumbHeight; cy++) {
+			for (int cx = 0; cx < thumbWidth; cx++) {
+				const uint32_t pixels = counts[cy] * static_cast<uint32_t>((cx + 1) * width / thumbWidth - cx * width / thumbWidth);
+				out.thumbnail[cy * thumbWidth + cx] = static_cast<uint8_t>(pixels ? sums[cy * thumbWidth + cx] / pixels : 0);
+			}
+		}
+		out.valid = true;
+	}
+
+	// 0 for the same picture, close to 1 for unrelated pictures
+	inline float difference(const Features& a, const Features& b) {
+		using namespace detail;
+		if (!a.valid || !b.valid) {
+			return 0.f;
+		}
+		const float colors =
+			0.5f * histogramDistance(a.histogram[0], b.histogram[0]) +
+			0.25f * histogramDistance(a.histogram[1], b.histogram[1]) +
+			0.25f * histogramDistance(a.histogram[2], b.histogram[2]);
+		const float layout = static_cast<float>(absDiff(a.thumbnail, b.thumbnail, sizeof(a.thumbnail))) / (sizeof(a.thumbnail) * 255.f);
+		return 0.5f * colors + 0.5f * std::min(1.f, 4.f * layout);
+	}
+
+	class Detector {
+	public:
+		static constexpr float threshold = 0.3f;
+		static constexpr float contrast = 3.f;		// times the recent average
+		static constexpr size_t window = 8;
+
+		bool push(float score) {
+			float average = 0.f;
+			for (float value : recent) {
+				average += value;
+			}
+			average = recent.empty() ? 0.f : average / recent.size();
+
+			const bool cut = score >= threshold && score >= contrast * average;
+			recent.push_back(score);
+			if (recent.size() > window) {
+				recent.pop_front();
+			}
+			return cut;
+		}
+		void reset() {
+			recent.clear();
+		}
+
+	private:
+		std::deque<float> recent;
+	};
+}
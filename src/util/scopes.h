@@ -0,0 +1,135 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRAMES_SCOPES_SSE2
+#endif
+
+/*
+	Video scopes of planar YUV: luma histogram, luma waveform and vectorscope.
+	At most 'maxRows' x 'maxColumns' samples of every plane are counted,
+	so a frame costs the same at any resolution. Samples deeper than 8 bits
+	are reduced to 8 bits, levels are code values, not normalized to the video range.
+	Counts become 8-bit intensities with 'shade', its gain is a display setting
+
+	Example:
+
+	scopes::Counts counts;
+	scopes::measure<uint8_t>(planes, lineSizes, w, h, 1, 1, 8, counts);
+	scopes::shade(counts.waveform, scopes::waveformSize, scopes::gain(counts.lumaSamples, scopes::waveformSize, 1.f), pixels);
+*/
+namespace scopes {
+
+	constexpr int levels = 256;
+	constexpr int waveWidth = 256;		// columns of the waveform
+	constexpr int vectorSize = 128;		// cells of the vectorscope per axis
+	constexpr int maxRows = 256;
+	constexpr int maxColumns = 1024;
+	constexpr size_t waveformSize = static_cast<size_t>(levels) * waveWidth;
+	constexpr size_t vectorscopeSize = static_cast<size_t>(vectorSize) * vectorSize;
+
+	struct Counts {
+		uint32_t histogram[levels] = {};
+		uint16_t waveform[waveformSize] = {};			// rows are levels from 255 down to 0, columns go along the frame
+		uint16_t vectorscope[vectorscopeSize] = {};		// rows are Cr from high to low, columns are Cb, saturated
+		uint32_t lumaSamples = 0;
+		uint32_t chromaSamples = 0;
+	};
+
+	namespace detail {
+		inline int step(int size, int limit) {
+			return std::max(1, (size + limit - 1) / limit);
+		}
+		template<typename T>
+		inline int level(T value, int shift) {
+			return std::min(levels - 1, static_cast<int>(value >> shift));
+		}
+	}
+
+	// 'shiftX' and 'shiftY' are log2 of chroma subsampling, 'depth' is bits per sample, 8 for uint8_t
+	template<typename T>
+	inline void measure(const uint8_t* const planes[3], const int lineSizes[3], int width, int height, int shiftX, int shiftY, int depth, Counts& out) {
+		using namespace detail;
+		std::fill(std::begin(out.histogram), std::end(out.histogram), 0u);
+		std::fill(std::begin(out.waveform), std::end(out.waveform), uint16_t(0));
+		std::fill(std::begin(out.vectorscope), std::end(out.vectorscope), uint16_t(0));
+		out.lumaSamples = 0;
+		out.chromaSamples = 0;
+		if (width <= 0 || height <= 0) {
+			return;
+		}
+		const int shift = std::max(0, depth - 8);
+
+		// Four histogram tables take turns, so increments of equal neighbour values don't wait for each other.
+		// Waveform column advances in 16.16 fixed point instead of a division per sample
+		uint32_t tables[4][levels] = {};
+		const int rowStep = step(height, maxRows);
+		const int columnStep = step(width, maxColumns);
+		const uint32_t columnDelta = static_cast<uint32_t>((static_cast<uint64_t>(columnStep) * waveWidth << 16) / width);
+		for (int y = 0; y < height; y += rowStep) {
+			const T* row = reinterpret_cast<const T*>(planes[0] + static_cast<size_t>(y) * lineSizes[0]);
+			uint32_t column = 0;
+			int k = 0;
+			for (int x = 0; x < width; x += columnStep, k++) {
+				const int value = level(row[x], shift);
+				tables[k & 3][value]++;
+				out.waveform[(levels - 1 - value) * waveWidth + std::min(waveWidth - 1, static_cast<int>(column >> 16))]++;
+				column += columnDelta;
+			}
+			out.lumaSamples += static_cast<uint32_t>(k);
+		}
+		for (int i = 0; i < levels; i++) {
+			out.histogram[i] = tables[0][i] + tables[1][i] + tables[2][i] + tables[3][i];
+		}
+
+		const int chromaWidth = (width + (1 << shiftX) - 1) >> shiftX;
+		const int chromaHeight = (height + (1 << shiftY) - 1) >> shiftY;
+		const int chromaRowStep = step(chromaHeight, maxRows);
+		const int chromaColumnStep = step(chromaWidth, maxColumns);
+		constexpr int cellShift = 1;	// 256 levels to 128 cells
+		for (int y = 0; y < chromaHeight; y += chromaRowStep) {
+			const T* rowU = reinterpret_cast<const T*>(planes[1] + static_cast<size_t>(y) * lineSizes[1]);
+			const T* rowV = reinterpret_cast<const T*>(planes[2] + static_cast<size_t>(y) * lineSizes[2]);
+			for (int x = 0; x < chromaWidth; x += chromaColumnStep) {
+				const int cb = level(rowU[x], shift) >> cellShift;
+				const int cr = level(rowV[x], shift) >> cellShift;
+				uint16_t& cell = out.vectorscope[(vectorSize - 1 - cr) * vectorSize + cb];
+				cell += cell != UINT16_MAX;
+				out.chromaSamples++;
+			}
+		}
+	}
+
+	// Gain of 'shade' for counts of 'samples' spread over 'cells', 'brightness' 1 is the default look
+	inline uint16_t gain(uint32_t samples, size_t cells, float brightness) {
+		const double density = std::max(1.0, 16.0 * samples / std::max<size_t>(cells, 1));
+		return static_cast<uint16_t>(std::clamp(brightness * 255.0 * 256.0 / density, 1.0, 65535.0));
+	}
+
+	// Intensity min(255, count * gain / 256) of every count
+	inline void shade(const uint16_t* counts, size_t size, uint16_t gain, uint8_t* out) {
+		size_t i = 0;
+#ifdef FRAMES_SCOPES_SSE2
+		// Product is white when its high half isn't zero
+		const __m128i vGain = _mm_set1_epi16(static_cast<short>(gain));
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i white = _mm_set1_epi16(255);
+		auto scale = [&](__m128i value) {
+			const __m128i low = _mm_srli_epi16(_mm_mullo_epi16(value, vGain), 8);
+			const __m128i over = _mm_andnot_si128(_mm_cmpeq_epi16(_mm_mulhi_epu16(value, vGain), zero), white);
+			return _mm_or_si128(low, over);
+		};
+		for (; i + 16 <= size; i += 16) {
+			const __m128i low = scale(_mm_loadu_si128(reinterpret_cast<const __m128i*>(counts + i)));
+			const __m128i high = scale(_mm_loadu_si128(reinterpret_cast<const __m128i*>(counts + i + 8)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(low, high));
+		}
+#endif
+		for (; i < size; i++) {
+			out[i] = static_cast<uint8_t>(std::min<uint32_t>(255, static_cast<uint32_t>(counts[i]) * gain >> 8));
+		}
+	}
+}
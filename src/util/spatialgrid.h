@@ -0,0 +1,113 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+
+/*
+	Sparse uniform grid over thick segments (capsules) for hit-testing.
+	Every segment is stored in the cells it touches, so a query only
+	visits the cells under the probe circle, whatever the total count.
+	A value may be reported several times by one query: once per its
+	segment hit and per cell containing it
+
+	Example:
+
+	SpatialGrid<int> grid(64.f);
+	grid.insert(1, { 0, 0 }, { 100, 0 }, 5.f);
+	grid.query({ 50, 8 }, 4.f, [](const int& value) { ... }); // value == 1
+	grid.remove(1, { 0, 0 }, { 100, 0 }, 5.f);
+*/
+template<typename T>
+class SpatialGrid {
+public:
+	explicit SpatialGrid(float cellSize = 64.f) : cellSize(cellSize) { }
+
+	void insert(const T& value, const glm::vec2& p1, const glm::vec2& p2, float radius) {
+		const Item item = { value, p1, p2, radius };
+		// Skip cells of the bounding box which the capsule doesn't touch
+		const float reach = radius + cellSize * 0.7072f;
+		forEachCell(glm::min(p1, p2) - radius, glm::max(p1, p2) + radius, [&](int x, int y) {
+			const glm::vec2 center = (glm::vec2(x, y) + 0.5f) * cellSize;
+			if (distance(center, p1, p2) <= reach) {
+				cells[key(x, y)].push_back(item);
+			}
+		});
+	}
+
+	void remove(const T& value, const glm::vec2& p1, const glm::vec2& p2, float radius) {
+		forEachCell(glm::min(p1, p2) - radius, glm::max(p1, p2) + radius, [&](int x, int y) {
+			auto found = cells.find(key(x, y));
+			if (found == cells.end()) {
+				return;
+			}
+			auto& items = found->second;
+			items.erase(std::remove_if(items.begin(), items.end(), [&](const Item& item) {
+				return item.value == value;
+			}), items.end());
+			if (items.empty()) {
+				cells.erase(found);
+			}
+		});
+	}
+
+	void clear() {
+		cells.clear();
+	}
+
+	bool empty() const {
+		return cells.empty();
+	}
+
+	// Calls fn(value) for every segment closer than radius to pos
+	template<typename Fn>
+	void query(const glm::vec2& pos, float radius, Fn fn) const {
+		forEachCell(pos - radius, pos + radius, [&](int x, int y) {
+			auto found = cells.find(key(x, y));
+			if (found == cells.end()) {
+				return;
+			}
+			for (const auto& item : found->second) {
+				if (distance(pos, item.p1, item.p2) <= radius + item.radius) {
+					fn(item.value);
+				}
+			}
+		});
+	}
+
+private:
+	struct Item {
+		T value;
+		glm::vec2 p1, p2;
+		float radius;
+	};
+
+	float cellSize;
+	std::unordered_map<uint64_t, std::vector<Item>> cells;
+
+	static uint64_t key(int x, int y) {
+		return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+	}
+
+	template<typename Fn>
+	void forEachCell(const glm::vec2& from, const glm::vec2& to, Fn fn) const {
+		const int x1 = static_cast<int>(std::floor(from.x / cellSize));
+		const int y1 = static_cast<int>(std::floor(from.y / cellSize));
+		const int x2 = static_cast<int>(std::floor(to.x / cellSize));
+		const int y2 = static_cast<int>(std::floor(to.y / cellSize));
+		for (int y = y1; y <= y2; y++) {
+			for (int x = x1; x <= x2; x++) {
+				fn(x, y);
+			}
+		}
+	}
+
+	static float distance(const glm::vec2& point, const glm::vec2& p1, const glm::vec2& p2) {
+		const glm::vec2 dir = p2 - p1;
+		const float length2 = glm::dot(dir, dir);
+		const float t = length2 > 0.f ? glm::clamp(glm::dot(point - p1, dir) / length2, 0.f, 1.f) : 0.f;
+		return glm::length(point - (p1 + t * dir));
+	}
+};
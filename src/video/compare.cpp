@@ -0,0 +1,122 @@
+#include "compare.h"
+#include "util/metrics.h"
+
+namespace video {
+
+    CompareMetrics::~CompareMetrics() {
+        stop();
+    }
+    void CompareMetrics::start() {
+        {
+            auto lock = std::lock_guard(mtx);
+            if (!stopped) {
+                return;
+            }
+            stopped = false;
+        }
+        t = std::thread([this]() {
+            work();
+        });
+    }
+    void CompareMetrics::stop() {
+        {
+            auto lock = std::lock_guard(mtx);
+            stopped = true;
+        }
+        cv.notify_one();
+        if (t.joinable()) {
+            t.join();
+        }
+
+        waiting = false;
+        pending = Pair();
+    }
+    void CompareMetrics::clear() {
+        auto lock = std::lock_guard(mtx);
+        waiting = false;
+        pending = Pair();
+        values.clear();
+        changes++;
+        epoch++;
+    }
+    bool CompareMetrics::add(const RGBFrame& first, const RGBFrame& second) {
+        // Exact whole frames of the same size only, a proxy frame would measure the proxy
+        // and a partially converted one only the crop
+        const FrameRegion whole = { 0, 0, first.width, first.height };
+        if (!first.buffer || !second.buffer || first.proxy || second.proxy ||
+            first.width != second.width || first.height != second.height || first.lineSize != second.lineSize ||
+            !(first.region == whole) || !(second.region == whole)) {
+            return false;
+        }
+
+        {
+            auto lock = std::lock_guard(mtx);
+            if (stopped) {
+                return false;
+            }
+            auto it = values.find(first.pts);
+            if (it != values.end() && it->second.secondPts == second.pts) {
+                return true;
+            }
+            pending.pts = first.pts;
+            pending.secondPts = second.pts;
+            pending.width = first.width;
+            pending.height = first.height;
+            pending.lineSize = first.lineSize;
+            pending.first = first.buffer;
+            pending.second = second.buffer;
+            pending.epoch = epoch;
+            waiting = true;
+        }
+        cv.notify_one();
+        return true;
+    }
+    bool CompareMetrics::get(int64_t pts, int64_t secondPts, Value& value) {
+        auto lock = std::lock_guard(mtx);
+        auto it = values.find(pts);
+        if (it == values.end() || it->second.secondPts != secondPts) {
+            return false;
+        }
+        value = it->second;
+        return true;
+    }
+    uint64_t CompareMetrics::version() {
+        auto lock = std::lock_guard(mtx);
+        return changes;
+    }
+    std::vector<std::pair<int64_t, CompareMetrics::Value>> CompareMetrics::list() {
+        auto lock = std::lock_guard(mtx);
+        return { values.begin(), values.end() };
+    }
+    void CompareMetrics::work() {
+        while (true) {
+            Pair pair;
+            {
+                auto lock = std::unique_lock(mtx);
+                cv.wait(lock, [this]() {
+                    return stopped || waiting;
+                });
+                if (stopped) {
+                    break;
+                }
+                pair = std::move(pending);
+                pending = Pair();
+                waiting = false;
+            }
+
+            const uint8_t* first = pair.first->data;
+            const uint8_t* second = pair.second->data;
+            Value value;
+            value.psnr = static_cast<float>(metrics::psnr(metrics::mse(first, second, pair.width, pair.height, pair.lineSize)));
+            value.ssim = static_cast<float>(metrics::ssim(first, second, pair.width, pair.height, pair.lineSize));
+            value.secondPts = pair.secondPts;
+
+            auto lock = std::lock_guard(mtx);
+            if (pair.epoch == epoch) {
+                values[pair.pts] = value;
+                changes++;
+            }
+        }
+    }
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "frame.h"
+
+namespace video {
+
+    /*
+        PSNR and SSIM of the frames shown side by side, computed on a worker thread.
+        A pair shares pixel buffers with the shown frames, so nothing is copied
+        and the buffers stay unchanged until the pair is measured.
+        Only the latest pair waits, older ones are replaced while the worker is busy.
+        Values are kept by pts of the first frame together with the second frame they were
+        measured against, a value of another pair is measured again. Only whole frames are measured,
+        a frame converted partially for the zoomed view waits until it is read whole
+    */
+    class CompareMetrics {
+    public:
+        struct Value {
+            float psnr = 0.f;   // dB
+            float ssim = 0.f;
+            int64_t secondPts = -1;
+        };
+
+    private:
+        struct Pair {
+            int64_t pts = -1;
+            int64_t secondPts = -1;
+            int32_t width = 0;
+            int32_t height = 0;
+            int32_t lineSize = 0;
+            std::shared_ptr<PixelBuffer> first;
+            std::shared_ptr<PixelBuffer> second;
+            uint64_t epoch = 0;
+        };
+
+        std::thread t;
+        std::mutex mtx;
+        std::condition_variable cv;
+        bool stopped = true;
+        bool waiting = false;
+        Pair pending;
+        std::map<int64_t, Value> values;
+        uint64_t changes = 0;
+        uint64_t epoch = 0;     // pairs measured before clear() are dropped
+
+        void work();
+
+    public:
+        CompareMetrics() = default;
+        ~CompareMetrics();
+        void start();
+        void stop();
+        void clear();
+        bool add(const RGBFrame& first, const RGBFrame& second);
+        bool get(int64_t pts, int64_t secondPts, Value& value);
+        uint64_t version();
+        std::vector<std::pair<int64_t, Value>> list();
+    };
+
+}
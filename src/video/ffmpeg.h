@@ -5,6 +5,8 @@ extern "C" {
 	#include <libavformat/avformat.h>
 	#include <libswscale/swscale.h>
 	#include <libavutil/imgutils.h>
+	#include <libavutil/motion_vector.h>
+	#include <libavutil/pixdesc.h>
 	//#include <libavfilter/avfilter.h>
 	//#include <libavutil/avutil.h>
 	//#include <libavcodec/packet.h>
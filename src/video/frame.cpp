@@ -1,3 +1,4 @@
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include "ffmpeg.h"
@@ -13,18 +14,42 @@ static size_t getAlignedSize(int32_t lineSize, int32_t lineCount) {
     return static_cast<size_t>(lineSize) * lineCount + tail;
 }
 
-RGBFrame::RGBFrame(int32_t width, int32_t height) :
-    width(width),
-    height(height) {
-    lineSize = av_image_get_linesize(AV_PIX_FMT_RGB24, width, 0);
-    auto aligned = getAlignedSize(lineSize, height);
-    pixels = new uint8_t[aligned];
+const MotionVectors::Layout MotionVectors::layout = {
+    sizeof(AVMotionVector),
+    offsetof(AVMotionVector, source),
+    offsetof(AVMotionVector, dst_x),
+    offsetof(AVMotionVector, motion_x),
+    offsetof(AVMotionVector, motion_scale)
+};
+
+PixelBuffer::PixelBuffer(size_t size) :
+    data(new uint8_t[size]),
+    size(size) { }
+PixelBuffer::~PixelBuffer() {
+    delete[] data;
 }
 
-RGBFrame::~RGBFrame() {
-    delete[] pixels;
+RGBFrame::RGBFrame(int32_t width, int32_t height, std::shared_ptr<PixelBuffer> buffer) :
+    width(width),
+    height(height),
+    region{ 0, 0, width, height } {
+    lineSize = av_image_get_linesize(AV_PIX_FMT_RGB24, width, 0);
+    setBuffer(buffer ? std::move(buffer) : std::make_shared<PixelBuffer>(bufferSize()));
 }
 
 bool RGBFrame::checkSize(int w, int h) const {
     return w == width && h == height;
 }
+
+size_t RGBFrame::bufferSize() const {
+    return getAlignedSize(lineSize, height);
+}
+
+size_t RGBFrame::contentSize() const {
+    return static_cast<size_t>(lineSize) * height;
+}
+
+void RGBFrame::setBuffer(std::shared_ptr<PixelBuffer> value) {
+    buffer = std::move(value);
+    pixels = buffer ? buffer->data : nullptr;
+}
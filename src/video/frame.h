@@ -1,14 +1,101 @@
 #pragma once
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace scopes {
+    struct Counts;  // forward
+}
+
+/*
+    Rectangle of frame pixels [x, x + width) x [y, y + height), rows go top-down
+*/
+struct FrameRegion {
+    int32_t x = 0;
+    int32_t y = 0;
+    int32_t width = 0;
+    int32_t height = 0;
+
+    bool empty() const {
+        return width <= 0 || height <= 0;
+    }
+    bool contains(const FrameRegion& other) const {
+        return other.empty() || (
+            x <= other.x && other.x + other.width <= x + width &&
+            y <= other.y && other.y + other.height <= y + height);
+    }
+    FrameRegion intersect(const FrameRegion& other) const {
+        int32_t x0 = std::max(x, other.x);
+        int32_t y0 = std::max(y, other.y);
+        int32_t x1 = std::min(x + width, other.x + other.width);
+        int32_t y1 = std::min(y + height, other.y + other.height);
+        return { x0, y0, std::max(0, x1 - x0), std::max(0, y1 - y0) };
+    }
+    friend bool operator==(const FrameRegion& left, const FrameRegion& right) {
+        return
+            left.x == right.x && left.y == right.y &&
+            left.width == right.width && left.height == right.height;
+    }
+};
+
+/*
+    Pixels of a converted frame.
+    Frames with identical content share one buffer, 'hash' is its key in FramePool
+*/
+struct PixelBuffer {
+    uint8_t* data = nullptr;
+    size_t size = 0;
+    uint64_t hash = 0;
+    bool indexed = false;
+
+    explicit PixelBuffer(size_t size);
+    PixelBuffer(const PixelBuffer&) = delete;
+    PixelBuffer& operator=(const PixelBuffer&) = delete;
+    ~PixelBuffer();
+};
+
+/*
+    Motion vectors the decoder exported for a frame, an array of AVMotionVector.
+    'data' references the side data buffer of the decoded frame, nothing is copied,
+    and the renderer reads the array as is through 'layout'
+*/
+struct MotionVectors {
+    struct Layout {
+        size_t stride = 0;      // sizeof(AVMotionVector)
+        size_t source = 0;      // int32_t, < 0 for a past reference, > 0 for a future one
+        size_t target = 0;      // int16_t x2, block center in this frame
+        size_t motion = 0;      // int32_t x2, target - source in 1 / 'motionScale' pixels
+        size_t motionScale = 0; // uint16_t
+    };
+    static const Layout layout;
+
+    std::shared_ptr<const uint8_t> data;
+    size_t count = 0;
+
+    bool empty() const {
+        return !data || count == 0;
+    }
+};
 
 struct RGBFrame {
     int32_t width = 0;
     int32_t height = 0;
     int32_t lineSize = 0;
-    uint8_t* pixels = nullptr;
+    uint8_t* pixels = nullptr;              // data of 'buffer'
+    std::shared_ptr<PixelBuffer> buffer;
     int64_t pts = -1;
     int64_t dur = 0;
+    FrameRegion region;     // part of pixels converted from the source frame
+    int64_t basePts = -1;   // frame 'dirtyBlocks' are compared with, -1 if not compared
+    std::vector<uint8_t> dirtyBlocks;   // BlockDiff mask, 1 for blocks changed since 'basePts'
+    bool proxy = false;     // scaled up from the proxy file, not the exact source frame
+    MotionVectors motion;   // exported by the decoder when it is opened with them
+    std::shared_ptr<const scopes::Counts> levels;  // scopes of the source planes when they are measured
 
-    RGBFrame(int32_t width, int32_t heigth);
-    ~RGBFrame();
+    RGBFrame(int32_t width, int32_t heigth, std::shared_ptr<PixelBuffer> buffer = nullptr);
     bool checkSize(int w, int h) const;
-};
\ No newline at end of file
+    size_t bufferSize() const;
+    size_t contentSize() const;
+    void setBuffer(std::shared_ptr<PixelBuffer> value);
+};
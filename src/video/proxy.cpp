@@ -0,0 +1,303 @@
+#include <iostream>
+#include <cstdio>
+#include <algorithm>
+#include "ffmpeg.h"
+#include "proxy.h"
+#include "resources.h"
+#include "util/fs.h"
+#include "util/hash.h"
+
+/*
+    Contexts of one transcoding pass, released on any exit path
+*/
+struct ProxyTranscoder {
+    AVFormatContext* input = nullptr;
+    AVFormatContext* output = nullptr;
+    AVCodecContext* decoder = nullptr;
+    AVCodecContext* encoder = nullptr;
+    SwsContext* swsContext = nullptr;
+    AVPacket* packet = nullptr;
+    AVPacket* encoded = nullptr;
+    AVFrame* frame = nullptr;
+    AVFrame* scaled = nullptr;
+    AVStream* outputStream = nullptr;
+    int streamIndex = -1;
+    bool opened = false;    // output file
+
+    ~ProxyTranscoder() {
+        if (output) {
+            if (opened) {
+                avio_closep(&output->pb);
+            }
+            avformat_free_context(output);
+        }
+        if (input) {
+            avformat_close_input(&input);
+        }
+        avcodec_free_context(&decoder);
+        avcodec_free_context(&encoder);
+        sws_freeContext(swsContext);
+        av_packet_free(&packet);
+        av_packet_free(&encoded);
+        av_frame_free(&frame);
+        av_frame_free(&scaled);
+    }
+};
+
+static bool writePackets(ProxyTranscoder& c, const AVFrame* frame) {
+    int ret = avcodec_send_frame(c.encoder, frame);
+    if (ret < 0) {
+        return false;
+    }
+
+    while (true) {
+        ret = avcodec_receive_packet(c.encoder, c.encoded);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            return true;
+        }
+        if (ret < 0) {
+            return false;
+        }
+        c.encoded->stream_index = c.outputStream->index;
+        av_packet_rescale_ts(c.encoded, c.encoder->time_base, c.outputStream->time_base);
+        if (av_interleaved_write_frame(c.output, c.encoded) < 0) {
+            return false;
+        }
+    }
+}
+
+static bool decodePackets(ProxyTranscoder& c, const AVPacket* packet) {
+    int ret = avcodec_send_packet(c.decoder, packet);
+    if (ret < 0) {
+        return false;
+    }
+
+    while (true) {
+        ret = avcodec_receive_frame(c.decoder, c.frame);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            return true;
+        }
+        if (ret < 0) {
+            return false;
+        }
+
+        // Encoder may still reference the previous picture
+        if (av_frame_make_writable(c.scaled) < 0) {
+            av_frame_unref(c.frame);
+            return false;
+        }
+        c.swsContext = sws_getCachedContext(c.swsContext,
+            c.frame->width, c.frame->height, static_cast<AVPixelFormat>(c.frame->format),
+            c.scaled->width, c.scaled->height, static_cast<AVPixelFormat>(c.scaled->format),
+            SwsFlags::SWS_BILINEAR, nullptr, nullptr, nullptr);
+        if (!c.swsContext) {
+            av_frame_unref(c.frame);
+            return false;
+        }
+        sws_scale(c.swsContext, c.frame->data, c.frame->linesize, 0, c.frame->height, c.scaled->data, c.scaled->linesize);
+
+        c.scaled->pts = c.frame->best_effort_timestamp != AV_NOPTS_VALUE ? c.frame->best_effort_timestamp : c.frame->pts;
+        c.scaled->duration = c.frame->duration;
+        av_frame_unref(c.frame);
+        if (!writePackets(c, c.scaled)) {
+            return false;
+        }
+    }
+}
+
+namespace video {
+
+    ProxyBuilder::~ProxyBuilder() {
+        stop();
+    }
+    std::string ProxyBuilder::cachePath(const std::string& source) {
+        // Name follows the file and its version, a changed file gets a new proxy
+        std::error_code error;
+        const fs::path path(source);
+        const auto absolute = fs::absolute(path, error);
+        const auto size = fs::file_size(path, error);
+        const auto time = fs::last_write_time(path, error).time_since_epoch().count();
+        const std::string key = toUTF8(absolute) + "|" + std::to_string(size) + "|" + std::to_string(time);
+
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.nut", static_cast<unsigned long long>(hash::xxh64(key.data(), key.size())));
+        return toUTF8(fs::path(resources::proxyCache) / name);
+    }
+    void ProxyBuilder::start(const std::string& source, const std::string& target) {
+        stop();
+        this->target = target;
+        std::error_code error;
+        if (fs::exists(target, error)) {
+            progress.store(1.f);
+            ready.store(true);
+            return;
+        }
+
+        stopped.store(false);
+        ready.store(false);
+        progress.store(0.f);
+        t = std::thread([this, source, target]() {
+            const std::string part = target + ".part";
+            if (build(source, part)) {
+                std::error_code error;
+                fs::rename(part, target, error);
+                ready.store(!error);
+            }
+            else {
+                std::error_code error;
+                fs::remove(part, error);
+                if (!stopped) {
+                    std::cout << "Warning: could not build proxy for " << source << std::endl;
+                }
+            }
+            stopped.store(true);
+        });
+    }
+    void ProxyBuilder::stop() {
+        stopped.store(true);
+        if (t.joinable()) {
+            t.join();
+        }
+        ready.store(false);
+    }
+    bool ProxyBuilder::isReady() const {
+        return ready;
+    }
+    bool ProxyBuilder::isRunning() const {
+        return !stopped;
+    }
+    float ProxyBuilder::getProgress() const {
+        return progress;
+    }
+    const std::string& ProxyBuilder::getTarget() const {
+        return target;
+    }
+    bool ProxyBuilder::build(const std::string& source, const std::string& target) {
+        ProxyTranscoder c;
+
+        // Source
+        if (avformat_open_input(&c.input, source.c_str(), nullptr, nullptr) < 0 ||
+            avformat_find_stream_info(c.input, nullptr) < 0) {
+            return false;
+        }
+        const AVCodec* decoder = nullptr;
+        c.streamIndex = av_find_best_stream(c.input, AVMEDIA_TYPE_VIDEO, -1, -1, &decoder, 0);
+        if (c.streamIndex < 0) {
+            return false;
+        }
+        const AVStream* inputStream = c.input->streams[c.streamIndex];
+        c.decoder = avcodec_alloc_context3(decoder);
+        if (!c.decoder || avcodec_parameters_to_context(c.decoder, inputStream->codecpar) < 0) {
+            return false;
+        }
+        c.decoder->thread_count = 0;
+        if (avcodec_open2(c.decoder, decoder, nullptr) < 0) {
+            return false;
+        }
+
+        // Proxy keeps the aspect, MJPEG wants even sizes
+        const int height = std::min(c.decoder->height, maxHeight) & ~1;
+        const int width = static_cast<int>(static_cast<int64_t>(c.decoder->width) * height / std::max(c.decoder->height, 1)) & ~1;
+        if (width <= 0 || height <= 0) {
+            return false;
+        }
+
+        const AVCodec* encoder = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+        c.encoder = encoder ? avcodec_alloc_context3(encoder) : nullptr;
+        if (!c.encoder) {
+            return false;
+        }
+        c.encoder->width = width;
+        c.encoder->height = height;
+        c.encoder->pix_fmt = AV_PIX_FMT_YUVJ420P;
+        c.encoder->time_base = inputStream->time_base;
+        c.encoder->framerate = av_guess_frame_rate(c.input, const_cast<AVStream*>(inputStream), nullptr);
+        c.encoder->flags |= AV_CODEC_FLAG_QSCALE;
+        c.encoder->global_quality = FF_QP2LAMBDA * 4;
+        c.encoder->thread_count = 0;
+
+        // NUT stores any time base, so proxy pts match the source pts exactly
+        if (avformat_alloc_output_context2(&c.output, nullptr, "nut", target.c_str()) < 0) {
+            return false;
+        }
+        if (c.output->oformat->flags & AVFMT_GLOBALHEADER) {
+            c.encoder->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        }
+        if (avcodec_open2(c.encoder, encoder, nullptr) < 0) {
+            return false;
+        }
+        c.outputStream = avformat_new_stream(c.output, nullptr);
+        if (!c.outputStream || avcodec_parameters_from_context(c.outputStream->codecpar, c.encoder) < 0) {
+            return false;
+        }
+        c.outputStream->time_base = inputStream->time_base;
+
+        std::error_code error;
+        fs::create_directories(resources::proxyCache, error);
+        if (avio_open(&c.output->pb, target.c_str(), AVIO_FLAG_WRITE) < 0) {
+            return false;
+        }
+        c.opened = true;
+        if (avformat_write_header(c.output, nullptr) < 0) {
+            return false;
+        }
+        if (av_cmp_q(c.outputStream->time_base, inputStream->time_base) != 0) {
+            std::cout << "Warning: proxy container changed the time base" << std::endl;
+            return false;
+        }
+
+        c.packet = av_packet_alloc();
+        c.encoded = av_packet_alloc();
+        c.frame = av_frame_alloc();
+        c.scaled = av_frame_alloc();
+        if (!c.packet || !c.encoded || !c.frame || !c.scaled) {
+            return false;
+        }
+        c.scaled->width = width;
+        c.scaled->height = height;
+        c.scaled->format = AV_PIX_FMT_YUVJ420P;
+        if (av_frame_get_buffer(c.scaled, 0) < 0) {
+            return false;
+        }
+
+        // Every source frame, until the end or until the builder is stopped
+        const int64_t startPts = inputStream->start_time != AV_NOPTS_VALUE ? inputStream->start_time : 0;
+        const int64_t durationPts = std::max<int64_t>(inputStream->duration, 1);
+        while (!stopped) {
+            int ret = av_read_frame(c.input, c.packet);
+            if (ret == AVERROR_EOF) {
+                break;
+            }
+            if (ret < 0) {
+                return false;
+            }
+            if (c.packet->stream_index != c.streamIndex) {
+                av_packet_unref(c.packet);
+                continue;
+            }
+
+            if (c.packet->pts != AV_NOPTS_VALUE) {
+                progress.store(std::clamp(static_cast<float>(c.packet->pts - startPts) / durationPts, 0.f, 1.f));
+            }
+            const bool ok = decodePackets(c, c.packet);
+            av_packet_unref(c.packet);
+            if (!ok) {
+                return false;
+            }
+        }
+        if (stopped) {
+            return false;
+        }
+
+        // Frames buffered by the decoder and encoder
+        if (!decodePackets(c, nullptr) || !writePackets(c, nullptr)) {
+            return false;
+        }
+        if (av_write_trailer(c.output) < 0) {
+            return false;
+        }
+        progress.store(1.f);
+        return true;
+    }
+
+}
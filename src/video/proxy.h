@@ -0,0 +1,40 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include <thread>
+
+namespace video {
+
+    /*
+        Builds a low resolution all-intra (MJPEG) copy of a video in background.
+        Proxy keeps time base and pts of the source stream, so its frames stand in
+        for the source frames while the user scrubs or steps back.
+        File is written next to its final name and renamed when complete
+    */
+    class ProxyBuilder {
+    public:
+        static constexpr int maxHeight = 540;
+
+    private:
+        std::thread t;
+        std::atomic<bool> stopped = true;
+        std::atomic<bool> ready = false;
+        std::atomic<float> progress = 0.f;
+        std::string target;
+
+        bool build(const std::string& source, const std::string& target);
+
+    public:
+        ProxyBuilder() = default;
+        ~ProxyBuilder();
+
+        static std::string cachePath(const std::string& source);
+        void start(const std::string& source, const std::string& target);
+        void stop();
+        bool isReady() const;
+        bool isRunning() const;
+        float getProgress() const;
+        const std::string& getTarget() const;
+    };
+
+}
@@ -0,0 +1,327 @@
+#include <iostream>
+#include <algorithm>
+#include "ffmpeg.h"
+#include "scenes.h"
+#include "util/scenecut.h"
+
+/*
+    Contexts of one detection pass, released on any exit path
+*/
+struct SceneScanner {
+    AVFormatContext* input = nullptr;
+    AVCodecContext* decoder = nullptr;
+    SwsContext* swsContext = nullptr;
+    AVPacket* packet = nullptr;
+    AVFrame* frame = nullptr;
+    AVFrame* small = nullptr;   // frames of other formats are scaled down to 8-bit 4:2:0
+    int streamIndex = -1;
+
+    ~SceneScanner() {
+        if (input) {
+            avformat_close_input(&input);
+        }
+        avcodec_free_context(&decoder);
+        sws_freeContext(swsContext);
+        av_packet_free(&packet);
+        av_frame_free(&frame);
+        av_frame_free(&small);
+    }
+};
+
+static constexpr int smallWidth = 320;
+static constexpr int smallHeight = 180;
+static constexpr float candidateDifference = 0.2f;  // of neighbour keyframes, their GOP is decoded first
+static constexpr float keyframeShare = 0.1f;        // of the progress
+
+static int64_t framePts(const AVFrame* frame) {
+    return frame->best_effort_timestamp != AV_NOPTS_VALUE ? frame->best_effort_timestamp : frame->pts;
+}
+
+static bool extractFeatures(SceneScanner& c, const AVFrame* frame, scenecut::Features& out) {
+    // 8-bit planar YUV is read in place, only the sampled rows
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+    const bool native = desc && desc->nb_components >= 3 &&
+        (desc->flags & AV_PIX_FMT_FLAG_PLANAR) && !(desc->flags & AV_PIX_FMT_FLAG_RGB) &&
+        desc->comp[0].depth == 8 && desc->comp[1].plane == 1 && desc->comp[2].plane == 2;
+    if (native) {
+        const uint8_t* planes[3] = { frame->data[0], frame->data[1], frame->data[2] };
+        scenecut::extract(planes, frame->linesize, frame->width, frame->height, desc->log2_chroma_w, desc->log2_chroma_h, out);
+        return true;
+    }
+
+    c.swsContext = sws_getCachedContext(c.swsContext,
+        frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
+        c.small->width, c.small->height, static_cast<AVPixelFormat>(c.small->format),
+        SwsFlags::SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
+    if (!c.swsContext) {
+        return false;
+    }
+    sws_scale(c.swsContext, frame->data, frame->linesize, 0, frame->height, c.small->data, c.small->linesize);
+    const uint8_t* planes[3] = { c.small->data[0], c.small->data[1], c.small->data[2] };
+    scenecut::extract(planes, c.small->linesize, c.small->width, c.small->height, 1, 1, out);
+    return true;
+}
+
+// Damaged packets are skipped, detection goes on with the next ones
+template<typename OnFrame>
+static void decodePacket(SceneScanner& c, const AVPacket* packet, OnFrame&& onFrame) {
+    if (avcodec_send_packet(c.decoder, packet) < 0) {
+        return;
+    }
+    while (avcodec_receive_frame(c.decoder, c.frame) >= 0) {
+        onFrame(c.frame);
+        av_frame_unref(c.frame);
+    }
+}
+
+// Frames of [from, to] by pts, 'found' gets cuts within (from, to]
+static bool scanGop(SceneScanner& c, int64_t from, int64_t to, const std::atomic<bool>& stopped, std::vector<int64_t>& found) {
+    avcodec_flush_buffers(c.decoder);
+    if (av_seek_frame(c.input, c.streamIndex, from, AVSEEK_FLAG_BACKWARD) < 0) {
+        return false;
+    }
+
+    scenecut::Features previous, current;
+    scenecut::Detector detector;
+    bool finished = false;
+    auto onFrame = [&](const AVFrame* frame) {
+        const int64_t pts = framePts(frame);
+        if (finished || pts == AV_NOPTS_VALUE || pts < from) {
+            return; // leading frames of an open GOP
+        }
+        if (pts > to) {
+            finished = true;
+            return;
+        }
+        if (!extractFeatures(c, frame, current)) {
+            return;
+        }
+        if (previous.valid && detector.push(scenecut::difference(previous, current))) {
+            found.push_back(pts);
+        }
+        std::swap(previous, current);
+        finished = pts == to;
+    };
+
+    while (!finished && !stopped) {
+        int ret = av_read_frame(c.input, c.packet);
+        if (ret == AVERROR_EOF) {
+            decodePacket(c, nullptr, onFrame);
+            break;
+        }
+        if (ret < 0) {
+            return false;
+        }
+        if (c.packet->stream_index == c.streamIndex) {
+            decodePacket(c, c.packet, onFrame);
+        }
+        av_packet_unref(c.packet);
+    }
+    return !stopped;
+}
+
+namespace video {
+
+    SceneDetector::~SceneDetector() {
+        stop();
+    }
+    void SceneDetector::start(const std::string& source) {
+        stop();
+        {
+            auto lock = std::lock_guard(mtx);
+            cuts.clear();
+            changes++;
+        }
+
+        stopped.store(false);
+        progress.store(0.f);
+        t = std::thread([this, source]() {
+            if (!scan(source) && !stopped) {
+                std::cout << "Warning: could not detect scene cuts of " << source << std::endl;
+            }
+            stopped.store(true);
+        });
+    }
+    void SceneDetector::stop() {
+        stopped.store(true);
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+    bool SceneDetector::isRunning() const {
+        return !stopped;
+    }
+    float SceneDetector::getProgress() const {
+        return progress;
+    }
+    uint64_t SceneDetector::version() const {
+        auto lock = std::lock_guard(mtx);
+        return changes;
+    }
+    std::vector<int64_t> SceneDetector::list() const {
+        auto lock = std::lock_guard(mtx);
+        std::vector<int64_t> result;
+        result.reserve(cuts.size());
+        for (const auto& [pts, exact] : cuts) {
+            result.push_back(pts);
+        }
+        return result;
+    }
+    int64_t SceneDetector::next(int64_t pts) const {
+        auto lock = std::lock_guard(mtx);
+        auto it = cuts.upper_bound(pts);
+        return it != cuts.end() ? it->first : -1;
+    }
+    int64_t SceneDetector::prev(int64_t pts) const {
+        auto lock = std::lock_guard(mtx);
+        auto it = cuts.lower_bound(pts);
+        return it != cuts.begin() ? std::prev(it)->first : -1;
+    }
+    void SceneDetector::addCut(int64_t pts) {
+        auto lock = std::lock_guard(mtx);
+        cuts.emplace(pts, false);
+        changes++;
+    }
+    void SceneDetector::replaceCuts(int64_t from, int64_t to, const std::vector<int64_t>& found) {
+        auto lock = std::lock_guard(mtx);
+        cuts.erase(cuts.upper_bound(from), cuts.upper_bound(to));
+        for (auto pts : found) {
+            cuts[pts] = true;
+        }
+        changes++;
+    }
+    bool SceneDetector::scan(const std::string& source) {
+        SceneScanner c;
+
+        if (avformat_open_input(&c.input, source.c_str(), nullptr, nullptr) < 0 ||
+            avformat_find_stream_info(c.input, nullptr) < 0) {
+            return false;
+        }
+        const AVCodec* decoder = nullptr;
+        c.streamIndex = av_find_best_stream(c.input, AVMEDIA_TYPE_VIDEO, -1, -1, &decoder, 0);
+        if (c.streamIndex < 0) {
+            return false;
+        }
+        const AVStream* stream = c.input->streams[c.streamIndex];
+        c.decoder = avcodec_alloc_context3(decoder);
+        if (!c.decoder || avcodec_parameters_to_context(c.decoder, stream->codecpar) < 0) {
+            return false;
+        }
+        c.decoder->thread_count = 0;
+        c.decoder->skip_loop_filter = AVDISCARD_ALL;
+        if (avcodec_open2(c.decoder, decoder, nullptr) < 0) {
+            return false;
+        }
+
+        c.packet = av_packet_alloc();
+        c.frame = av_frame_alloc();
+        c.small = av_frame_alloc();
+        if (!c.packet || !c.frame || !c.small) {
+            return false;
+        }
+        c.small->width = smallWidth;
+        c.small->height = smallHeight;
+        c.small->format = AV_PIX_FMT_YUV420P;
+        if (av_frame_get_buffer(c.small, 0) < 0) {
+            return false;
+        }
+
+        // Keyframes only, packets of other frames aren't even passed to the decoder
+        struct Key {
+            int64_t pts;
+            bool changed;   // differs much from the previous keyframe
+            bool cut;       // detector decision on keyframes alone
+        };
+        std::vector<Key> keys;
+        scenecut::Features previous, current;
+        scenecut::Detector detector;
+        auto onKey = [&](const AVFrame* frame) {
+            const int64_t pts = framePts(frame);
+            if (pts == AV_NOPTS_VALUE || !extractFeatures(c, frame, current)) {
+                return;
+            }
+            const float difference = previous.valid ? scenecut::difference(previous, current) : 0.f;
+            const bool cut = previous.valid && detector.push(difference);
+            keys.push_back({ pts, difference >= candidateDifference, cut });
+            if (difference >= candidateDifference) {
+                addCut(pts);
+            }
+            std::swap(previous, current);
+        };
+
+        const int64_t startPts = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+        const int64_t durationPts = std::max<int64_t>(stream->duration, 1);
+        int64_t packets = 0;
+        int64_t keyPackets = 0;
+        c.decoder->skip_frame = AVDISCARD_NONKEY;
+        while (!stopped) {
+            int ret = av_read_frame(c.input, c.packet);
+            if (ret == AVERROR_EOF) {
+                break;
+            }
+            if (ret < 0) {
+                return false;
+            }
+            if (c.packet->stream_index == c.streamIndex) {
+                packets++;
+                if (c.packet->flags & AV_PKT_FLAG_KEY) {
+                    keyPackets++;
+                    if (c.packet->pts != AV_NOPTS_VALUE) {
+                        progress.store(keyframeShare * std::clamp(static_cast<float>(c.packet->pts - startPts) / durationPts, 0.f, 1.f));
+                    }
+                    decodePacket(c, c.packet, onKey);
+                }
+            }
+            av_packet_unref(c.packet);
+        }
+        if (stopped) {
+            return false;
+        }
+        decodePacket(c, nullptr, onKey);
+
+        // Every frame is a keyframe, there is nothing more to decode
+        if (keyPackets == packets) {
+            std::vector<int64_t> found;
+            for (const auto& key : keys) {
+                if (key.cut) {
+                    found.push_back(key.pts);
+                }
+            }
+            replaceCuts(INT64_MIN, INT64_MAX, found);
+            progress.store(1.f);
+            return true;
+        }
+
+        // GOPs ending with a changed keyframe go first, the last GOP ends with the file
+        std::sort(keys.begin(), keys.end(), [](const Key& left, const Key& right) {
+            return left.pts < right.pts;
+        });
+        std::vector<size_t> order;
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (i + 1 < keys.size() && keys[i + 1].changed) {
+                order.push_back(i);
+            }
+        }
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (i + 1 == keys.size() || !keys[i + 1].changed) {
+                order.push_back(i);
+            }
+        }
+
+        c.decoder->skip_frame = AVDISCARD_DEFAULT;
+        for (size_t done = 0; done < order.size(); done++) {
+            const size_t i = order[done];
+            const int64_t from = keys[i].pts;
+            const int64_t to = i + 1 < keys.size() ? keys[i + 1].pts : INT64_MAX;
+            std::vector<int64_t> found;
+            if (!scanGop(c, from, to, stopped, found)) {
+                return false;
+            }
+            replaceCuts(from, to, found);
+            progress.store(keyframeShare + (1.f - keyframeShare) * (done + 1) / order.size());
+        }
+        progress.store(1.f);
+        return true;
+    }
+
+}
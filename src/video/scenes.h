@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace video {
+
+    /*
+        Finds scene cuts of a video in background, on its own demuxer and decoder.
+        Keyframes are decoded first: keyframes which differ much from the previous one
+        give approximate cuts at once, and their GOPs are decoded frame by frame
+        before the others to place the cuts exactly.
+        Frames are compared on sampled rows of their planes, and the decoder
+        skips the loop filter, detection doesn't need clean pictures
+    */
+    class SceneDetector {
+    private:
+        std::thread t;
+        std::atomic<bool> stopped = true;
+        std::atomic<float> progress = 0.f;
+        mutable std::mutex mtx;
+        std::map<int64_t, bool> cuts;   // pts, true when placed exactly
+        uint64_t changes = 0;
+
+        bool scan(const std::string& source);
+        void addCut(int64_t pts);
+        void replaceCuts(int64_t from, int64_t to, const std::vector<int64_t>& found);
+
+    public:
+        SceneDetector() = default;
+        ~SceneDetector();
+
+        void start(const std::string& source);
+        void stop();
+        bool isRunning() const;
+        float getProgress() const;
+        uint64_t version() const;
+        std::vector<int64_t> list() const;
+        int64_t next(int64_t pts) const;    // -1 if there is no cut after 'pts'
+        int64_t prev(int64_t pts) const;    // -1 if there is no cut before 'pts'
+    };
+
+}
@@ -0,0 +1,174 @@
+#include <iostream>
+#include <algorithm>
+#include "ffmpeg.h"
+#include "timeline.h"
+
+/*
+    Contexts of one demuxing pass, released on any exit path
+*/
+struct PacketReader {
+    AVFormatContext* input = nullptr;
+    AVCodecContext* codec = nullptr;        // parameters for the parser, never opened
+    AVCodecParserContext* parser = nullptr;
+    AVPacket* packet = nullptr;
+
+    ~PacketReader() {
+        if (input) {
+            avformat_close_input(&input);
+        }
+        if (parser) {
+            av_parser_close(parser);
+        }
+        avcodec_free_context(&codec);
+        av_packet_free(&packet);
+    }
+};
+
+static bool byPts(const video::PacketTimeline::Entry& left, const video::PacketTimeline::Entry& right) {
+    return left.pts < right.pts;
+}
+
+namespace video {
+
+    PacketTimeline::~PacketTimeline() {
+        stop();
+    }
+    void PacketTimeline::start(const std::string& source) {
+        stop();
+        {
+            auto lock = std::lock_guard(mtx);
+            entries.clear();
+            complete = false;
+            changes++;
+        }
+
+        stopped.store(false);
+        progress.store(0.f);
+        t = std::thread([this, source]() {
+            if (!scan(source) && !stopped) {
+                std::cout << "Warning: could not read packets of " << source << std::endl;
+            }
+            stopped.store(true);
+        });
+    }
+    void PacketTimeline::stop() {
+        stopped.store(true);
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+    bool PacketTimeline::isRunning() const {
+        return !stopped;
+    }
+    float PacketTimeline::getProgress() const {
+        return progress;
+    }
+    uint64_t PacketTimeline::version() const {
+        auto lock = std::lock_guard(mtx);
+        return changes;
+    }
+    std::vector<PacketTimeline::Entry> PacketTimeline::list() const {
+        std::vector<Entry> result;
+        bool sorted = false;
+        {
+            auto lock = std::lock_guard(mtx);
+            result = entries;
+            sorted = complete;
+        }
+        // B-frames come after the frames they refer to, pts order differs from decoding order
+        if (!sorted) {
+            std::sort(result.begin(), result.end(), byPts);
+        }
+        return result;
+    }
+    void PacketTimeline::publish(std::vector<Entry>& batch, bool finished) {
+        auto lock = std::lock_guard(mtx);
+        entries.insert(entries.end(), batch.begin(), batch.end());
+        if (finished) {
+            std::sort(entries.begin(), entries.end(), byPts);
+            complete = true;
+        }
+        changes++;
+        batch.clear();
+    }
+    bool PacketTimeline::scan(const std::string& source) {
+        PacketReader c;
+
+        if (avformat_open_input(&c.input, source.c_str(), nullptr, nullptr) < 0 ||
+            avformat_find_stream_info(c.input, nullptr) < 0) {
+            return false;
+        }
+        const int streamIndex = av_find_best_stream(c.input, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+        if (streamIndex < 0) {
+            return false;
+        }
+        // Other streams are not even read from the file when the demuxer can skip them
+        for (unsigned i = 0; i < c.input->nb_streams; i++) {
+            c.input->streams[i]->discard = static_cast<int>(i) == streamIndex ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+        }
+        const AVStream* stream = c.input->streams[streamIndex];
+
+        // Parser reads headers of the whole packets, its output is not used
+        c.codec = avcodec_alloc_context3(nullptr);
+        if (!c.codec || avcodec_parameters_to_context(c.codec, stream->codecpar) < 0) {
+            return false;
+        }
+        c.parser = av_parser_init(stream->codecpar->codec_id);
+        if (c.parser) {
+            c.parser->flags |= PARSER_FLAG_COMPLETE_FRAMES;
+        }
+        c.packet = av_packet_alloc();
+        if (!c.packet) {
+            return false;
+        }
+
+        const int64_t startPts = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+        const int64_t durationPts = std::max<int64_t>(stream->duration, 1);
+        std::vector<Entry> batch;
+        batch.reserve(batchSize);
+        while (!stopped) {
+            int ret = av_read_frame(c.input, c.packet);
+            if (ret == AVERROR_EOF) {
+                break;
+            }
+            if (ret < 0) {
+                return false;
+            }
+            if (c.packet->stream_index != streamIndex || (c.packet->flags & AV_PKT_FLAG_DISCARD)) {
+                av_packet_unref(c.packet);
+                continue;
+            }
+
+            Entry entry;
+            entry.pts = c.packet->pts != AV_NOPTS_VALUE ? c.packet->pts : c.packet->dts;
+            entry.size = c.packet->size;
+            entry.type = (c.packet->flags & AV_PKT_FLAG_KEY) ? 'I' : '?';
+            if (c.parser) {
+                uint8_t* data = nullptr;
+                int size = 0;
+                av_parser_parse2(c.parser, c.codec, &data, &size, c.packet->data, c.packet->size, c.packet->pts, c.packet->dts, c.packet->pos);
+                const char types[] = { '?', 'I', 'P', 'B' };    // AVPictureType up to AV_PICTURE_TYPE_B
+                if (c.parser->pict_type >= AV_PICTURE_TYPE_I && c.parser->pict_type <= AV_PICTURE_TYPE_B) {
+                    entry.type = types[c.parser->pict_type];
+                }
+            }
+            av_packet_unref(c.packet);
+            if (entry.pts == AV_NOPTS_VALUE) {
+                continue;
+            }
+
+            batch.push_back(entry);
+            if (batch.size() == batchSize) {
+                progress.store(std::clamp(static_cast<float>(entry.pts - startPts) / durationPts, 0.f, 1.f));
+                publish(batch, false);
+            }
+        }
+        if (stopped) {
+            return false;
+        }
+        publish(batch, true);
+        progress.store(1.f);
+        return true;
+    }
+
+}
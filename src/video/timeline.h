@@ -0,0 +1,49 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace video {
+
+    /*
+        Packet sizes and picture types of the whole video, read in background
+        by demuxing only: packets are never decoded, the codec parser takes
+        the picture type from the slice headers. Gigabyte files take seconds
+    */
+    class PacketTimeline {
+    public:
+        struct Entry {
+            int64_t pts = 0;
+            int32_t size = 0;   // bytes
+            char type = '?';    // 'I', 'P', 'B' or '?' when the parser can't tell
+        };
+
+        static constexpr size_t batchSize = 16384;  // entries published at once while scanning
+
+    private:
+        std::thread t;
+        std::atomic<bool> stopped = true;
+        std::atomic<float> progress = 0.f;
+        mutable std::mutex mtx;
+        std::vector<Entry> entries;     // in decoding order until the scan is complete
+        bool complete = false;
+        uint64_t changes = 0;
+
+        bool scan(const std::string& source);
+        void publish(std::vector<Entry>& batch, bool finished);
+
+    public:
+        PacketTimeline() = default;
+        ~PacketTimeline();
+
+        void start(const std::string& source);
+        void stop();
+        bool isRunning() const;
+        float getProgress() const;
+        uint64_t version() const;
+        std::vector<Entry> list() const;    // by pts
+    };
+
+}
@@ -1,5 +1,10 @@
 #include <iostream>
 #include <algorithm>
+#include <cstring>
+#include <unordered_set>
+#include "util/hash.h"
+#include "util/lz.h"
+#include "util/scopes.h"
 #include "video.h"
 
 
@@ -39,44 +44,307 @@ namespace video {
             item = nullptr;
         }
         items.clear();
-        items.resize(count);
-        for (size_t i = 0; i < count; i++) {
-            items[i] = new RGBFrame(w, h);
-        }
+        spare.clear();
+        contents.clear();
 
         frameWidth = w;
         frameHeight = h;
+        spareLimit = count;
+        for (size_t i = 0; i < count; i++) {
+            items.push_back(new RGBFrame(w, h));
+            spare.push_back(items.back()->buffer);
+            items.back()->setBuffer(nullptr);
+        }
+    }
+    void FramePool::release(RGBFrame* frame) {
+        frame->pts = -1;
+        frame->dur = 0;
 
+        // Exclusive buffer is kept for the next frame, shared one stays with other frames
+        if (frame->buffer && frame->buffer.use_count() == 1 && spare.size() < spareLimit) {
+            spare.push_back(frame->buffer);
+        }
+        frame->setBuffer(nullptr);
+        items.push_back(frame);
+    }
+    void FramePool::unindex(const std::shared_ptr<PixelBuffer>& buffer) {
+        if (!buffer->indexed) {
+            return;
+        }
+        auto it = contents.find(buffer->hash);
+        if (it != contents.end() && it->second.lock() == buffer) {
+            contents.erase(it);
+        }
+        buffer->indexed = false;
     }
     void FramePool::put(RGBFrame* frame) {
         if (frame) {
             auto lock = std::lock_guard(mtx);
-            frame->pts = -1;
-            frame->dur = 0;
-            items.push_back(frame);
+            release(frame);
         }
     }
     void FramePool::put(const std::vector<RGBFrame*>& frames) {
         auto lock = std::lock_guard(mtx);
         for (auto frame : frames) {
-            frame->pts = -1;
-            frame->dur = 0;
+            release(frame);
         }
-        items.insert(items.end(), frames.begin(), frames.end());
     }
     RGBFrame* FramePool::get() {
         auto lock = std::lock_guard(mtx);
 
+        std::shared_ptr<PixelBuffer> buffer;
+        while (!spare.empty() && !buffer) {
+            // Spare buffer may be taken by a frame with the same content meanwhile
+            buffer = std::move(spare.back());
+            spare.pop_back();
+            if (buffer.use_count() > 1) {
+                buffer.reset();
+            }
+        }
+        if (buffer) {
+            unindex(buffer); // content is going to be overwritten
+        }
+
         if (items.empty()) {
-            return new RGBFrame(frameWidth, frameHeight);
+            return new RGBFrame(frameWidth, frameHeight, std::move(buffer));
         }
 
         auto last = items.back();
         items.pop_back();
+        last->setBuffer(buffer ? std::move(buffer) : std::make_shared<PixelBuffer>(last->bufferSize()));
         return last;
     }
+    void FramePool::share(RGBFrame* frame, uint64_t hash) {
+        std::shared_ptr<PixelBuffer> existing;
+        {
+            auto lock = std::lock_guard(mtx);
+            auto it = contents.find(hash);
+            if (it != contents.end()) {
+                existing = it->second.lock();
+            }
+            if (!existing || existing == frame->buffer) {
+                contents[hash] = frame->buffer;
+                frame->buffer->hash = hash;
+                frame->buffer->indexed = true;
+                return;
+            }
+        }
+
+        // Existing buffer can't be rewritten while it is referenced here, so it is compared without lock
+        const size_t size = frame->contentSize();
+        if (existing->size < size || std::memcmp(existing->data, frame->pixels, size) != 0) {
+            return;
+        }
+
+        auto lock = std::lock_guard(mtx);
+        if (spare.size() < spareLimit) {
+            spare.push_back(frame->buffer);
+        }
+        frame->setBuffer(std::move(existing));
+
+        // Index keeps expired buffers until it grows
+        constexpr size_t pruneSize = 4096;
+        if (contents.size() > pruneSize) {
+            std::erase_if(contents, [](const auto& item) {
+                return item.second.expired();
+            });
+        }
+    }
 
 
+    FrameArchive::~FrameArchive() {
+        stop();
+        clear();    // data deleters touch 'bytes'
+    }
+    void FrameArchive::start() {
+        {
+            auto lock = std::lock_guard(mtx);
+            if (!stopped) {
+                return;
+            }
+            stopped = false;
+        }
+        t = std::thread([this]() {
+            work();
+        });
+    }
+    void FrameArchive::stop() {
+        {
+            auto lock = std::lock_guard(mtx);
+            stopped = true;
+        }
+        cv.notify_one();
+        if (t.joinable()) {
+            t.join();
+        }
+
+        for (auto frame : pending) {
+            pool.put(frame);
+        }
+        pending.clear();
+    }
+    void FrameArchive::clear() {
+        auto lock = std::lock_guard(mtx);
+        entries.clear();
+        order.clear();
+        contents.clear();
+    }
+    void FrameArchive::add(RGBFrame* frame) {
+        if (!frame) {
+            return;
+        }
+
+        // Part of a frame can't be shown later, busy worker shouldn't hold the pool frames
+        bool accepted = false;
+        {
+            auto lock = std::lock_guard(mtx);
+            if (!stopped && pending.size() < maxPending &&
+                frame->region == FrameRegion{ 0, 0, frame->width, frame->height } &&
+                !covers(frame)) {
+                pending.push_back(frame);
+                accepted = true;
+            }
+        }
+
+        if (accepted) {
+            cv.notify_one();
+        }
+        else {
+            pool.put(frame);
+        }
+    }
+    bool FrameArchive::restore(int64_t pts, RGBFrame& frame) {
+        Data data;
+        int64_t framePts = -1;
+        int64_t frameDur = 0;
+        bool frameProxy = false;
+        MotionVectors frameMotion;
+        {
+            auto lock = std::lock_guard(mtx);
+            auto it = entries.upper_bound(pts);
+            if (it == entries.begin()) {
+                return false;
+            }
+            --it;
+            if (pts >= it->first + it->second.dur) {
+                return false;
+            }
+            framePts = it->first;
+            frameDur = it->second.dur;
+            frameProxy = it->second.proxy;
+            frameMotion = it->second.motion;
+            data = it->second.data;
+        }
+
+        const size_t size = frame.contentSize();
+        if (!lz::decompress(data->data(), data->size(), frame.pixels, size)) {
+            std::cout << "Warning: can't restore archived frame " << framePts << std::endl;
+            return false;
+        }
+        lz::deltaDecode(frame.pixels, size, 3);
+
+        frame.pts = framePts;
+        frame.dur = frameDur;
+        frame.proxy = frameProxy;
+        frame.region = FrameRegion{ 0, 0, frame.width, frame.height };
+        frame.basePts = -1;
+        frame.dirtyBlocks.clear();
+        frame.motion = std::move(frameMotion);
+        frame.levels.reset();
+        return true;
+    }
+    void FrameArchive::work() {
+        std::vector<uint8_t> scratch;
+        std::vector<uint8_t> packed;
+
+        while (true) {
+            RGBFrame* frame = nullptr;
+            Data data;
+            uint64_t hash = 0;
+            {
+                auto lock = std::unique_lock(mtx);
+                cv.wait(lock, [this]() {
+                    return stopped || !pending.empty();
+                });
+                if (stopped) {
+                    break;
+                }
+                frame = pending.front();
+                pending.pop_front();
+
+                // Identical content is already compressed, its hash is known from FramePool
+                if (frame->buffer->indexed) {
+                    hash = frame->buffer->hash;
+                    auto it = contents.find(hash);
+                    if (it != contents.end()) {
+                        data = it->second.lock();
+                    }
+                }
+            }
+
+            if (!data) {
+                data = compress(frame, scratch, packed);
+            }
+            store(frame, hash, std::move(data));
+            pool.put(frame);
+        }
+    }
+    FrameArchive::Data FrameArchive::compress(const RGBFrame* frame, std::vector<uint8_t>& scratch, std::vector<uint8_t>& packed) {
+        // Delta against the previous pixel turns flat areas into zero runs
+        const size_t size = frame->contentSize();
+        scratch.assign(frame->pixels, frame->pixels + size);
+        lz::deltaEncode(scratch.data(), size, 3);
+
+        packed.resize(lz::bound(size));
+        packed.resize(lz::compress(scratch.data(), size, packed.data()));
+
+        // Counted until the last entry or reader drops it
+        bytes += packed.size();
+        return Data(new std::vector<uint8_t>(packed), [this](const std::vector<uint8_t>* data) {
+            bytes -= data->size();
+            delete data;
+        });
+    }
+    bool FrameArchive::covers(const RGBFrame* frame) const {
+        // Exact frame replaces the proxy one of the same pts
+        auto it = entries.find(frame->pts);
+        return it != entries.end() && (!it->second.proxy || frame->proxy);
+    }
+    void FrameArchive::store(const RGBFrame* frame, uint64_t hash, Data data) {
+        auto lock = std::lock_guard(mtx);
+        if (stopped || covers(frame)) {
+            return;
+        }
+
+        if (hash != 0) {
+            contents[hash] = data;
+        }
+        auto [it, added] = entries.insert_or_assign(frame->pts, Entry{ frame->dur, frame->proxy, std::move(data), frame->motion });
+        if (added) {
+            order.push_back(frame->pts);
+        }
+
+        while (bytes > budgetBytes && !order.empty()) {
+            evict();
+        }
+    }
+    void FrameArchive::evict() {
+        auto it = entries.find(order.front());
+        order.pop_front();
+        if (it == entries.end()) {
+            return;
+        }
+
+        entries.erase(it);
+
+        constexpr size_t pruneSize = 4096;
+        if (contents.size() > pruneSize) {
+            std::erase_if(contents, [](const auto& item) {
+                return item.second.expired();
+            });
+        }
+    }
+
     float StreamInfo::calcProgress(int64_t pts) const {
         if (durationPts == 0) {
             return 0;
@@ -103,13 +371,11 @@ namespace video {
     }
 
 
-    bool FrameConverter::createContext(const AVCodecContext* decoder) {
-        const auto& width = decoder->width;
-        const auto& height = decoder->height;
+    bool FrameConverter::createContext(const AVCodecContext* decoder, int width, int height) {
         const auto& pixFmt = decoder->pix_fmt;
 
         swsContext = sws_getContext(
-            width, height, pixFmt,
+            decoder->width, decoder->height, pixFmt,
             width, height, AV_PIX_FMT_RGB24,
             SwsFlags::SWS_BILINEAR, nullptr, nullptr, nullptr);
 
@@ -120,14 +386,86 @@ namespace video {
             sws_freeContext(swsContext);
             swsContext = nullptr;
         }
+        if (regionContext) {
+            sws_freeContext(regionContext);
+            regionContext = nullptr;
+        }
     }
-    int FrameConverter::toRGB(const AVFrame* frame, RGBFrame& result) {
+    FrameRegion FrameConverter::alignRegion(const AVFrame* frame, const FrameRegion& region) const {
+        /*
+            Region is converted by pointing source planes into the frame,
+            so it starts on chroma sample and 16-pixel boundary to keep the planes aligned.
+            Whole frame is returned when region can't be cut out
+        */
+        const FrameRegion whole = { 0, 0, frame->width, frame->height };
+        const auto desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+        constexpr uint64_t unsupported = AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL;
+        if (region.empty() || !desc || (desc->flags & unsupported)) {
+            return whole;
+        }
+
+        const int32_t alignX = std::max(16, 1 << desc->log2_chroma_w);
+        const int32_t alignY = 1 << desc->log2_chroma_h;
+        auto clipped = whole.intersect(region);
+        int32_t x0 = clipped.x / alignX * alignX;
+        int32_t y0 = clipped.y / alignY * alignY;
+        int32_t x1 = std::min(frame->width, (clipped.x + clipped.width + alignX - 1) / alignX * alignX);
+        int32_t y1 = std::min(frame->height, (clipped.y + clipped.height + alignY - 1) / alignY * alignY);
+        if (x1 <= x0 || y1 <= y0) {
+            return whole;
+        }
+        return { x0, y0, x1 - x0, y1 - y0 };
+    }
+    int FrameConverter::toRGB(const AVFrame* frame, RGBFrame& result, const FrameRegion& region) {
         
-        destFrame[0] = result.pixels;
+        // Scaled frame is converted whole
+        const FrameRegion whole = { 0, 0, result.width, result.height };
+        result.region = result.checkSize(frame->width, frame->height) ? alignRegion(frame, region) : whole;
+        if (result.region == whole) {
+            destFrame[0] = result.pixels;
+            destLineSize[0] = result.lineSize;
+
+            int ret = sws_scale(swsContext, 
+                frame->data, frame->linesize, 0, frame->height, 
+                destFrame, destLineSize
+            );
+
+            destFrame[0] = nullptr;
+            destLineSize[0] = 0;
+            return ret;
+        }
+
+        const auto& r = result.region;
+        const auto format = static_cast<AVPixelFormat>(frame->format);
+        regionContext = sws_getCachedContext(regionContext,
+            r.width, r.height, format,
+            r.width, r.height, AV_PIX_FMT_RGB24,
+            SwsFlags::SWS_BILINEAR, nullptr, nullptr, nullptr);
+        if (!regionContext) {
+            return -1;
+        }
+
+        // Every plane starts at the first sample of region, chroma planes are subsampled
+        const auto desc = av_pix_fmt_desc_get(format);
+        const uint8_t* source[AV_NUM_DATA_POINTERS] = { nullptr };
+        bool placed[AV_NUM_DATA_POINTERS] = { false };
+        for (int i = 0; i < desc->nb_components; i++) {
+            const auto& comp = desc->comp[i];
+            if (placed[comp.plane]) {
+                continue;
+            }
+            const bool chroma = (i == 1 || i == 2) && !(desc->flags & AV_PIX_FMT_FLAG_RGB);
+            const int x = chroma ? (r.x >> desc->log2_chroma_w) : r.x;
+            const int y = chroma ? (r.y >> desc->log2_chroma_h) : r.y;
+            source[comp.plane] = frame->data[comp.plane] + static_cast<ptrdiff_t>(y) * frame->linesize[comp.plane] + x * comp.step;
+            placed[comp.plane] = true;
+        }
+
+        destFrame[0] = result.pixels + static_cast<ptrdiff_t>(r.y) * result.lineSize + r.x * 3;
         destLineSize[0] = result.lineSize;
 
-        int ret = sws_scale(swsContext, 
-            frame->data, frame->linesize, 0, frame->height, 
+        int ret = sws_scale(regionContext,
+            source, frame->linesize, 0, r.height,
             destFrame, destLineSize
         );
 
@@ -137,6 +475,107 @@ namespace video {
     }
 
 
+    static int64_t getPacketKey(const AVPacket* packet) {
+        return packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+    }
+
+    PacketCache::~PacketCache() {
+        clear();
+    }
+    void PacketCache::clear() {
+        for (auto& [key, gop] : gops) {
+            for (auto& packet : gop.packets) {
+                av_packet_free(&packet);
+            }
+        }
+        gops.clear();
+        order.clear();
+        bytes = 0;
+        recordKey = AV_NOPTS_VALUE;
+    }
+    void PacketCache::erase(int64_t key) {
+        auto it = gops.find(key);
+        if (it != gops.end()) {
+            for (auto& packet : it->second.packets) {
+                bytes -= packet->size;
+                av_packet_free(&packet);
+            }
+            gops.erase(it);
+        }
+        std::erase(order, key);
+        if (recordKey == key) {
+            recordKey = AV_NOPTS_VALUE;
+        }
+    }
+    void PacketCache::record(const AVPacket* packet) {
+        if (packet->flags & AV_PKT_FLAG_KEY) {
+            int64_t key = getPacketKey(packet);
+            finish(key);
+            if (key != AV_NOPTS_VALUE) {
+                // Same GOP read again replaces the cached one
+                erase(key);
+                gops[key];
+                order.push_back(key);
+                recordKey = key;
+            }
+        }
+        if (recordKey == AV_NOPTS_VALUE) {
+            return; // packets before the first keyframe can't be decoded alone
+        }
+
+        auto clone = av_packet_clone(packet);
+        if (!clone) {
+            interrupt();
+            return;
+        }
+        gops[recordKey].packets.push_back(clone);
+        bytes += clone->size;
+
+        while (bytes > budgetBytes && !order.empty() && order.front() != recordKey) {
+            erase(order.front());
+        }
+    }
+    void PacketCache::finish(int64_t nextKey) {
+        if (recordKey != AV_NOPTS_VALUE && nextKey != AV_NOPTS_VALUE) {
+            gops[recordKey].nextKey = nextKey;
+            recordKey = AV_NOPTS_VALUE;
+        }
+        else {
+            interrupt();
+        }
+    }
+    void PacketCache::interrupt() {
+        // GOP without its end isn't known to contain the frames being sought
+        if (recordKey != AV_NOPTS_VALUE) {
+            erase(recordKey);
+        }
+    }
+    bool PacketCache::find(int64_t pts, int64_t& key) const {
+        auto it = gops.upper_bound(pts);
+        if (it == gops.begin()) {
+            return false;
+        }
+        --it;
+        const auto& gop = it->second;
+        if (gop.nextKey == AV_NOPTS_VALUE || gop.packets.empty() || pts >= gop.nextKey) {
+            return false;
+        }
+        key = it->first;
+        return true;
+    }
+    const AVPacket* PacketCache::get(int64_t key, size_t index) const {
+        auto it = gops.find(key);
+        if (it == gops.end() || index >= it->second.packets.size()) {
+            return nullptr;
+        }
+        return it->second.packets[index];
+    }
+    int64_t PacketCache::nextKey(int64_t key) const {
+        auto it = gops.find(key);
+        return it != gops.end() ? it->second.nextKey : AV_NOPTS_VALUE;
+    }
+
+
     VideoReader::VideoReader() {
         av_log_set_level(AV_LOG_FATAL);
     }
@@ -152,6 +591,7 @@ namespace video {
             avcodec_free_context(&decoderContext);
             decoderContext = nullptr;
         }
+        decoder = nullptr;
         if (packet) {
             av_packet_free(&packet);
             packet = nullptr;
@@ -160,11 +600,18 @@ namespace video {
             av_frame_unref(frame);
             av_frame_free(&frame);
         }
+        packets.clear();
+        replayKey = AV_NOPTS_VALUE;
         converter.destroyContext();
     }
-    bool VideoReader::open(const char* fileName) {
+    bool VideoReader::open(const char* fileName, int width, int height) {
         destroy();
         eof = false;
+        lastDts = AV_NOPTS_VALUE;
+        skipDts = AV_NOPTS_VALUE;
+        diff.reset();
+        diffPts = -1;
+        diffBusy = false;
 
         if (avformat_open_input(&formatContext, fileName, nullptr, nullptr) < 0) {
             return false;// OpenFileResult::FileBadOpen;
@@ -174,25 +621,15 @@ namespace video {
             return false;// OpenFileResult::StreamInfoNotFound;
         }
 
-        const AVCodec* decoder = nullptr;
         videoStreamIndex = av_find_best_stream(formatContext, AVMEDIA_TYPE_VIDEO, -1, -1, &decoder, 0);
         if (videoStreamIndex < 0) {
             return false;// OpenFileResult::VideoStreamNotFound;
         }
 
-        decoderContext = avcodec_alloc_context3(decoder);
-        if (decoderContext == nullptr) {
-            return false;// OpenFileResult::CodecContextBadAlloc;
-        }
-
-        const AVStream* videoStream = formatContext->streams[videoStreamIndex];
-        if (avcodec_parameters_to_context(decoderContext, videoStream->codecpar) < 0) {
-            return false;// OpenFileResult::CodecContextBadCopy;
-        }
-
-        if (avcodec_open2(decoderContext, decoder, nullptr) < 0) {
+        if (!openDecoder()) {
             return false;// OpenFileResult::CodecContextBadInit;
         }
+        const AVStream* videoStream = formatContext->streams[videoStreamIndex];
 
         packet = av_packet_alloc();
         if (packet == nullptr) {
@@ -204,12 +641,55 @@ namespace video {
             return false;// OpenFileResult::FrameBadAlloc;
         }
 
-        if (converter.createContext(decoderContext) == false) {
+        outputWidth = width > 0 ? width : decoderContext->width;
+        outputHeight = height > 0 ? height : decoderContext->height;
+        const AVRational rate = av_guess_frame_rate(formatContext, formatContext->streams[videoStreamIndex], nullptr);
+        defaultDuration = rate.num > 0 ? av_rescale_q(1, av_inv_q(rate), videoStream->time_base) : 0;
+
+        if (converter.createContext(decoderContext, outputWidth, outputHeight) == false) {
             return false;// OpenFileResult::SwsContextBadAlloc;
         }
 
         return true;// OpenFileResult::Ok;
     }
+    bool VideoReader::openDecoder() {
+        if (decoderContext) {
+            avcodec_free_context(&decoderContext);
+        }
+
+        const AVStream* videoStream = formatContext->streams[videoStreamIndex];
+        decoderContext = avcodec_alloc_context3(decoder);
+        if (decoderContext == nullptr) {
+            return false;
+        }
+        if (avcodec_parameters_to_context(decoderContext, videoStream->codecpar) < 0) {
+            return false;
+        }
+
+        AVDictionary* options = nullptr;
+        if (motionVectors) {
+            av_dict_set(&options, "flags2", "+export_mvs", 0);
+        }
+        const int ret = avcodec_open2(decoderContext, decoder, &options);
+        av_dict_free(&options);
+        return ret >= 0;
+    }
+    bool VideoReader::setMotionVectors(bool enabled) {
+        if (motionVectors == enabled) {
+            return true;
+        }
+        motionVectors = enabled;
+        if (!formatContext || !decoder) {
+            return true;
+        }
+
+        // The option is taken when the decoder opens, the new decoder starts from a seek
+        if (!openDecoder()) {
+            std::cout << "Warning: could not reopen decoder" << std::endl;
+            return false;
+        }
+        return true;
+    }
     bool VideoReader::read(RGBFrame& result, int64_t skipPts) {
         while (readRaw()) {
             if (frame->pts < skipPts) {
@@ -229,21 +709,11 @@ namespace video {
     }
     bool VideoReader::readRaw() {
         while (true) {
-            int ret = av_read_frame(formatContext, packet);
-            if (ret == AVERROR_EOF) {
-                eof = true;
-                return false;
-            }
-            if (ret < 0) {
+            if (!readPacket()) {
                 return false;
             }
 
-            if (packet->stream_index != videoStreamIndex) {
-                av_packet_unref(packet);
-                continue;
-            }
-
-            ret = avcodec_send_packet(decoderContext, packet);
+            int ret = avcodec_send_packet(decoderContext, packet);
             if (ret < 0) {
                 return false;
             }
@@ -262,28 +732,171 @@ namespace video {
         }
         return true;
     }
+    bool VideoReader::readPacket() {
+        while (replayKey != AV_NOPTS_VALUE) {
+            if (auto cached = packets.get(replayKey, replayIndex)) {
+                replayIndex++;
+                lastDts = cached->dts;
+                return av_packet_ref(packet, cached) >= 0;
+            }
+
+            int64_t nextKey = packets.nextKey(replayKey);
+            if (nextKey == PacketCache::endOfFile) {
+                eof = true;
+                return false;
+            }
+            int64_t key = AV_NOPTS_VALUE;
+            if (nextKey != AV_NOPTS_VALUE && packets.find(nextKey, key) && key == nextKey) {
+                replayKey = nextKey;
+                replayIndex = 0;
+                continue;
+            }
+
+            // Rest of the stream comes from the file, packets already sent to decoder are skipped
+            int64_t resumePts = nextKey != AV_NOPTS_VALUE ? nextKey : replayKey;
+            replayKey = AV_NOPTS_VALUE;
+            skipDts = lastDts;
+            if (av_seek_frame(formatContext, videoStreamIndex, resumePts, AVSEEK_FLAG_BACKWARD) < 0) {
+                return false;
+            }
+        }
+
+        while (true) {
+            int ret = av_read_frame(formatContext, packet);
+            if (ret == AVERROR_EOF) {
+                packets.finish(PacketCache::endOfFile);
+                eof = true;
+                return false;
+            }
+            if (ret < 0) {
+                return false;
+            }
+
+            if (packet->stream_index != videoStreamIndex) {
+                av_packet_unref(packet);
+                continue;
+            }
+            if (skipDts != AV_NOPTS_VALUE) {
+                if (packet->dts != AV_NOPTS_VALUE && packet->dts <= skipDts) {
+                    av_packet_unref(packet);
+                    continue;
+                }
+                skipDts = AV_NOPTS_VALUE;
+            }
+
+            packets.record(packet);
+            lastDts = packet->dts;
+            return true;
+        }
+    }
     bool VideoReader::convert(const AVFrame* frame, RGBFrame& result) {
 
-        bool sameSize = result.checkSize(frame->width, frame->height);
+        bool sameSize = result.checkSize(outputWidth, outputHeight);
         if (!sameSize) {
             std::cout << "toRGB(). Bad image size" << std::endl;
             return false;
         }
 
-        int ret = converter.toRGB(frame, result);
+        int ret = converter.toRGB(frame, result, region);
         if (ret < 0) {
             std::cout << "toRGB(). Bad convert, ret = " << ret << std::endl;
             return false;
         }
 
         result.pts = getFramePTS(frame);
-        result.dur = frame->duration;
+        result.dur = frame->duration > 0 ? frame->duration : defaultDuration;
+        result.proxy = proxy;
+        exportMotion(frame, result);
+        measure(frame, result);
+        compare(result);
         return true;
     }
+    void VideoReader::exportMotion(const AVFrame* frame, RGBFrame& result) {
+        // Frame takes a reference of the side data buffer, it lives until the frame is reused
+        result.motion = MotionVectors();
+        const AVFrameSideData* side = motionVectors ? av_frame_get_side_data(frame, AV_FRAME_DATA_MOTION_VECTORS) : nullptr;
+        if (!side || !side->buf || side->size < sizeof(AVMotionVector)) {
+            return;
+        }
+        AVBufferRef* ref = av_buffer_ref(side->buf);
+        if (!ref) {
+            return;
+        }
+        result.motion.data = std::shared_ptr<const uint8_t>(side->data, [ref](const uint8_t*) {
+            AVBufferRef* unused = ref;
+            av_buffer_unref(&unused);
+        });
+        result.motion.count = side->size / sizeof(AVMotionVector);
+    }
+    void VideoReader::measure(const AVFrame* frame, RGBFrame& result) {
+        // Planar YUV is read in place, the sampled part of it costs the same at any resolution
+        result.levels.reset();
+        if (!measureScopes) {
+            return;
+        }
+        const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+        const bool native = desc && desc->nb_components >= 3 &&
+            (desc->flags & AV_PIX_FMT_FLAG_PLANAR) && !(desc->flags & AV_PIX_FMT_FLAG_RGB) && !(desc->flags & AV_PIX_FMT_FLAG_BE) &&
+            desc->comp[0].depth >= 8 && desc->comp[0].depth <= 16 && desc->comp[1].plane == 1 && desc->comp[2].plane == 2;
+        if (!native) {
+            return;
+        }
+
+        auto counts = std::make_shared<scopes::Counts>();
+        const uint8_t* planes[3] = { frame->data[0], frame->data[1], frame->data[2] };
+        const int depth = desc->comp[0].depth;
+        if (depth == 8) {
+            scopes::measure<uint8_t>(planes, frame->linesize, frame->width, frame->height, desc->log2_chroma_w, desc->log2_chroma_h, depth, *counts);
+        }
+        else {
+            scopes::measure<uint16_t>(planes, frame->linesize, frame->width, frame->height, desc->log2_chroma_w, desc->log2_chroma_h, depth, *counts);
+        }
+        result.levels = std::move(counts);
+    }
+    void VideoReader::compare(RGBFrame& result) {
+        /*
+            Marks blocks changed since the last compared frame, so only they are uploaded
+            when that frame is still on GPU. Mostly changing video isn't worth comparing,
+            it is checked once in a while to notice static parts
+        */
+        constexpr float busyFraction = 0.75f;
+        constexpr int busySkip = 16;
+
+        result.basePts = -1;
+        result.dirtyBlocks.clear();
+        if (result.proxy || !(result.region == FrameRegion{ 0, 0, result.width, result.height })) {
+            diff.reset();
+            return;
+        }
+        if (diffBusy && ++diffSkipped < busySkip) {
+            return;
+        }
+
+        diffSkipped = 0;
+        diffBusy = false;
+        if (diff.compare(result.pixels, result.width, result.height, result.lineSize, 3)) {
+            result.basePts = diffPts;
+            result.dirtyBlocks = diff.mask();
+            diffBusy = diff.dirtyFraction() > busyFraction;
+        }
+        diffPts = result.pts;
+    }
     bool VideoReader::seek(int64_t pts) {
-        int result = av_seek_frame(formatContext, videoStreamIndex, pts, AVSEEK_FLAG_BACKWARD);
-        if (result < 0) {
-            return false;
+        packets.interrupt();
+        skipDts = AV_NOPTS_VALUE;
+
+        // Recently read GOP is decoded again from memory
+        int64_t key = AV_NOPTS_VALUE;
+        if (packets.find(pts, key)) {
+            replayKey = key;
+            replayIndex = 0;
+        }
+        else {
+            replayKey = AV_NOPTS_VALUE;
+            int result = av_seek_frame(formatContext, videoStreamIndex, pts, AVSEEK_FLAG_BACKWARD);
+            if (result < 0) {
+                return false;
+            }
         }
         avcodec_flush_buffers(decoderContext);
         eof = false;
@@ -294,13 +907,22 @@ namespace video {
             return StreamInfo{ {0, 1}, 0, 0, 1, 1 };
         }
 
+        // Inter-frame codecs at high resolution or with long GOPs by design
+        const auto codecId = decoderContext->codec_id;
+        const auto descriptor = avcodec_descriptor_get(codecId);
+        const bool intraOnly = descriptor && (descriptor->props & AV_CODEC_PROP_INTRA_ONLY);
+        const bool largeFrames = static_cast<int64_t>(decoderContext->width) * decoderContext->height > 1920 * 1080;
+        const bool longGop = codecId == AV_CODEC_ID_HEVC || codecId == AV_CODEC_ID_AV1 || codecId == AV_CODEC_ID_VP9;
+
         const AVStream* stream = formatContext->streams[videoStreamIndex];
         return StreamInfo{
             stream->time_base,
             stream->duration,
             stream->nb_frames,
             decoderContext->width,
-            decoderContext->height
+            decoderContext->height,
+            !intraOnly && (largeFrames || longGop),
+            stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0
         };
     }
 
@@ -319,7 +941,16 @@ namespace video {
         result = nullptr;
     }
     bool FrameLoader::open(const char* fileName, StreamInfo& info) {
+        {
+            auto lock = std::lock_guard(mtx);
+            reader.motionVectors = sharedState.motion;
+        }
         if (reader.open(fileName)) {
+            archive.clear();
+            source = &reader;
+            proxyFile.clear();
+            proxyChanged = false;
+            proxyOpened = false;
             info = reader.getStreamInfo();
             return true;
         }
@@ -333,6 +964,7 @@ namespace video {
             sharedState.seekPts = -1;
         }
         cv.notify_one();
+        archive.start();
         t = std::thread([this]() {
             playback();
         });
@@ -348,6 +980,7 @@ namespace video {
         if (t.joinable()) {
             t.join();
         }
+        archive.stop();
 
         pool.put(prevCache);
         prevCache.clear();
@@ -373,14 +1006,16 @@ namespace video {
     void FrameLoader::playback() {
         while (canWork()) {
             auto state = copyState();
+            openProxy();
             auto frame = readFrame(state);
+            deduplicate(frame);
             saveResult(frame, state);
         }
         std::cout << "stopped" << std::endl;
     }
     bool FrameLoader::canWork() {
         auto lock = std::unique_lock(mtx);
-        while (!stopped && (result || reader.eof && sharedState.seekPts == -1)) {
+        while (!stopped && (result || source->eof && sharedState.seekPts == -1)) {
             cv.wait(lock);
         }
         return !stopped;
@@ -391,38 +1026,66 @@ namespace video {
         return copy;
     }
     void FrameLoader::saveResult(RGBFrame* frame, State workState) {
-        auto lock = std::lock_guard(mtx);
-        if (workState != sharedState) {
-            /* result is not actual because sharedState changed during the av_read... */
-            pool.put(frame);
-            return;
-        }
+        {
+            auto lock = std::lock_guard(mtx);
+            if (workState != sharedState) {
+                /* result is not actual because sharedState changed during the av_read... */
+                pool.put(frame);
+                return;
+            }
 
-        if (sharedState.seekPts != -1) {
-            // need seek only once per read
-            sharedState.seekPts = -1;
-        }
+            if (sharedState.seekPts != -1) {
+                // need seek only once per read
+                sharedState.seekPts = -1;
+            }
+
+            if (!frame) {
+                return;
+            }
 
-        if (frame) {
             result = frame;
             lastPts = frame->pts;
         }
+
+        if (notifyFn) {
+            notifyFn();
+        }
+    }
+    void FrameLoader::deduplicate(RGBFrame* frame) {
+        // Partially converted frame isn't a whole content to share
+        if (frame && frame->region == FrameRegion{ 0, 0, frame->width, frame->height }) {
+            pool.share(frame, hash::xxh64(frame->pixels, frame->contentSize()));
+        }
     }
     RGBFrame* FrameLoader::readFrame(const State& state) {
 
         auto loadDir = state.loadDir;
         auto seekPts = state.seekPts;
 
+        // Proxy is intra-only, it has no motion to export.
+        // Reopened decoder must start from a seek, the flag waits for the one following it
+        if (seekPts >= 0) {
+            reader.setMotionVectors(state.motion);
+        }
+        reader.measureScopes = state.scopes;
+        proxyReader.measureScopes = state.scopes;
+
+        // Reader changes only with a seek, sequential reads continue the same file
+        if (seekPts >= 0 || (loadDir < 0 && prevCache.empty())) {
+            source = state.proxy && proxyOpened ? &proxyReader : &reader;
+        }
+        source->region = state.region;
+
         if (loadDir > 0) {
             if (seekPts >= 0) {
 
-                bool ok = reader.seek(seekPts);
+                bool ok = source->seek(seekPts);
                 if (!ok) {
                     return nullptr;
                 }
 
                 auto frame = pool.get();
-                ok = reader.read(*frame, seekPts);
+                ok = source->read(*frame, seekPts);
                 if (!ok) {
                     pool.put(frame);
                     return nullptr;
@@ -432,7 +1095,7 @@ namespace video {
             }
             else {
                 auto frame = pool.get();
-                bool ok = reader.read(*frame);
+                bool ok = source->read(*frame);
                 if (!ok) {
                     pool.put(frame);
                     return nullptr;
@@ -447,8 +1110,20 @@ namespace video {
                 seekPts = lastPts - 1;
             }
 
+            // Recently shown frames are restored without seeking the reader.
+            // Archive keeps only pixels, scopes need the decoded planes
+            if (seekPts >= 0 && !state.scopes) {
+                auto frame = pool.get();
+                if (archive.restore(seekPts, *frame)) {
+                    pool.put(prevCache);
+                    prevCache.clear();
+                    return frame;
+                }
+                pool.put(frame);
+            }
+
             if (seekPts >= 0) {
-                reader.seek(seekPts);
+                source->seek(seekPts);
 
                 prevCache.resize(5, nullptr);
                 for (auto& item : prevCache) {
@@ -462,7 +1137,7 @@ namespace video {
                 size_t writeIndex = 0;
                 bool foundInCache = false;
                 auto frame = prevCache[writeIndex];
-                while (reader.read(*frame)) {
+                while (source->read(*frame)) {
                     auto min = frame->pts;
                     auto max = frame->pts + frame->dur;
                     if (min <= seekPts && seekPts < max) {
@@ -511,6 +1186,54 @@ namespace video {
 
         return nullptr;
     }
+    void FrameLoader::setRegion(const FrameRegion& region) {
+        auto lock = std::lock_guard(mtx);
+        sharedState.region = region;
+    }
+    void FrameLoader::setProxy(bool enabled) {
+        auto lock = std::lock_guard(mtx);
+        sharedState.proxy = enabled;
+    }
+    void FrameLoader::setMotionVectors(bool enabled) {
+        {
+            auto lock = std::lock_guard(mtx);
+            if (sharedState.motion == enabled) {
+                return;
+            }
+            sharedState.motion = enabled;
+        }
+        // Frames archived before have no vectors to restore
+        archive.clear();
+    }
+    void FrameLoader::setScopes(bool enabled) {
+        auto lock = std::lock_guard(mtx);
+        sharedState.scopes = enabled;
+    }
+    void FrameLoader::setProxyFile(const std::string& fileName) {
+        auto lock = std::lock_guard(mtx);
+        proxyFile = fileName;
+        proxyChanged = true;
+    }
+    void FrameLoader::openProxy() {
+        std::string fileName;
+        {
+            auto lock = std::lock_guard(mtx);
+            if (!proxyChanged) {
+                return;
+            }
+            fileName = proxyFile;
+            proxyChanged = false;
+        }
+
+        // Proxy frames are scaled to the source size, the rest of pipeline doesn't see the difference
+        source = &reader;
+        const auto info = reader.getStreamInfo();
+        proxyReader.proxy = true;
+        proxyOpened = proxyReader.open(fileName.c_str(), info.width, info.height);
+        if (!proxyOpened) {
+            std::cout << "Warning: could not open proxy " << fileName << std::endl;
+        }
+    }
     RGBFrame* FrameLoader::getFrame() {
         auto lock = std::lock_guard(mtx);
         if (result == nullptr) {
@@ -526,9 +1249,15 @@ namespace video {
     void FrameLoader::putFrame(RGBFrame* unusedFrame) {
         pool.put(unusedFrame);
     }
+    void FrameLoader::archiveFrame(RGBFrame* oldFrame) {
+        archive.add(oldFrame);
+    }
     void FrameLoader::createFrames(size_t count, int w, int h) {
         pool.createFrames(count, w, h);
     }
+    void FrameLoader::setNotify(std::function<void()> fn) {
+        notifyFn = std::move(fn);
+    }
 
 
     const RGBFrame* FrameQueue::curr() {
@@ -651,11 +1380,17 @@ namespace video {
 
         auto prev = items.pushBack(frame);
         if (prev) {
-            loader.putFrame(prev);
+            loader.archiveFrame(prev);
             if (selected > 0) {
                 selected--;
             }
         }
+
+        // History is kept while its distinct pixels fit the budget
+        while (selected > deltaMin && items.size() > minFrames && overBudget()) {
+            loader.archiveFrame(items.popFront());
+            selected--;
+        }
     }
     void FrameQueue::tryFillFront(FrameLoader& loader) {
         if (tooFarFromBegin()) {
@@ -672,11 +1407,25 @@ namespace video {
         }
 
         auto prev = items.pushFront(frame);
-        loader.putFrame(prev);
+        loader.archiveFrame(prev);
 
         if (selected >= 0) {
             selected++;
         }
+
+        while (selected + deltaMin + 1 < items.size() && items.size() > minFrames && overBudget()) {
+            loader.archiveFrame(items.popBack());
+        }
+    }
+    bool FrameQueue::overBudget() const {
+        std::unordered_set<const PixelBuffer*> distinct;
+        size_t bytes = 0;
+        for (auto item : items) {
+            if (item->buffer && distinct.insert(item->buffer.get()).second) {
+                bytes += item->buffer->size;
+            }
+        }
+        return bytes > budgetBytes;
     }
 
 
@@ -684,16 +1433,32 @@ namespace video {
         ps.started = false;
         frameQ.flush(loader);
         loader.stop();
+        proxyBuilder.stop();
+        scenes.stop();
+        timeline.stop();
+        proxyLoaded = false;
+        proxyWanted = false;
+        loopFrom = -1;
+        loopTo = -1;
+        unpinFrames();
 
         if (loader.open(fileName, info)) {
             auto count =
-                FrameQueue::capacity +
+                FrameQueue::minFrames +
                 FrameLoader::cacheSize;
             loader.createFrames(count, info.width, info.height);
             loader.start();
             lastUpdate = std::chrono::steady_clock::now();
             ps = PlayState();
             ps.started = true;
+            this->fileName = fileName;
+            startProxy();
+            if (scenesEnabled) {
+                scenes.start(this->fileName);
+            }
+            if (timelineEnabled) {
+                timeline.start(this->fileName);
+            }
             return true;
         }
 
@@ -701,14 +1466,21 @@ namespace video {
     }
     void Player::stop() {
         ps.started = false;
+        loopFrom = -1;
+        loopTo = -1;
+        unpinFrames();
         frameQ.flush(loader);
         loader.stop();
+        proxyBuilder.stop();
+        scenes.stop();
+        timeline.stop();
     }
     void Player::seekProgress(float progress, bool hold) {
         if (!ps.started) {
             return;
         }
         ps.hold = hold;
+        useProxy(hold, std::chrono::steady_clock::now());
         auto pts = info.progressToPts(progress);
         seekPts(pts);
     }
@@ -717,6 +1489,8 @@ namespace video {
             return;
         }
 
+        // Stepping back through long GOPs is fast only on the intra proxy
+        useProxy(ps.paused, std::chrono::steady_clock::now());
         if (ps.paused) {
             if (isLong) {
                 ps.update = true;
@@ -725,7 +1499,7 @@ namespace video {
                 auto pts = std::min(info.durationPts, ps.framePts - dif);
                 seekPts(pts);
             }
-            else {
+            else if (!stepPinned(-1)) {
                 ps.update = true;
                 frameQ.seekPrevFrame(loader);
                 frameQ.print();
@@ -744,6 +1518,7 @@ namespace video {
             return;
         }
 
+        useProxy(false, std::chrono::steady_clock::now());
         if (ps.paused) {
             if (isLong) {
                 ps.update = true;
@@ -752,7 +1527,7 @@ namespace video {
                 auto pts = std::min(info.durationPts, ps.framePts + dif);
                 seekPts(pts);
             }
-            else {
+            else if (!stepPinned(1)) {
                 ps.update = true;
                 frameQ.seekNextFrame(loader);
                 frameQ.print();
@@ -766,12 +1541,22 @@ namespace video {
             seekPts(pts);
         }
     }
+    void Player::seekCut(int direction) {
+        if (!ps.started) {
+            return;
+        }
+        const int64_t pts = direction < 0 ? scenes.prev(ps.framePts) : scenes.next(ps.framePts);
+        if (pts >= 0) {
+            seekPts(pts);
+        }
+    }
     void Player::seekPts(int64_t pts) {
         if (!ps.started) {
             return;
         }
 
         // flush frameQ
+        pinnedPts = -1;
         frameQ.flush(loader);
 
         // seek && flush loader
@@ -782,6 +1567,250 @@ namespace video {
         ps.framePts = pts;
         ps.progress = info.calcProgress(pts);
     }
+    void Player::reload() {
+        // Reads the shown frame again, e.g. when its converted region is not enough anymore
+        if (ps.started && ps.paused) {
+            seekPts(ps.framePts);
+        }
+    }
+    void Player::setRegion(const FrameRegion& region) {
+        if (ps.started) {
+            loader.setRegion(region);
+        }
+    }
+    void Player::setLoopStart() {
+        if (!ps.started) {
+            return;
+        }
+        loopFrom = ps.framePts;
+        if (loopTo <= loopFrom) {
+            loopTo = -1;
+        }
+        unpinFrames();
+    }
+    void Player::setLoopEnd() {
+        if (!ps.started) {
+            return;
+        }
+        // Shown frame is the last one of the loop
+        loopTo = ps.framePts + std::max<int64_t>(ps.frameDur, 1);
+        // Loop without a start marker begins with the stream, its first frame must get pinned
+        if (loopFrom < 0 || loopFrom >= loopTo) {
+            loopFrom = std::min(info.startPts, ps.framePts);
+        }
+        unpinFrames();
+    }
+    void Player::clearLoop() {
+        loopFrom = -1;
+        loopTo = -1;
+        unpinFrames();
+    }
+    bool Player::hasLoop() const {
+        return loopTo >= 0;
+    }
+    void Player::pinFrame(const RGBFrame* frame) {
+        if (!hasLoop() || !frame || !frame->buffer || frame->proxy || pinned.contains(frame->pts)) {
+            return;
+        }
+        // Only whole exact frames of the loop, partially converted ones can't be shown zoomed out
+        if (frame->pts + frame->dur <= loopFrom || frame->pts >= loopTo ||
+            !(frame->region == FrameRegion{ 0, 0, frame->width, frame->height })) {
+            return;
+        }
+        const bool newBuffer = !pinnedBuffers.contains(frame->buffer.get());
+        if (newBuffer && pinnedBytes + frame->buffer->size > pinBudget) {
+            return;
+        }
+
+        auto copy = new RGBFrame(frame->width, frame->height, frame->buffer);
+        copy->pts = frame->pts;
+        copy->dur = frame->dur;
+        copy->region = frame->region;
+        copy->basePts = frame->basePts;
+        copy->dirtyBlocks = frame->dirtyBlocks;
+        copy->motion = frame->motion;
+        copy->levels = frame->levels;
+        pinned[copy->pts] = copy;
+        if (newBuffer) {
+            pinnedBuffers.insert(frame->buffer.get());
+            pinnedBytes += frame->buffer->size;
+        }
+    }
+    void Player::unpinFrames() {
+        // Queue is behind the pinned frame, it is read again from there
+        const bool resync = pinnedPts >= 0;
+        pinnedPts = -1;
+        for (auto& [pts, frame] : pinned) {
+            delete frame;
+        }
+        pinned.clear();
+        pinnedBuffers.clear();
+        pinnedBytes = 0;
+        if (resync) {
+            seekPts(ps.framePts);
+        }
+    }
+    bool Player::pinnedComplete() const {
+        if (!hasLoop() || pinned.empty() || pinned.begin()->first > loopFrom) {
+            return false;
+        }
+        const RGBFrame* prev = nullptr;
+        for (const auto& [pts, frame] : pinned) {
+            if (prev && !checkPts(prev, frame)) {
+                return false;
+            }
+            prev = frame;
+        }
+        const int64_t end = info.durationPts > 0 ? std::min(loopTo, info.durationPts) : loopTo;
+        return prev->pts + prev->dur >= end;
+    }
+    bool Player::stepPinned(int direction) {
+        if (!pinnedComplete() || ps.framePts < loopFrom || ps.framePts >= loopTo) {
+            return false;
+        }
+
+        auto it = pinned.upper_bound(ps.framePts);
+        if (it == pinned.begin()) {
+            return false;
+        }
+        --it;
+        const RGBFrame* shown = it->second;
+        if (direction > 0) {
+            ++it;
+        }
+        else {
+            it = it == pinned.begin() ? pinned.end() : std::prev(it);
+        }
+
+        if (it == pinned.end()) {
+            // Stepping out of the loop, the queue continues from the shown frame
+            if (pinnedPts < 0) {
+                return false;
+            }
+            seekPts(direction > 0 ? nextSeekPosition(shown) : prevSeekPosition(shown));
+            return true;
+        }
+        pinnedPts = it->first;
+        ps.update = true;
+        return true;
+    }
+    const RGBFrame* Player::nextFrame() {
+        if (pinnedPts >= 0) {
+            auto it = pinned.upper_bound(pinnedPts);
+            if (it == pinned.end() || it->first >= loopTo) {
+                return wrapLoop();
+            }
+            pinnedPts = it->first;
+            return it->second;
+        }
+
+        auto frame = frameQ.next();
+        if (frame) {
+            pinFrame(frame);
+        }
+        if (hasLoop() && (frame ? frame->pts >= loopTo : eof())) {
+            return wrapLoop();
+        }
+        return frame;
+    }
+    const RGBFrame* Player::wrapLoop() {
+        if (pinnedComplete()) {
+            auto it = pinned.begin();
+            pinnedPts = it->first;
+            return it->second;
+        }
+
+        // Frames are pinned while the loop is decoded again
+        seekPts(loopFrom);
+        return nullptr;
+    }
+    void Player::setProxyEnabled(bool enabled) {
+        if (proxyEnabled == enabled) {
+            return;
+        }
+        proxyEnabled = enabled;
+        if (!enabled) {
+            proxyBuilder.stop();
+            useProxy(false, std::chrono::steady_clock::now());
+        }
+        else if (ps.started) {
+            startProxy();
+        }
+    }
+    void Player::setScenesEnabled(bool enabled) {
+        if (scenesEnabled == enabled) {
+            return;
+        }
+        scenesEnabled = enabled;
+        if (!enabled) {
+            scenes.stop();
+        }
+        else if (ps.started) {
+            scenes.start(fileName);
+        }
+    }
+    void Player::setTimelineEnabled(bool enabled) {
+        if (timelineEnabled == enabled) {
+            return;
+        }
+        timelineEnabled = enabled;
+        if (!enabled) {
+            timeline.stop();
+        }
+        else if (ps.started) {
+            timeline.start(fileName);
+        }
+    }
+    void Player::setMotionEnabled(bool enabled) {
+        if (motionEnabled == enabled) {
+            return;
+        }
+        motionEnabled = enabled;
+        loader.setMotionVectors(enabled);
+
+        // Decoder is opened again, it continues from the shown frame
+        if (ps.started) {
+            seekPts(ps.framePts);
+        }
+    }
+    void Player::setScopesEnabled(bool enabled) {
+        if (scopesEnabled == enabled) {
+            return;
+        }
+        scopesEnabled = enabled;
+        loader.setScopes(enabled);
+        if (enabled) {
+            reload();
+        }
+    }
+    void Player::startProxy() {
+        if (proxyEnabled && info.heavy && !proxyLoaded && !proxyBuilder.isRunning()) {
+            proxyBuilder.start(fileName, ProxyBuilder::cachePath(fileName));
+        }
+    }
+    void Player::useProxy(bool enabled, const time_point& now) {
+        proxyWanted = enabled && proxyEnabled && proxyLoaded;
+        loader.setProxy(proxyWanted);
+        lastSeek = now;
+    }
+    void Player::settleProxy(const time_point& now) {
+        /*
+            Proxy frames stand in while the user scrubs or steps back,
+            the exact frame is read from the source once the user stops
+        */
+        constexpr auto settleTime = std::chrono::milliseconds(300);
+        if (!ps.paused || ps.hold || now - lastSeek < settleTime) {
+            return;
+        }
+        if (proxyWanted) {
+            proxyWanted = false;
+            loader.setProxy(false);
+        }
+        if (ps.proxy) {
+            ps.proxy = false;
+            seekPts(ps.framePts);
+        }
+    }
     void Player::pause(bool paused) {
         if (!ps.started) {
             return;
@@ -793,6 +1822,7 @@ namespace video {
             frameQ.print();
         }
         else {
+            useProxy(false, std::chrono::steady_clock::now());
             ps.paused = false;
             ps.update = false;
             frameQ.play(loader);
@@ -805,6 +1835,11 @@ namespace video {
 
         using std::chrono::microseconds;
         using std::chrono::duration_cast;
+        if (!proxyLoaded && proxyBuilder.isReady()) {
+            loader.setProxyFile(proxyBuilder.getTarget());
+            proxyLoaded = true;
+        }
+        settleProxy(now);
         frameQ.fillFrom(loader);
             
         if (!ps.paused && !ps.hold) {
@@ -812,7 +1847,7 @@ namespace video {
             auto durationPts = info.microsToPts(durationMicros);
 
             if (durationPts > ps.frameDur || ps.update) {
-                const RGBFrame* frame = frameQ.next();
+                const RGBFrame* frame = nextFrame();
                 if (frame) {
                     auto deltaPts = durationPts - ps.frameDur;
                     if (deltaPts < frame->dur) {
@@ -825,6 +1860,7 @@ namespace video {
                     ps.update = false;
                     ps.framePts = frame->pts;
                     ps.frameDur = frame->dur;
+                    ps.proxy = frame->proxy;
                     ps.progress = info.calcProgress(frame->pts);
 
                     int64_t seconds = (info.time_base.num + frame->pts) / info.time_base.den;
@@ -845,11 +1881,15 @@ namespace video {
             }
         }
         else if (ps.update) {
-            const RGBFrame* frame = frameQ.curr();
+            const RGBFrame* frame = currentFrame();
             if (frame) {
+                if (pinnedPts < 0) {
+                    pinFrame(frame);
+                }
                 ps.update = false;
                 ps.framePts = frame->pts;
                 ps.frameDur = frame->dur;
+                ps.proxy = frame->proxy;
                 ps.progress = info.calcProgress(frame->pts);
                 
                 int64_t seconds = (info.time_base.num + frame->pts) / info.time_base.den;
@@ -871,6 +1911,13 @@ namespace video {
 
         return false;
     }
+    bool Player::active() const {
+        /* 
+            Player needs continuous updates while playing or while user holds the slider,
+            and until the shown proxy frame is replaced by the exact one. Otherwise a new frame comes only after seek, and loader notifies about it
+        */
+        return ps.started && (!ps.paused || ps.hold || proxyWanted || ps.proxy);
+    }
     bool Player::eof() {
         auto pts = ps.framePts + ps.frameDur;
         return pts >= info.durationPts;
@@ -884,6 +1931,9 @@ namespace video {
     }
 
     const RGBFrame* Player::currentFrame() {
+        if (pinnedPts >= 0) {
+            return pinned[pinnedPts];
+        }
         return frameQ.curr();
     }
 
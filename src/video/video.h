@@ -4,20 +4,43 @@
 #include <mutex>
 #include <condition_variable>
 #include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include "ffmpeg.h"
 #include "frame.h"
+#include "proxy.h"
+#include "scenes.h"
+#include "timeline.h"
+#include "util/blockdiff.h"
 #include "util/circlebuffer.h"
 
 namespace video {
     
     typedef std::chrono::steady_clock::time_point time_point;
 
+    /*
+        Frames and their pixel buffers.
+        Converted frames are indexed by content hash, a frame identical to one still in use
+        takes its buffer and gives own buffer back, so memory follows distinct content.
+        Buffer is exclusive while the loader writes into it
+    */
     class FramePool {
         std::mutex mtx;
-        std::vector<RGBFrame*> items;
+        std::vector<RGBFrame*> items;                   // frames without buffers
+        std::vector<std::shared_ptr<PixelBuffer>> spare;
+        std::unordered_map<uint64_t, std::weak_ptr<PixelBuffer>> contents;
+        size_t spareLimit = 0;
         int frameWidth = 0;
         int frameHeight = 0;
 
+        void release(RGBFrame* frame);
+        void unindex(const std::shared_ptr<PixelBuffer>& buffer);
+
     public:
         FramePool() = default;
         ~FramePool();
@@ -25,6 +48,53 @@ namespace video {
         void put(RGBFrame* item);
         void put(const std::vector<RGBFrame*>& frames);
         RGBFrame* get();
+        void share(RGBFrame* frame, uint64_t hash);
+    };
+
+    /*
+        Second tier of the frame history: frames leaving FrameQueue are compressed
+        on a worker thread and kept in RAM, stepping back into them decompresses
+        instead of seeking and decoding the whole GOP again
+    */
+    class FrameArchive {
+    public:
+        static constexpr size_t budgetBytes = 256 * 1024 * 1024;   // compressed bytes
+        static constexpr size_t maxPending = 8;     // frames waiting for compression, others are dropped
+
+    private:
+        typedef std::shared_ptr<const std::vector<uint8_t>> Data;
+        struct Entry {
+            int64_t dur = 0;
+            bool proxy = false;
+            Data data;
+            MotionVectors motion;   // side data of the decoded frame, shared without a copy
+        };
+
+        std::thread t;
+        std::mutex mtx;
+        std::condition_variable cv;
+        bool stopped = true;
+        FramePool& pool;
+        std::deque<RGBFrame*> pending;
+        std::map<int64_t, Entry> entries;       // by pts
+        std::deque<int64_t> order;              // pts of entries, oldest first
+        std::unordered_map<uint64_t, std::weak_ptr<const std::vector<uint8_t>>> contents;   // by pixel hash
+        std::atomic<size_t> bytes = 0;     // compressed data alive
+
+        void work();
+        Data compress(const RGBFrame* frame, std::vector<uint8_t>& scratch, std::vector<uint8_t>& packed);
+        bool covers(const RGBFrame* frame) const;
+        void store(const RGBFrame* frame, uint64_t hash, Data data);
+        void evict();
+
+    public:
+        explicit FrameArchive(FramePool& pool) : pool(pool) {}
+        ~FrameArchive();
+        void start();
+        void stop();
+        void clear();
+        void add(RGBFrame* frame);
+        bool restore(int64_t pts, RGBFrame& frame);
     };
 
     struct StreamInfo {
@@ -33,6 +103,8 @@ namespace video {
         int64_t framesCount = 0;
         int width = 0;
         int height = 0;
+        bool heavy = false;     // long GOP or large frames, slow to seek and step back
+        int64_t startPts = 0;   // of the first frame, above 0 in MPEG-TS and edited files
         float calcProgress(int64_t pts) const;
         int64_t ptsToMicros(int64_t pts) const;
         int64_t microsToPts(int64_t micros) const;
@@ -41,34 +113,96 @@ namespace video {
 
     struct FrameConverter {
         SwsContext* swsContext = nullptr;
+        SwsContext* regionContext = nullptr;    // sized for the last converted region
         uint8_t* destFrame[AV_NUM_DATA_POINTERS] = { nullptr };
         int destLineSize[AV_NUM_DATA_POINTERS] = { 0 };
 
-        bool createContext(const AVCodecContext* decoder);
+        bool createContext(const AVCodecContext* decoder, int width, int height);
         void destroyContext();
-        int toRGB(const AVFrame* frame, RGBFrame& result);
+        int toRGB(const AVFrame* frame, RGBFrame& result, const FrameRegion& region);
+
+    private:
+        FrameRegion alignRegion(const AVFrame* frame, const FrameRegion& region) const;
+    };
+
+    /*
+        Demuxed packets of recently read GOPs. A GOP is complete once the next keyframe is known,
+        seeking into a complete GOP replays its packets without touching the file
+    */
+    class PacketCache {
+    public:
+        static constexpr size_t budgetBytes = 64 * 1024 * 1024;
+        static constexpr int64_t endOfFile = INT64_MAX;    // 'nextKey' of the last GOP
+
+    private:
+        struct Gop {
+            std::vector<AVPacket*> packets;
+            int64_t nextKey = AV_NOPTS_VALUE;   // pts of the following keyframe
+        };
+        std::map<int64_t, Gop> gops;            // by keyframe pts
+        std::deque<int64_t> order;              // keys, oldest first
+        size_t bytes = 0;
+        int64_t recordKey = AV_NOPTS_VALUE;     // GOP receiving demuxed packets
+
+        void erase(int64_t key);
+
+    public:
+        PacketCache() = default;
+        PacketCache(const PacketCache&) = delete;
+        PacketCache& operator=(const PacketCache&) = delete;
+        ~PacketCache();
+        void clear();
+        void record(const AVPacket* packet);
+        void finish(int64_t nextKey);
+        void interrupt();
+        bool find(int64_t pts, int64_t& key) const;
+        const AVPacket* get(int64_t key, size_t index) const;
+        int64_t nextKey(int64_t key) const;
     };
 
     struct VideoReader {
         AVFormatContext* formatContext = nullptr;
         AVCodecContext* decoderContext = nullptr;
+        const AVCodec* decoder = nullptr;       // found with the video stream, opened again for motion vectors
         int videoStreamIndex = -1;
         AVPacket* packet = nullptr;
         AVFrame* frame = nullptr;
+        PacketCache packets;
+        int64_t replayKey = AV_NOPTS_VALUE;     // cached GOP being replayed
+        size_t replayIndex = 0;
+        int64_t lastDts = AV_NOPTS_VALUE;       // of the last packet sent to decoder
+        int64_t skipDts = AV_NOPTS_VALUE;       // file packets up to it were replayed already
         FrameConverter converter;
+        FrameRegion region;     // converted part of frames, empty - whole frame
+        int outputWidth = 0;    // of converted frames, the proxy is scaled up to the source size
+        int outputHeight = 0;
+        int64_t defaultDuration = 0;    // for frames without duration
+        bool proxy = false;
+        bool motionVectors = false;     // decoder exports motion vectors of frames
+        bool measureScopes = false;     // frames carry scopes of their planes
+        BlockDiff diff;         // changes against the last compared frame
+        int64_t diffPts = -1;
+        int diffSkipped = 0;
+        bool diffBusy = false;  // most of blocks changed last time
         bool eof = false;
 
         VideoReader();
         ~VideoReader();
 
-        bool open(const char* fileName);
+        bool open(const char* fileName, int width = 0, int height = 0);
         bool read(RGBFrame& result, int64_t skipPts = 0);
         bool seek(int64_t pts);
+        bool setMotionVectors(bool enabled);
         StreamInfo getStreamInfo() const;
 
     private:
+        bool openDecoder();
         bool readRaw();
+        bool readPacket();
         bool convert(const AVFrame* frame, RGBFrame& result);
+        void exportMotion(const AVFrame* frame, RGBFrame& result);
+        void measure(const AVFrame* frame, RGBFrame& result);
+        void compare(RGBFrame& result);
         void destroy();
     };
 
@@ -82,11 +216,21 @@ namespace video {
         std::condition_variable cv;
         std::atomic<bool> stopped = false; //status of background thread
         FramePool pool;
+        FrameArchive archive{ pool };
         VideoReader reader;
+        VideoReader proxyReader;
+        VideoReader* source = &reader;      // reader of the last seek
+        std::string proxyFile;              // to be opened by background thread
+        bool proxyChanged = false;
+        bool proxyOpened = false;
 
         struct State {
             int8_t loadDir = 1;
             int64_t seekPts = -1;
+            FrameRegion region;     // doesn't invalidate the frame being read
+            bool proxy = false;     // next seeks read the proxy file if it is opened
+            bool motion = false;    // source decoder exports motion vectors
+            bool scopes = false;    // frames are measured for scopes
             friend bool operator==(const State& left, const State& right) {
                 return
                     left.loadDir == right.loadDir &&
@@ -97,12 +241,15 @@ namespace video {
         RGBFrame* result = nullptr;
         std::vector<RGBFrame*> prevCache;
         int64_t lastPts = -1;
+        std::function<void()> notifyFn; // called from background thread when result is ready
 
         void playback();
         bool canWork();
         State copyState();
         void saveResult(RGBFrame* frame, State state);
         RGBFrame* readFrame(const State& state);
+        void openProxy();
+        void deduplicate(RGBFrame* frame);
 
     public:
         FrameLoader() = default;
@@ -112,13 +259,22 @@ namespace video {
         void start();
         void stop();
         void seek(int8_t loadDir, int64_t seekPts);
+        void setRegion(const FrameRegion& region);
+        void setProxy(bool enabled);
+        void setProxyFile(const std::string& fileName);
+        void setMotionVectors(bool enabled);
+        void setScopes(bool enabled);
         RGBFrame* getFrame();
         void putFrame(RGBFrame* unusedFrame);
+        void archiveFrame(RGBFrame* oldFrame);
         void createFrames(size_t count, int w, int h);
+        void setNotify(std::function<void()> fn);
     };
 
     struct FrameQueue {
-        static constexpr size_t capacity = 10;
+        static constexpr size_t capacity = 1024;   // frames, their pixels are limited by 'budgetBytes'
+        static constexpr size_t minFrames = 10;
+        static constexpr size_t budgetBytes = 512 * 1024 * 1024;
         static constexpr size_t deltaMin = 1;
 
         CircleBuffer<RGBFrame*, capacity, nullptr> items;
@@ -139,6 +295,7 @@ namespace video {
         bool tooFarFromEnd() const;
         void tryFillBack(FrameLoader& loader);
         void tryFillFront(FrameLoader& loader);
+        bool overBudget() const;
     };
 
     struct PlayState {
@@ -150,14 +307,40 @@ namespace video {
         int64_t seconds = 0;
         int64_t framePts = 0;   // last seen frame pts 
         int64_t frameDur = 0;   // last seen frame duration
+        bool proxy = false;     // last seen frame comes from the proxy
     };
 
+    /*
+        A-B loop keeps the shown frames of [loopFrom, loopTo) pinned: frame headers share
+        pixel buffers with the decoded frames, so pinning copies nothing.
+        Once the region is pinned completely, looping and stepping inside it don't decode
+    */
     struct Player {
+        static constexpr size_t pinBudget = 512 * 1024 * 1024;
+
         StreamInfo info;
         FrameLoader loader;
         FrameQueue frameQ;
         PlayState ps;
         time_point lastUpdate;
+        ProxyBuilder proxyBuilder;
+        SceneDetector scenes;
+        PacketTimeline timeline;
+        std::string fileName;
+        bool proxyEnabled = false;  // build proxies of heavy videos and show them while seeking
+        bool proxyLoaded = false;   // proxy file is passed to loader
+        bool proxyWanted = false;   // loader reads the proxy on seeks
+        bool scenesEnabled = false; // detect scene cuts of opened videos
+        bool timelineEnabled = false;   // read packet sizes and picture types of opened videos
+        bool motionEnabled = false; // frames carry motion vectors exported by the decoder
+        bool scopesEnabled = false; // frames carry scopes of their planes
+        time_point lastSeek;
+        int64_t loopFrom = -1;
+        int64_t loopTo = -1;                    // -1 if loop is not set
+        std::map<int64_t, RGBFrame*> pinned;    // by pts
+        std::unordered_set<const PixelBuffer*> pinnedBuffers;
+        size_t pinnedBytes = 0;
+        int64_t pinnedPts = -1;                 // shown pinned frame, -1 when frames come from 'frameQ'
 
         bool start(const char* fileName);
         void stop();
@@ -165,10 +348,34 @@ namespace video {
         void seekLeft(bool isLong);
         void seekRight(bool isLong);
         void seekPts(int64_t pts);
+        void seekCut(int direction);
+        void reload();
+        void setRegion(const FrameRegion& region);
+        void setProxyEnabled(bool enabled);
+        void setScenesEnabled(bool enabled);
+        void setTimelineEnabled(bool enabled);
+        void setMotionEnabled(bool enabled);
+        void setScopesEnabled(bool enabled);
+        void setLoopStart();
+        void setLoopEnd();
+        void clearLoop();
+        bool hasLoop() const;
         void pause(bool paused);
         bool hasUpdate(const time_point& now);
+        bool active() const;
         bool eof();
         const RGBFrame* currentFrame();
+
+    private:
+        void startProxy();
+        void useProxy(bool enabled, const time_point& now);
+        void settleProxy(const time_point& now);
+        void pinFrame(const RGBFrame* frame);
+        void unpinFrames();
+        bool pinnedComplete() const;
+        bool stepPinned(int direction);
+        const RGBFrame* nextFrame();
+        const RGBFrame* wrapLoop();
     };
 
 }
@@ -110,6 +110,12 @@ void WorkState::save(const char* path) {
 		writer.putUInt8(splitMode);
 		writer.putUInt32(drawLineWidth);
 		writer.putRGB(drawLineColor);
+		writer.putBool(drawLineSmooth);
+		writer.putUInt32(drawLineFrames);
+		writer.putBool(useProxies);
+		writer.putBool(detectScenes);
+		writer.putBool(showTimeline);
+		writer.putBool(showMotion);
 	}
 }
 
@@ -150,6 +156,12 @@ bool WorkState::load(const char* path) {
 		reader.getUInt8(splitMode);
 		reader.getUInt32(drawLineWidth);
 		reader.getRGB(drawLineColor);
+		reader.getBool(drawLineSmooth);
+		reader.getUInt32(drawLineFrames);
+		reader.getBool(useProxies);
+		reader.getBool(detectScenes);
+		reader.getBool(showTimeline);
+		reader.getBool(showMotion);
 	}
 	
 	return true;
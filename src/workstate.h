@@ -13,7 +13,7 @@ struct FileTreeState {
 };
 
 struct WorkState {
-    const uint32_t formatVersion = 3;
+    const uint32_t formatVersion = 9;
     MainState main;
     FileTreeState fileTree;
 
@@ -24,6 +24,12 @@ struct WorkState {
     uint8_t splitMode = 0;
     uint32_t drawLineWidth = 20;
     float drawLineColor[3] = { 1.0f, 0.0f, 0.0f };
+    bool drawLineSmooth = true;
+    uint32_t drawLineFrames = 0;
+    bool useProxies = false;
+    bool detectScenes = false;
+    bool showTimeline = false;
+    bool showMotion = false;
 
     void save(const char* path);
     bool load(const char* path);
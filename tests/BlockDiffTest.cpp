@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "util/blockdiff.h"
+
+static constexpr int width = 200;
+static constexpr int height = 130;
+static constexpr int lineSize = width * 3;
+
+static std::vector<uint8_t> makeImage() {
+	std::vector<uint8_t> image(static_cast<size_t>(lineSize) * height);
+	for (size_t i = 0; i < image.size(); i++) {
+		image[i] = static_cast<uint8_t>(i * 7);
+	}
+	return image;
+}
+
+TEST(BlockDiffTest, FirstImageIsDirty) {
+	BlockDiff diff;
+	auto image = makeImage();
+	ASSERT_FALSE(diff.compare(image.data(), width, height, lineSize, 3));
+	ASSERT_EQ(4, diff.columns());
+	ASSERT_EQ(3, diff.rows());
+	ASSERT_FLOAT_EQ(1.f, diff.dirtyFraction());
+}
+
+TEST(BlockDiffTest, SameImageIsClean) {
+	BlockDiff diff;
+	auto image = makeImage();
+	diff.compare(image.data(), width, height, lineSize, 3);
+	ASSERT_TRUE(diff.compare(image.data(), width, height, lineSize, 3));
+	ASSERT_FLOAT_EQ(0.f, diff.dirtyFraction());
+}
+
+TEST(BlockDiffTest, ChangedPixelMarksItsBlock) {
+	BlockDiff diff;
+	auto image = makeImage();
+	diff.compare(image.data(), width, height, lineSize, 3);
+
+	// Pixel [199, 129] is in the last partial block
+	image[129 * lineSize + 199 * 3 + 2] ^= 0xFF;
+	ASSERT_TRUE(diff.compare(image.data(), width, height, lineSize, 3));
+	const auto& mask = diff.mask();
+	for (size_t i = 0; i < mask.size(); i++) {
+		ASSERT_EQ(i == mask.size() - 1 ? 1 : 0, mask[i]);
+	}
+
+	// Previous copy is refreshed, so the same image is clean again
+	ASSERT_TRUE(diff.compare(image.data(), width, height, lineSize, 3));
+	ASSERT_FLOAT_EQ(0.f, diff.dirtyFraction());
+}
+
+TEST(BlockDiffTest, SizeChangeResets) {
+	BlockDiff diff;
+	auto image = makeImage();
+	diff.compare(image.data(), width, height, lineSize, 3);
+	ASSERT_FALSE(diff.compare(image.data(), width, height - 1, lineSize, 3));
+	ASSERT_FLOAT_EQ(1.f, diff.dirtyFraction());
+}
+
+TEST(BlockDiffTest, EqualHandlesTail) {
+	uint8_t a[37] = {};
+	uint8_t b[37] = {};
+	ASSERT_TRUE(BlockDiff::equal(a, b, sizeof(a)));
+	b[36] = 1;
+	ASSERT_FALSE(BlockDiff::equal(a, b, sizeof(a)));
+	b[36] = 0;
+	b[3] = 1;
+	ASSERT_FALSE(BlockDiff::equal(a, b, sizeof(a)));
+}
@@ -0,0 +1,30 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "util/hash.h"
+
+TEST(HashTest, ReferenceValues) {
+	ASSERT_EQ(0xEF46DB3751D8E999ull, hash::xxh64("", 0));
+	ASSERT_EQ(0xD24EC4F1A98C6E5Bull, hash::xxh64("a", 1));
+	ASSERT_EQ(0x44BC2CF5AD770999ull, hash::xxh64("abc", 3));
+}
+
+TEST(HashTest, LongInputUsesAllBytes) {
+	std::vector<uint8_t> data(1000);
+	for (size_t i = 0; i < data.size(); i++) {
+		data[i] = static_cast<uint8_t>(i);
+	}
+	const uint64_t h = hash::xxh64(data.data(), data.size());
+	ASSERT_EQ(h, hash::xxh64(data.data(), data.size()));
+
+	data[0] ^= 1;
+	ASSERT_NE(h, hash::xxh64(data.data(), data.size()));
+	data[0] ^= 1;
+	data[999] ^= 1;
+	ASSERT_NE(h, hash::xxh64(data.data(), data.size()));
+}
+
+TEST(HashTest, SeedChangesHash) {
+	const std::string text = "frames";
+	ASSERT_NE(hash::xxh64(text.data(), text.size(), 0), hash::xxh64(text.data(), text.size(), 1));
+}
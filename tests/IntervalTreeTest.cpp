@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "util/intervaltree.h"
+
+static std::vector<int> query(const IntervalTree<int>& tree, int64_t point) {
+	std::vector<int> result;
+	tree.query(point, [&](const int& value) { result.push_back(value); });
+	return result;
+}
+
+TEST(IntervalTreeTest, StabbingQuery) {
+	IntervalTree<int> tree;
+	tree.insert(5, 20, 2);
+	tree.insert(0, 10, 1);
+	tree.insert(30, 40, 3);
+
+	ASSERT_EQ(std::vector<int>({ 1 }), query(tree, 0));
+	ASSERT_EQ(std::vector<int>({ 1, 2 }), query(tree, 7));
+	ASSERT_EQ(std::vector<int>({ 2 }), query(tree, 10));
+	ASSERT_EQ(std::vector<int>(), query(tree, 20));
+	ASSERT_EQ(std::vector<int>({ 3 }), query(tree, 39));
+	ASSERT_EQ(std::vector<int>(), query(tree, -1));
+}
+
+TEST(IntervalTreeTest, UnboundedInterval) {
+	IntervalTree<int> tree;
+	tree.insert(INT64_MIN, INT64_MAX, 1);
+	tree.insert(100, 101, 2);
+
+	ASSERT_EQ(std::vector<int>({ 1 }), query(tree, -1000));
+	ASSERT_EQ(std::vector<int>({ 1, 2 }), query(tree, 100));
+}
+
+TEST(IntervalTreeTest, BulkInsert) {
+	IntervalTree<int> tree;
+	tree.insert(5, 20, 2);
+	tree.insert({ { 0, 10, 1 }, { 15, 30, 3 } });
+
+	ASSERT_EQ(3, tree.size());
+	ASSERT_EQ(std::vector<int>({ 1, 2 }), query(tree, 7));
+	ASSERT_EQ(std::vector<int>({ 2, 3 }), query(tree, 17));
+}
+
+TEST(IntervalTreeTest, Remove) {
+	IntervalTree<int> tree;
+	tree.insert(0, 10, 1);
+	tree.insert(0, 100, 2);
+	tree.insert(50, 60, 3);
+
+	tree.remove(2);
+	ASSERT_EQ(2, tree.size());
+	ASSERT_EQ(std::vector<int>(), query(tree, 20));
+	ASSERT_EQ(std::vector<int>({ 3 }), query(tree, 55));
+}
+
+TEST(IntervalTreeTest, MatchesLinearScan) {
+	IntervalTree<int> tree;
+	std::vector<std::pair<int64_t, int64_t>> intervals;
+	uint32_t seed = 12345;
+	auto random = [&seed](int range) {
+		seed = seed * 1664525u + 1013904223u;
+		return static_cast<int64_t>((seed >> 8) % range);
+	};
+	for (int i = 0; i < 1000; i++) {
+		int64_t from = random(10000);
+		int64_t to = from + 1 + random(200);
+		intervals.emplace_back(from, to);
+		tree.insert(from, to, i);
+	}
+
+	for (int64_t point = 0; point < 10300; point += 7) {
+		auto result = query(tree, point);
+		std::sort(result.begin(), result.end());
+		std::vector<int> expected;
+		for (int i = 0; i < static_cast<int>(intervals.size()); i++) {
+			if (intervals[i].first <= point && point < intervals[i].second) {
+				expected.push_back(i);
+			}
+		}
+		ASSERT_EQ(expected, result);
+	}
+}
@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "util/lz.h"
+
+static std::vector<uint8_t> roundTrip(const std::vector<uint8_t>& input, size_t* packedSize = nullptr) {
+	std::vector<uint8_t> packed(lz::bound(input.size()));
+	packed.resize(lz::compress(input.data(), input.size(), packed.data()));
+	if (packedSize) {
+		*packedSize = packed.size();
+	}
+
+	std::vector<uint8_t> output(input.size());
+	EXPECT_TRUE(lz::decompress(packed.data(), packed.size(), output.data(), output.size()));
+	return output;
+}
+
+TEST(LzTest, EmptyAndTinyInputs) {
+	ASSERT_EQ(std::vector<uint8_t>{}, roundTrip({}));
+	ASSERT_EQ(std::vector<uint8_t>{ 7 }, roundTrip({ 7 }));
+	ASSERT_EQ((std::vector<uint8_t>{ 1, 2, 3, 4, 5 }), roundTrip({ 1, 2, 3, 4, 5 }));
+}
+
+TEST(LzTest, RunsCompress) {
+	std::vector<uint8_t> input(100000, 42);
+	size_t packedSize = 0;
+	ASSERT_EQ(input, roundTrip(input, &packedSize));
+	ASSERT_LT(packedSize, input.size() / 100);
+}
+
+TEST(LzTest, NoiseRoundTrips) {
+	std::vector<uint8_t> input(70000);
+	uint32_t state = 12345;
+	for (auto& value : input) {
+		state = state * 1664525u + 1013904223u;
+		value = static_cast<uint8_t>(state >> 24);
+	}
+	size_t packedSize = 0;
+	ASSERT_EQ(input, roundTrip(input, &packedSize));
+	ASSERT_LE(packedSize, lz::bound(input.size()));
+}
+
+TEST(LzTest, RepeatedPatternWithLongLiterals) {
+	std::vector<uint8_t> input;
+	for (int i = 0; i < 300; i++) {
+		input.push_back(static_cast<uint8_t>(i * 31));
+	}
+	for (int i = 0; i < 5000; i++) {
+		input.push_back(input[i % 300]);
+	}
+	ASSERT_EQ(input, roundTrip(input));
+}
+
+TEST(LzTest, DamagedDataFails) {
+	std::vector<uint8_t> input(1000, 1);
+	std::vector<uint8_t> packed(lz::bound(input.size()));
+	packed.resize(lz::compress(input.data(), input.size(), packed.data()));
+
+	std::vector<uint8_t> output(input.size());
+	ASSERT_FALSE(lz::decompress(packed.data(), packed.size(), output.data(), output.size() - 1));
+	ASSERT_FALSE(lz::decompress(packed.data(), 3, output.data(), output.size()));
+
+	// First sequence is one literal followed by a match offset pointing before the output
+	packed[2] = 0xFF;
+	packed[3] = 0xFF;
+	ASSERT_FALSE(lz::decompress(packed.data(), packed.size(), output.data(), output.size()));
+}
+
+TEST(LzTest, DeltaFilterIsReversible) {
+	std::vector<uint8_t> input = { 10, 20, 30, 11, 21, 31, 255, 0, 1 };
+	auto data = input;
+	lz::deltaEncode(data.data(), data.size(), 3);
+	ASSERT_EQ((std::vector<uint8_t>{ 10, 20, 30, 1, 1, 1, 244, 235, 226 }), data);
+	lz::deltaDecode(data.data(), data.size(), 3);
+	ASSERT_EQ(input, data);
+}
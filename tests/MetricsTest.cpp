@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "util/metrics.h"
+
+static std::vector<uint8_t> noise(size_t size, uint32_t state) {
+	std::vector<uint8_t> data(size);
+	for (auto& value : data) {
+		state = state * 1664525u + 1013904223u;
+		value = static_cast<uint8_t>(state >> 24);
+	}
+	return data;
+}
+
+TEST(MetricsTest, IdenticalImages) {
+	const int w = 37, h = 19, lineSize = w * 3 + 5;
+	const auto image = noise(static_cast<size_t>(lineSize) * h, 1);
+	const double mse = metrics::mse(image.data(), image.data(), w, h, lineSize);
+	ASSERT_EQ(0.0, mse);
+	ASSERT_EQ(metrics::maxPsnr, metrics::psnr(mse));
+	ASSERT_DOUBLE_EQ(1.0, metrics::ssim(image.data(), image.data(), w, h, lineSize));
+}
+
+TEST(MetricsTest, SquaredErrorMatchesScalar) {
+	// Long enough to flush vector lanes several times and leave a tail
+	const size_t size = 16 * 4096 * 3 + 7;
+	const auto a = noise(size, 2);
+	const auto b = noise(size, 3);
+	uint64_t expected = 0;
+	for (size_t i = 0; i < size; i++) {
+		const int d = static_cast<int>(a[i]) - b[i];
+		expected += static_cast<uint64_t>(d * d);
+	}
+	ASSERT_EQ(expected, metrics::squaredError(a.data(), b.data(), size));
+
+	std::vector<uint8_t> black(size, 0), white(size, 255);
+	ASSERT_EQ(static_cast<uint64_t>(size) * 255 * 255, metrics::squaredError(black.data(), white.data(), size));
+}
+
+TEST(MetricsTest, ConstantOffset) {
+	const int w = 16, h = 16, lineSize = w * 3;
+	std::vector<uint8_t> a(static_cast<size_t>(lineSize) * h, 100);
+	std::vector<uint8_t> b(a.size(), 110);
+	const double mse = metrics::mse(a.data(), b.data(), w, h, lineSize);
+	ASSERT_DOUBLE_EQ(100.0, mse);
+	ASSERT_NEAR(28.13, metrics::psnr(mse), 0.01);
+
+	// Padding bytes past the row are ignored
+	const int padded = lineSize + 4;
+	std::vector<uint8_t> c(static_cast<size_t>(padded) * h, 100), d(c.size(), 100);
+	for (int y = 0; y < h; y++) {
+		d[static_cast<size_t>(y) * padded + lineSize] = 0;
+	}
+	ASSERT_EQ(0.0, metrics::mse(c.data(), d.data(), w, h, padded));
+}
+
+TEST(MetricsTest, SsimDropsWithDistortion) {
+	const int w = 64, h = 64, lineSize = w * 3;
+	const auto a = noise(static_cast<size_t>(lineSize) * h, 4);
+	auto slight = a;
+	for (size_t i = 0; i < slight.size(); i += 7) {
+		slight[i] = static_cast<uint8_t>(std::min(255, slight[i] + 8));
+	}
+	const auto other = noise(a.size(), 5);
+
+	const double ssimSlight = metrics::ssim(a.data(), slight.data(), w, h, lineSize);
+	const double ssimOther = metrics::ssim(a.data(), other.data(), w, h, lineSize);
+	ASSERT_LT(ssimSlight, 1.0);
+	ASSERT_GT(ssimSlight, 0.9);
+	ASSERT_LT(ssimOther, 0.2);
+}
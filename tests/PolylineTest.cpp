@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+#include "util/polyline.h"
+
+using Result = PolylineSimplifier::Result;
+
+static std::vector<glm::vec2> simplify(const std::vector<glm::vec2>& input, float tolerance) {
+	std::vector<glm::vec2> result = { input[0] };
+	PolylineSimplifier simplifier;
+	simplifier.reset(input[0]);
+	for (size_t i = 1; i < input.size(); i++) {
+		if (simplifier.push(input[i], tolerance) == Result::Append) {
+			result.push_back(input[i]);
+		} else {
+			result.back() = input[i];
+		}
+	}
+	return result;
+}
+
+TEST(PolylineTest, FirstPointAppends) {
+	PolylineSimplifier simplifier;
+	simplifier.reset({ 0, 0 });
+	ASSERT_EQ(Result::Append, simplifier.push({ 1, 0 }, 0.5f));
+	ASSERT_EQ(Result::Extend, simplifier.push({ 2, 0 }, 0.5f));
+}
+
+TEST(PolylineTest, StraightLineKeepsEnds) {
+	std::vector<glm::vec2> input;
+	for (int i = 0; i <= 50; i++) {
+		input.push_back({ i, 0.1f * (i % 2) });
+	}
+	auto result = simplify(input, 0.5f);
+	ASSERT_EQ(2, result.size());
+	ASSERT_EQ(input.front(), result.front());
+	ASSERT_EQ(input.back(), result.back());
+}
+
+TEST(PolylineTest, CornerIsKept) {
+	std::vector<glm::vec2> input;
+	for (int i = 0; i <= 10; i++) {
+		input.push_back({ i, 0 });
+	}
+	for (int i = 1; i <= 10; i++) {
+		input.push_back({ 10, i });
+	}
+	auto result = simplify(input, 0.5f);
+	ASSERT_EQ(3, result.size());
+	ASSERT_EQ(glm::vec2(10, 0), result[1]);
+	ASSERT_EQ(glm::vec2(10, 10), result[2]);
+}
+
+TEST(PolylineTest, ArcStaysWithinTolerance) {
+	std::vector<glm::vec2> input;
+	const float radius = 100.f;
+	for (int i = 0; i <= 1000; i++) {
+		float angle = 3.14159f * i / 1000.f;
+		input.push_back({ radius * std::cos(angle), radius * std::sin(angle) });
+	}
+	const float tolerance = 1.f;
+	auto result = simplify(input, tolerance);
+	ASSERT_LT(result.size() * 10, input.size());
+
+	for (size_t i = 1; i < result.size(); i++) {
+		glm::vec2 mid = 0.5f * (result[i - 1] + result[i]);
+		ASSERT_LT(radius - glm::length(mid), 2 * tolerance);
+	}
+}
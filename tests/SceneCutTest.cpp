@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "util/scenecut.h"
+
+struct Picture {
+	int width, height;
+	std::vector<uint8_t> y, u, v;
+
+	Picture(int w, int h, uint8_t luma, uint8_t chroma = 128) :
+		width(w), height(h),
+		y(static_cast<size_t>(w) * h, luma),
+		u(static_cast<size_t>(w / 2) * (h / 2), chroma),
+		v(static_cast<size_t>(w / 2) * (h / 2), chroma) {
+	}
+	scenecut::Features features() const {
+		const uint8_t* planes[3] = { y.data(), u.data(), v.data() };
+		const int lineSizes[3] = { width, width / 2, width / 2 };
+		scenecut::Features result;
+		scenecut::extract(planes, lineSizes, width, height, 1, 1, result);
+		return result;
+	}
+};
+
+TEST(SceneCutTest, SamePictureHasNoDifference) {
+	Picture picture(320, 180, 90);
+	for (size_t i = 0; i < picture.y.size(); i++) {
+		picture.y[i] = static_cast<uint8_t>(i * 7);
+	}
+	const auto features = picture.features();
+	ASSERT_TRUE(features.valid);
+	ASSERT_EQ(0.f, scenecut::difference(features, features));
+}
+
+TEST(SceneCutTest, HistogramCountsSampledRows) {
+	// 180 rows are all sampled, 3 of 33 values per 8 fall to the bin of 64
+	Picture picture(100, 180, 64);
+	const auto features = picture.features();
+	ASSERT_EQ(100u * 180, features.histogram[0][8]);
+	ASSERT_EQ(50u * 90, features.histogram[1][16]);
+	ASSERT_EQ(features.thumbnail[0], 64);
+
+	// Taller picture is sampled on every other row
+	Picture tall(100, 360, 64);
+	ASSERT_EQ(100u * 180, tall.features().histogram[0][8]);
+}
+
+TEST(SceneCutTest, DifferentPicturesDiffer) {
+	const auto black = Picture(320, 180, 16).features();
+	const auto white = Picture(320, 180, 235).features();
+	const auto tinted = Picture(320, 180, 16, 200).features();
+	ASSERT_NEAR(0.75f, scenecut::difference(black, white), 0.001f);
+	ASSERT_NEAR(0.25f, scenecut::difference(black, tinted), 0.001f);
+
+	// Same colors in another place change only the layout part
+	Picture left(320, 180, 16), right(320, 180, 16);
+	for (int row = 0; row < 180; row++) {
+		std::fill_n(left.y.begin() + row * 320, 160, 235);
+		std::fill_n(right.y.begin() + row * 320 + 160, 160, 235);
+	}
+	ASSERT_NEAR(0.5f, scenecut::difference(left.features(), right.features()), 0.001f);
+}
+
+TEST(SceneCutTest, TinyPicturesAreIgnored) {
+	const auto features = Picture(16, 16, 10).features();
+	ASSERT_FALSE(features.valid);
+	ASSERT_EQ(0.f, scenecut::difference(features, features));
+}
+
+TEST(SceneCutTest, DetectorNeedsContrast) {
+	scenecut::Detector detector;
+	ASSERT_FALSE(detector.push(0.02f));
+	ASSERT_FALSE(detector.push(0.03f));
+	ASSERT_TRUE(detector.push(0.6f));
+	ASSERT_FALSE(detector.push(0.01f));
+
+	// Steady high differences of fast motion are not cuts
+	detector.reset();
+	for (int i = 0; i < 8; i++) {
+		detector.push(0.35f);
+	}
+	ASSERT_FALSE(detector.push(0.4f));
+
+	// Once the motion settles, a jump is a cut again
+	for (int i = 0; i < 8; i++) {
+		detector.push(0.02f);
+	}
+	ASSERT_TRUE(detector.push(0.7f));
+}
@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+#include <memory>
+#include <vector>
+#include "util/scopes.h"
+
+template<typename T>
+struct Planes {
+	int width, height;
+	std::vector<T> y, u, v;
+
+	Planes(int w, int h, T luma, T cb, T cr) :
+		width(w), height(h),
+		y(static_cast<size_t>(w) * h, luma),
+		u(static_cast<size_t>(w / 2) * (h / 2), cb),
+		v(static_cast<size_t>(w / 2) * (h / 2), cr) {
+	}
+	std::unique_ptr<scopes::Counts> measure(int depth) const {
+		const uint8_t* planes[3] = {
+			reinterpret_cast<const uint8_t*>(y.data()),
+			reinterpret_cast<const uint8_t*>(u.data()),
+			reinterpret_cast<const uint8_t*>(v.data()) };
+		const int lineSizes[3] = {
+			static_cast<int>(width * sizeof(T)),
+			static_cast<int>(width / 2 * sizeof(T)),
+			static_cast<int>(width / 2 * sizeof(T)) };
+		auto result = std::make_unique<scopes::Counts>();
+		scopes::measure<T>(planes, lineSizes, width, height, 1, 1, depth, *result);
+		return result;
+	}
+};
+
+TEST(ScopesTest, FlatFrame) {
+	const Planes<uint8_t> frame(64, 32, 100, 60, 200);
+	const auto counts = frame.measure(8);
+	ASSERT_EQ(64u * 32, counts->lumaSamples);
+	ASSERT_EQ(32u * 16, counts->chromaSamples);
+	ASSERT_EQ(counts->lumaSamples, counts->histogram[100]);
+
+	// Every column of the waveform has the same level, 64 columns spread over 256
+	const size_t row = static_cast<size_t>(scopes::levels - 1 - 100) * scopes::waveWidth;
+	uint32_t total = 0;
+	for (int x = 0; x < scopes::waveWidth; x += 4) {
+		ASSERT_EQ(32, counts->waveform[row + x]);
+		total += counts->waveform[row + x];
+	}
+	ASSERT_EQ(counts->lumaSamples, total);
+
+	const size_t cell = static_cast<size_t>(scopes::vectorSize - 1 - 200 / 2) * scopes::vectorSize + 60 / 2;
+	ASSERT_EQ(counts->chromaSamples, counts->vectorscope[cell]);
+}
+
+TEST(ScopesTest, GradientGoesAlongWaveform) {
+	Planes<uint8_t> frame(256, 16, 0, 128, 128);
+	for (int y = 0; y < frame.height; y++) {
+		for (int x = 0; x < frame.width; x++) {
+			frame.y[static_cast<size_t>(y) * frame.width + x] = static_cast<uint8_t>(x);
+		}
+	}
+	const auto counts = frame.measure(8);
+	for (int x = 0; x < scopes::waveWidth; x++) {
+		const size_t row = static_cast<size_t>(scopes::levels - 1 - x) * scopes::waveWidth;
+		ASSERT_EQ(16, counts->waveform[row + x]);
+		ASSERT_EQ(16u, counts->histogram[x]);
+	}
+}
+
+TEST(ScopesTest, DeepSamplesAreReduced) {
+	const Planes<uint16_t> frame(32, 16, 1023, 512, 0);
+	const auto counts = frame.measure(10);
+	ASSERT_EQ(32u * 16, counts->histogram[255]);
+	const size_t cell = static_cast<size_t>(scopes::vectorSize - 1) * scopes::vectorSize + 128 / 2;
+	ASSERT_EQ(counts->chromaSamples, counts->vectorscope[cell]);
+}
+
+TEST(ScopesTest, LargeFrameIsSampled) {
+	// Chroma of one color overflows 16 bits of its cell and saturates
+	const Planes<uint8_t> frame(4000, 3000, 16, 128, 128);
+	const auto counts = frame.measure(8);
+	ASSERT_LE(counts->lumaSamples, static_cast<uint32_t>(scopes::maxRows * scopes::maxColumns));
+	ASSERT_GE(counts->lumaSamples, static_cast<uint32_t>(scopes::maxRows * scopes::maxColumns / 2));
+	ASSERT_GT(counts->chromaSamples, static_cast<uint32_t>(UINT16_MAX));
+	const size_t cell = static_cast<size_t>(scopes::vectorSize - 1 - 64) * scopes::vectorSize + 64;
+	ASSERT_EQ(UINT16_MAX, counts->vectorscope[cell]);
+}
+
+TEST(ScopesTest, ShadeMatchesScalar) {
+	// Tail past the vector lanes is shaded too
+	std::vector<uint16_t> counts(16 * 40 + 5);
+	uint32_t state = 7;
+	for (auto& value : counts) {
+		state = state * 1664525u + 1013904223u;
+		value = static_cast<uint16_t>(state >> (state & 1 ? 16 : 26));
+	}
+	for (const uint16_t gain : { 1, 3, 256, 1000, 65535 }) {
+		std::vector<uint8_t> shaded(counts.size());
+		scopes::shade(counts.data(), counts.size(), gain, shaded.data());
+		for (size_t i = 0; i < counts.size(); i++) {
+			const uint32_t expected = std::min<uint32_t>(255, static_cast<uint32_t>(counts[i]) * gain >> 8);
+			ASSERT_EQ(expected, shaded[i]) << "gain " << gain << ", count " << counts[i];
+		}
+	}
+}
@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+#include <set>
+#include "util/spatialgrid.h"
+
+static std::set<int> query(const SpatialGrid<int>& grid, const glm::vec2& pos, float radius) {
+	std::set<int> result;
+	grid.query(pos, radius, [&](const int& value) { result.insert(value); });
+	return result;
+}
+
+TEST(SpatialGridTest, FindsSegmentWithinRadius) {
+	SpatialGrid<int> grid(16.f);
+	grid.insert(1, { 0, 0 }, { 100, 0 }, 5.f);
+	grid.insert(2, { 0, 50 }, { 100, 50 }, 5.f);
+
+	ASSERT_EQ(std::set<int>({ 1 }), query(grid, { 50, 8 }, 4.f));
+	ASSERT_EQ(std::set<int>({ 2 }), query(grid, { 99, 45 }, 1.f));
+	ASSERT_TRUE(query(grid, { 50, 25 }, 4.f).empty());
+	ASSERT_TRUE(query(grid, { 120, 0 }, 4.f).empty());
+}
+
+TEST(SpatialGridTest, NegativeCoordinates) {
+	SpatialGrid<int> grid(16.f);
+	grid.insert(1, { -100, -100 }, { -20, -20 }, 2.f);
+	ASSERT_EQ(std::set<int>({ 1 }), query(grid, { -60, -60 }, 1.f));
+	ASSERT_TRUE(query(grid, { 60, 60 }, 1.f).empty());
+}
+
+TEST(SpatialGridTest, PointSegment) {
+	SpatialGrid<int> grid(16.f);
+	grid.insert(1, { 10, 10 }, { 10, 10 }, 3.f);
+	ASSERT_EQ(std::set<int>({ 1 }), query(grid, { 12, 12 }, 0.f));
+	ASSERT_TRUE(query(grid, { 14, 14 }, 0.f).empty());
+}
+
+TEST(SpatialGridTest, RemoveAllSegmentsOfValue) {
+	SpatialGrid<int> grid(16.f);
+	grid.insert(1, { 0, 0 }, { 100, 0 }, 2.f);
+	grid.insert(1, { 100, 0 }, { 100, 100 }, 2.f);
+	grid.insert(2, { 0, 0 }, { 0, 100 }, 2.f);
+
+	grid.remove(1, { 0, 0 }, { 100, 0 }, 2.f);
+	grid.remove(1, { 100, 0 }, { 100, 100 }, 2.f);
+	ASSERT_EQ(std::set<int>({ 2 }), query(grid, { 0, 0 }, 1.f));
+	ASSERT_TRUE(query(grid, { 100, 50 }, 1.f).empty());
+
+	grid.remove(2, { 0, 0 }, { 0, 100 }, 2.f);
+	ASSERT_TRUE(grid.empty());
+}